@@ -0,0 +1,143 @@
+#include "Arduino.h"
+
+#include <stdarg.h>
+
+HostSerial Serial;
+EspClass ESP;
+
+// The battery is measured through a 2x 10MΩ divider, see README
+static const float BATTERY_DIVIDER_RATIO = 2.0f;
+static const float ADC_NOISE_MV = 6.0f;
+static const uint32_t ADC_SAMPLE_US = 20;
+static const uint8_t BUTTON_PIN = 0;
+
+static std::string formatFloat(double number, unsigned int decimalPlaces)
+{
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimalPlaces, number);
+    return buffer;
+}
+
+String::String(float number, unsigned int decimalPlaces) : value(formatFloat(number, decimalPlaces)) {}
+String::String(double number, unsigned int decimalPlaces) : value(formatFloat(number, decimalPlaces)) {}
+
+unsigned long millis()
+{
+    // Every clock read costs a little time so busy-wait loops still terminate
+    hostsim::advanceUs(1);
+    return static_cast<unsigned long>(hostsim::uptimeUs() / hostsim::US_PER_MS);
+}
+
+unsigned long micros()
+{
+    hostsim::advanceUs(1);
+    return static_cast<unsigned long>(hostsim::uptimeUs());
+}
+
+void delay(uint32_t ms)
+{
+    hostsim::idleUs(ms * hostsim::US_PER_MS);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    hostsim::advanceUs(us);
+}
+
+void yield()
+{
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+}
+
+int digitalRead(uint8_t pin)
+{
+    hostsim::advanceUs(1);
+    if (pin == BUTTON_PIN)
+        return hostsim::buttonPressedAt(hostsim::nowUs()) ? HIGH : LOW;
+    return LOW;
+}
+
+uint32_t analogReadMilliVolts(uint8_t pin)
+{
+    hostsim::world().stats.adcSamples++;
+    hostsim::advanceUs(ADC_SAMPLE_US);
+
+    float millivolts = hostsim::batteryVoltage() * 1000.0f / BATTERY_DIVIDER_RATIO +
+                       hostsim::gaussian(ADC_NOISE_MV);
+    return millivolts > 0.0f ? static_cast<uint32_t>(millivolts) : 0;
+}
+
+void HostSerial::begin(unsigned long baud)
+{
+}
+
+void HostSerial::end()
+{
+}
+
+size_t HostSerial::print(const char *str)
+{
+    return write(reinterpret_cast<const uint8_t *>(str), strlen(str));
+}
+
+size_t HostSerial::print(const String &str)
+{
+    return print(str.c_str());
+}
+
+size_t HostSerial::println(const char *str)
+{
+    return print(str) + print("\n");
+}
+
+size_t HostSerial::println(const String &str)
+{
+    return println(str.c_str());
+}
+
+size_t HostSerial::printf(const char *format, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0)
+        return 0;
+    return write(reinterpret_cast<const uint8_t *>(buffer), std::min(static_cast<size_t>(length), sizeof(buffer) - 1));
+}
+
+size_t HostSerial::write(const uint8_t *buffer, size_t size)
+{
+    const hostsim::Config &config = hostsim::world().config;
+    if (config.verbose || config.echoSerial)
+        fwrite(buffer, 1, size, stdout);
+    return size;
+}
+
+void HostSerial::flush()
+{
+    fflush(stdout);
+}
+
+HostSerial::operator bool() const
+{
+    return hostsim::world().config.serialConnected;
+}
+
+void EspClass::restart()
+{
+    hostsim::restart("ESP.restart()");
+}
+
+uint32_t EspClass::getFreeHeap()
+{
+    return 300 * 1024;
+}
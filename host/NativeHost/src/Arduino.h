@@ -0,0 +1,117 @@
+#ifndef NATIVE_HOST_ARDUINO_H
+#define NATIVE_HOST_ARDUINO_H
+
+/**
+ * Host stand-in for the parts of the arduino-esp32 core the firmware uses.
+ * Time only moves when the firmware waits, sleeps or talks to a peripheral;
+ * see HostSim.h for the simulated world behind these calls.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "esp_attr.h"
+#include "WString.h"
+#include "HostSim.h"
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define INPUT_PULLDOWN 0x09
+
+// Seeed XIAO ESP32C6 pin mapping
+#define LED_BUILTIN 15
+#define A0 0
+#define A1 1
+#define A2 2
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#define ARDUHAL_LOG_LEVEL_NONE 0
+#define ARDUHAL_LOG_LEVEL_ERROR 1
+#define ARDUHAL_LOG_LEVEL_WARN 2
+#define ARDUHAL_LOG_LEVEL_INFO 3
+#define ARDUHAL_LOG_LEVEL_DEBUG 4
+#define ARDUHAL_LOG_LEVEL_VERBOSE 5
+
+#ifndef CORE_DEBUG_LEVEL
+#define CORE_DEBUG_LEVEL ARDUHAL_LOG_LEVEL_NONE
+#endif
+
+#define HOST_LOG(level, format, ...) hostsim::firmwareLog(level, __FILE__, __LINE__, __FUNCTION__, format, ##__VA_ARGS__)
+
+#if CORE_DEBUG_LEVEL >= ARDUHAL_LOG_LEVEL_ERROR
+#define log_e(format, ...) HOST_LOG('E', format, ##__VA_ARGS__)
+#else
+#define log_e(format, ...) do {} while (0)
+#endif
+#if CORE_DEBUG_LEVEL >= ARDUHAL_LOG_LEVEL_WARN
+#define log_w(format, ...) HOST_LOG('W', format, ##__VA_ARGS__)
+#else
+#define log_w(format, ...) do {} while (0)
+#endif
+#if CORE_DEBUG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
+#define log_i(format, ...) HOST_LOG('I', format, ##__VA_ARGS__)
+#else
+#define log_i(format, ...) do {} while (0)
+#endif
+#if CORE_DEBUG_LEVEL >= ARDUHAL_LOG_LEVEL_DEBUG
+#define log_d(format, ...) HOST_LOG('D', format, ##__VA_ARGS__)
+#else
+#define log_d(format, ...) do {} while (0)
+#endif
+#if CORE_DEBUG_LEVEL >= ARDUHAL_LOG_LEVEL_VERBOSE
+#define log_v(format, ...) HOST_LOG('V', format, ##__VA_ARGS__)
+#else
+#define log_v(format, ...) do {} while (0)
+#endif
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+uint32_t analogReadMilliVolts(uint8_t pin);
+
+class HostSerial
+{
+public:
+    void begin(unsigned long baud);
+    void end();
+    size_t print(const char *str);
+    size_t print(const String &str);
+    size_t println(const char *str = "");
+    size_t println(const String &str);
+    size_t printf(const char *format, ...);
+    size_t write(const uint8_t *buffer, size_t size);
+    void flush();
+    operator bool() const;
+};
+
+extern HostSerial Serial;
+
+class EspClass
+{
+public:
+    [[noreturn]] void restart();
+    uint32_t getFreeHeap();
+};
+
+extern EspClass ESP;
+
+void setup();
+void loop();
+
+#endif
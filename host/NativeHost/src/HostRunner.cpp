@@ -0,0 +1,499 @@
+#include "Arduino.h"
+#include "esp_sleep.h"
+#include "BatterySampler.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * Host runner for the native environment: boots the firmware once per wake
+ * cycle in a forked child, carries RTC memory across, and fast-forwards the
+ * simulated clock through each deep sleep. Unit tests (pio test -e native)
+ * bring their own main() and leave it out.
+ */
+
+#ifndef PIO_UNIT_TESTING
+
+using namespace hostsim;
+
+static void usage(const char *program)
+{
+    printf("Usage: %s [options]\n"
+           "  --days D           simulated duration (default 7)\n"
+           "  --cycles N         stop after N wake cycles\n"
+           "  --seed S           random seed for sensor and ADC noise\n"
+           "  --capacity MAH     battery capacity (default 2000)\n"
+           "  --join-ms MS       first network join latency (default 4000)\n"
+           "  --rejoin-ms MS     rejoin latency of a commissioned device (default 2500)\n"
+           "  --fast-rejoin-ms MS  rejoin latency without a channel scan (default 300)\n"
+           "  --channel C        coordinator channel, 11-26 (default 15)\n"
+           "  --outage H,D       coordinator unreachable from hour H for D hours\n"
+           "  --sensor-fault H,D SCD41 single shots hang from hour H for D hours\n"
+           "  --radio-hang H,D   Zigbee.begin() does not return from hour H for D hours\n"
+           "  --button-every S   button press every S seconds\n"
+           "  --button-hold MS   how long each press is held (default 200)\n"
+           "  --max-awake-s S    watchdog: reset a boot awake longer than S (default 600)\n"
+           "  --rtc-drift-ppm P  deep sleep timer wakes P ppm of the sleep time late, early when negative\n"
+           "  --no-tickless      no automatic light sleep, frequency scaling only\n"
+           "  --no-serial        behave as if no USB host is attached\n"
+           "  --serial           print what the firmware writes to Serial\n"
+           "  --trace            one line per wake cycle\n"
+           "  --bench-battery N  time N runs of the battery median filter against a sorted vector, then exit\n"
+           "  --decode-trace     read the firmware's serial output on stdin and print its trace records as text\n"
+           "  -v                 print firmware logs\n",
+           program);
+}
+
+// "H,D": from hour H for D hours
+static bool parseWindow(const char *value, uint64_t &startUs, uint64_t &endUs)
+{
+    double startHours = 0.0, durationHours = 0.0;
+    if (sscanf(value, "%lf,%lf", &startHours, &durationHours) != 2)
+        return false;
+    startUs = static_cast<uint64_t>(startHours * 3600 * US_PER_S);
+    endUs = static_cast<uint64_t>((startHours + durationHours) * 3600 * US_PER_S);
+    return true;
+}
+
+static bool parseArguments(int argc, char **argv, Config &config)
+{
+    config.durationUs = 7ULL * 24 * 3600 * US_PER_S;
+    config.maxCycles = 0;
+    config.maxAwakeUs = 600 * US_PER_S;
+    config.seed = 1;
+    config.batteryCapacityMah = 2000.0f;
+    config.joinMs = 4000;
+    config.rejoinMs = 2500;
+    config.fastRejoinMs = 300;
+    config.channel = 15;
+    config.buttonHoldMs = 200;
+    config.serialConnected = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+        if (strcmp(arg, "-v") == 0)
+            config.verbose = true;
+        else if (strcmp(arg, "--trace") == 0)
+            config.trace = true;
+        else if (strcmp(arg, "--no-serial") == 0)
+            config.serialConnected = false;
+        else if (strcmp(arg, "--serial") == 0)
+            config.echoSerial = true;
+        else if (strcmp(arg, "--no-tickless") == 0)
+            config.noTickless = true;
+        else if (strcmp(arg, "--decode-trace") == 0)
+            config.decodeTrace = true;
+        else if (value == nullptr)
+            return false;
+        else if (strcmp(arg, "--days") == 0)
+            config.durationUs = static_cast<uint64_t>(atof(value) * 24 * 3600 * US_PER_S), i++;
+        else if (strcmp(arg, "--cycles") == 0)
+            config.maxCycles = strtoull(value, nullptr, 10), i++;
+        else if (strcmp(arg, "--seed") == 0)
+            config.seed = static_cast<uint32_t>(strtoul(value, nullptr, 10)), i++;
+        else if (strcmp(arg, "--capacity") == 0)
+            config.batteryCapacityMah = static_cast<float>(atof(value)), i++;
+        else if (strcmp(arg, "--join-ms") == 0)
+            config.joinMs = static_cast<uint32_t>(strtoul(value, nullptr, 10)), i++;
+        else if (strcmp(arg, "--rejoin-ms") == 0)
+            config.rejoinMs = static_cast<uint32_t>(strtoul(value, nullptr, 10)), i++;
+        else if (strcmp(arg, "--fast-rejoin-ms") == 0)
+            config.fastRejoinMs = static_cast<uint32_t>(strtoul(value, nullptr, 10)), i++;
+        else if (strcmp(arg, "--channel") == 0)
+            config.channel = static_cast<uint8_t>(strtoul(value, nullptr, 10)), i++;
+        else if (strcmp(arg, "--button-every") == 0)
+            config.buttonEverySeconds = static_cast<uint32_t>(strtoul(value, nullptr, 10)), i++;
+        else if (strcmp(arg, "--button-hold") == 0)
+            config.buttonHoldMs = static_cast<uint32_t>(strtoul(value, nullptr, 10)), i++;
+        else if (strcmp(arg, "--bench-battery") == 0)
+            config.benchmarkRuns = strtoull(value, nullptr, 10), i++;
+        else if (strcmp(arg, "--rtc-drift-ppm") == 0)
+            config.rtcDriftPpm = static_cast<int32_t>(strtol(value, nullptr, 10)), i++;
+        else if (strcmp(arg, "--max-awake-s") == 0)
+            config.maxAwakeUs = strtoull(value, nullptr, 10) * US_PER_S, i++;
+        else if (strcmp(arg, "--outage") == 0)
+        {
+            if (!parseWindow(value, config.outageStartUs, config.outageEndUs))
+                return false;
+            i++;
+        }
+        else if (strcmp(arg, "--sensor-fault") == 0)
+        {
+            if (!parseWindow(value, config.sensorFaultStartUs, config.sensorFaultEndUs))
+                return false;
+            i++;
+        }
+        else if (strcmp(arg, "--radio-hang") == 0)
+        {
+            if (!parseWindow(value, config.radioHangStartUs, config.radioHangEndUs))
+                return false;
+            i++;
+        }
+        else
+            return false;
+    }
+    return true;
+}
+
+// The filter on its own, against the std::vector and full sort it replaced, on the same noisy bursts
+static int benchmarkBatteryFilter(uint64_t runs)
+{
+    const size_t bursts = 64;
+    std::vector<uint16_t> input(bursts * BATTERY_SAMPLE_COUNT);
+    for (uint16_t &sample : input)
+        sample = static_cast<uint16_t>(1900.0f + gaussian(6.0f));
+
+    uint64_t checksum[2] = {0, 0};
+    double nsPerRun[2] = {0.0, 0.0};
+    for (int method = 0; method < 2; method++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t run = 0; run < runs; run++)
+        {
+            const uint16_t *burst = &input[(run % bursts) * BATTERY_SAMPLE_COUNT];
+            if (method == 0)
+            {
+                std::vector<uint32_t> readings;
+                readings.reserve(BATTERY_SAMPLE_COUNT);
+                for (size_t i = 0; i < BATTERY_SAMPLE_COUNT; i++)
+                    readings.push_back(burst[i]);
+                std::sort(readings.begin(), readings.end());
+                checksum[method] += readings[readings.size() / 2];
+            }
+            else
+            {
+                uint16_t samples[BATTERY_SAMPLE_COUNT];
+                std::copy(burst, burst + BATTERY_SAMPLE_COUNT, samples);
+                checksum[method] += BatterySampler::median(samples, BATTERY_SAMPLE_COUNT);
+            }
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        nsPerRun[method] = std::chrono::duration<double, std::nano>(elapsed).count() / (runs ? runs : 1);
+    }
+
+    printf("Battery median of %d samples, %llu runs\n", BATTERY_SAMPLE_COUNT, (unsigned long long)runs);
+    printf("  vector + sort : %8.1f ns per run, %zu heap bytes\n", nsPerRun[0], BATTERY_SAMPLE_COUNT * sizeof(uint32_t));
+    printf("  nth_element   : %8.1f ns per run, 0 heap bytes\n", nsPerRun[1]);
+    if (checksum[0] != checksum[1])
+    {
+        printf("  medians differ\n");
+        return 1;
+    }
+    return 0;
+}
+
+static const char *const TRACE_NAMES[] = {
+#define TRACE_EVENT_NAME(name, format) #name,
+    TRACE_EVENTS(TRACE_EVENT_NAME)
+#undef TRACE_EVENT_NAME
+};
+
+static const char *const TRACE_FORMATS[] = {
+#define TRACE_EVENT_FORMAT(name, format) format,
+    TRACE_EVENTS(TRACE_EVENT_FORMAT)
+#undef TRACE_EVENT_FORMAT
+};
+
+static int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+// One record per line, its bytes in hex as they were in the little-endian RTC memory
+static bool parseTraceLine(const char *line, TraceRecord &record)
+{
+    size_t prefix = strlen(TRACE_LINE_PREFIX);
+    if (strncmp(line, TRACE_LINE_PREFIX, prefix) != 0)
+        return false;
+
+    uint8_t bytes[sizeof(TraceRecord)];
+    for (size_t i = 0; i < sizeof(bytes); i++)
+    {
+        int high = hexDigit(line[prefix + 2 * i]);
+        int low = high < 0 ? -1 : hexDigit(line[prefix + 2 * i + 1]);
+        if (low < 0)
+            return false;
+        bytes[i] = static_cast<uint8_t>(high << 4 | low);
+    }
+
+    auto field = [&](size_t offset, size_t size) {
+        uint32_t value = 0;
+        for (size_t i = 0; i < size; i++)
+            value |= static_cast<uint32_t>(bytes[offset + i]) << (8 * i);
+        return value;
+    };
+    record.timeMs = field(offsetof(TraceRecord, timeMs), 4);
+    record.event = static_cast<uint16_t>(field(offsetof(TraceRecord, event), 2));
+    record.reserved = 0;
+    record.a = static_cast<int32_t>(field(offsetof(TraceRecord, a), 4));
+    record.b = static_cast<int32_t>(field(offsetof(TraceRecord, b), 4));
+    return true;
+}
+
+// printf on the two record arguments, with %h and %k for hundredths and thousandths
+static void printTraceText(const char *format, int32_t a, int32_t b)
+{
+    const int32_t args[2] = {a, b};
+    size_t used = 0;
+    for (const char *p = format; *p != '\0'; p++)
+    {
+        if (*p != '%')
+        {
+            putchar(*p);
+            continue;
+        }
+
+        char spec[16] = "%";
+        size_t length = 1;
+        while (p[1] != '\0' && strchr("0123456789-+ #", p[1]) != nullptr && length < sizeof(spec) - 4)
+            spec[length++] = *++p;
+        char conversion = *++p;
+        if (conversion == '\0')
+            break;
+        if (conversion == '%')
+        {
+            putchar('%');
+            continue;
+        }
+
+        int32_t value = used < 2 ? args[used++] : 0;
+        switch (conversion)
+        {
+        case 'h':
+            strcpy(spec + length, ".2f");
+            printf(spec, value / 100.0);
+            break;
+        case 'k':
+            strcpy(spec + length, ".3f");
+            printf(spec, value / 1000.0);
+            break;
+        case 'u':
+        case 'x':
+            spec[length] = conversion;
+            printf(spec, static_cast<unsigned>(value));
+            break;
+        default:
+            spec[length] = 'd';
+            printf(spec, static_cast<int>(value));
+            break;
+        }
+    }
+}
+
+// Trace records back to text, at seconds since power-on; other lines pass through as they are
+static int decodeTrace(FILE *input)
+{
+    char line[512];
+    while (fgets(line, sizeof(line), input) != nullptr)
+    {
+        TraceRecord record;
+        if (!parseTraceLine(line, record))
+        {
+            fputs(line, stdout);
+            continue;
+        }
+
+        printf("[%12.3f] ", record.timeMs / 1e3);
+        if (record.event < static_cast<uint16_t>(TraceEvent::COUNT))
+        {
+            printf("%-20s ", TRACE_NAMES[record.event]);
+            printTraceText(TRACE_FORMATS[record.event], record.a, record.b);
+        }
+        else
+        {
+            printf("event %u (%ld, %ld)", record.event, static_cast<long>(record.a), static_cast<long>(record.b));
+        }
+        putchar('\n');
+    }
+    return 0;
+}
+
+[[noreturn]] static void runBoot()
+{
+    resetForBoot();
+    advanceMs(BOOT_LATENCY_MS);
+    setup();
+
+    // The Arduino core keeps calling loop() until something puts the chip to sleep
+    for (;;)
+    {
+        loop();
+        advanceMs(1);
+    }
+}
+
+static const char *causeName(uint32_t cause)
+{
+    switch (cause)
+    {
+    case ESP_SLEEP_WAKEUP_TIMER:
+        return "timer";
+    case ESP_SLEEP_WAKEUP_EXT1:
+        return "button";
+    case ESP_SLEEP_WAKEUP_UNDEFINED:
+        return "reset";
+    default:
+        return "other";
+    }
+}
+
+static void printSummary(const World &w, uint64_t cycles, double wallSeconds)
+{
+    const Stats &s = w.stats;
+    double days = w.nowUs / (24.0 * 3600 * US_PER_S);
+    double mahPerDay = days > 0 ? s.consumedMah / days : 0.0;
+
+    printf("Simulated   : %.2f days, %llu wake cycles (%llu timer, %llu button, %llu restarts, %llu watchdog)\n",
+           days, (unsigned long long)cycles, (unsigned long long)s.timerWakes, (unsigned long long)s.buttonWakes,
+           (unsigned long long)s.restarts, (unsigned long long)s.watchdogResets);
+    printf("Host        : %.3f s wall, %.0f cycles/s\n", wallSeconds, wallSeconds > 0 ? cycles / wallSeconds : 0.0);
+    printf("Awake       : %.1f s total, %.1f ms per cycle, %.1f s light sleep\n",
+           s.awakeUs / 1e6, cycles ? s.awakeUs / 1e3 / cycles : 0.0, s.lightSleepUs / 1e6);
+    printf("CPU         : %.1f s at 160 MHz, %.1f s at 80 MHz, %.1f s at 40 MHz, %.1f s automatic light sleep\n",
+           s.cpuUs[3] / 1e6, s.cpuUs[1] / 1e6, s.cpuUs[0] / 1e6, s.autoLightSleepUs / 1e6);
+    printf("Logs        : %llu lines formatted, %.1f ms CPU\n",
+           (unsigned long long)s.logLines, s.logUs / 1e3);
+    printf("Radio       : %llu sessions, %.1f s on air, %llu reports\n",
+           (unsigned long long)s.radioSessions, s.radioUs / 1e6, (unsigned long long)s.zigbeeReports);
+    printf("Coordinator : off by %.1f ppm holding the last value, %.1f ppm extrapolating the last two sessions\n",
+           s.errorSamples ? s.holdErrorPpm / s.errorSamples : 0.0, s.errorSamples ? s.predictErrorPpm / s.errorSamples : 0.0);
+    printf("              off by %.2f C and %.2f %%RH on temperature and humidity\n",
+           s.climateErrorSamples ? s.temperatureErrorC / s.climateErrorSamples : 0.0,
+           s.climateErrorSamples ? s.humidityErrorRh / s.climateErrorSamples : 0.0);
+    printf("SCD41       : %llu CO2 shots, %u RHT shots, %u EEPROM writes, readings spaced %.0f ms off whole seconds\n",
+           (unsigned long long)s.co2Measurements, w.scd41.rhtShots, w.scd41.eepromWrites,
+           s.co2Spacings ? s.co2SpacingErrorUs / 1e3 / s.co2Spacings : 0.0);
+    printf("Buses       : %llu I2C transactions (%llu bytes, %llu display), %llu ADC samples, %llu NVS opens, %llu NVS writes\n",
+           (unsigned long long)s.i2cTransactions, (unsigned long long)s.i2cBytes, (unsigned long long)s.displayBytes,
+           (unsigned long long)s.adcSamples, (unsigned long long)s.nvsOpens, (unsigned long long)s.nvsWrites);
+    printf("Display     : %llu frames, %.0f bytes and %.2f ms per frame, first pixel %.1f ms after wake\n",
+           (unsigned long long)s.displayFrames,
+           s.displayFrames ? static_cast<double>(s.displayFrameBytes) / s.displayFrames : 0.0,
+           s.displayFrames ? s.displayUs / 1e3 / s.displayFrames : 0.0,
+           s.displayFirstPixels ? s.displayFirstPixelUs / 1e3 / s.displayFirstPixels : 0.0);
+    printf("Battery     : %u %% reported last, %.1f %% left, reports off by %.1f %% on average, %llu analog reports (last %.0f)\n",
+           w.zigbee.lastBattery, stateOfChargePercent(), s.batteryReports ? s.batteryErrorPct / s.batteryReports : 0.0,
+           (unsigned long long)s.analogReports, w.zigbee.lastAnalogInput);
+    printf("Energy      : %.3f mAh, %.3f mAh/day, %.0f days on %.0f mAh\n",
+           s.consumedMah, mahPerDay, mahPerDay > 0 ? w.config.batteryCapacityMah / mahPerDay : 0.0,
+           w.config.batteryCapacityMah);
+}
+
+int main(int argc, char **argv)
+{
+    World &w = world();
+    if (!parseArguments(argc, argv, w.config))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    w.rngState = w.config.seed ? w.config.seed : 1;
+    if (w.config.decodeTrace)
+        return decodeTrace(stdin);
+    if (w.config.benchmarkRuns)
+        return benchmarkBatteryFilter(w.config.benchmarkRuns);
+
+    w.wakeCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+    w.scd41.ram = {1, 400, 44, 156, 4.0f}; // factory defaults
+    w.scd41.eeprom = w.scd41.ram;
+    setLoad(Load::SENSOR, SCD41_IDLE_MA);
+
+    w.rtcSize = rtcSectionSize();
+    if (w.rtcSize > RTC_IMAGE_MAX)
+    {
+        fprintf(stderr, "RTC data (%zu bytes) exceeds the simulated %zu bytes\n", w.rtcSize, RTC_IMAGE_MAX);
+        return 1;
+    }
+    uint8_t pristineRtc[RTC_IMAGE_MAX];
+    memcpy(pristineRtc, rtcSection(), w.rtcSize);
+    memcpy(w.rtcImage, pristineRtc, w.rtcSize);
+
+    auto wallStart = std::chrono::steady_clock::now();
+    uint64_t cycles = 0;
+
+    while (w.nowUs < w.config.durationUs && (w.config.maxCycles == 0 || cycles < w.config.maxCycles))
+    {
+        uint64_t bootAt = w.nowUs;
+        uint32_t cause = w.wakeCause;
+        double mahBefore = w.stats.consumedMah;
+        uint64_t reportsBefore = w.stats.zigbeeReports;
+
+        memcpy(rtcSection(), w.rtcImage, w.rtcSize);
+        fflush(stdout);
+
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("fork");
+            return 1;
+        }
+        if (pid == 0)
+            runBoot();
+
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || w.exitKind == ExitKind::NONE)
+        {
+            fprintf(stderr, "Simulated boot at %.3f s crashed (status %d)\n", bootAt / 1e6, status);
+            return 1;
+        }
+        cycles++;
+
+        if (w.config.trace)
+            printf("%12.3f s  %-6s  up %8.1f ms  reports %llu  %.4f mAh\n", bootAt / 1e6, causeName(cause),
+                   (w.nowUs - bootAt) / 1e3, (unsigned long long)(w.stats.zigbeeReports - reportsBefore),
+                   w.stats.consumedMah - mahBefore);
+
+        if (w.exitKind != ExitKind::DEEP_SLEEP)
+        {
+            // Any reset other than a deep sleep wake reloads RTC data from flash
+            memcpy(w.rtcImage, pristineRtc, w.rtcSize);
+            w.wakeCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+            continue;
+        }
+
+        // The RTC clock reads true time; the timer counts the slow clock with its calibration error
+        int64_t driftUs = static_cast<int64_t>(w.timerUs) * w.config.rtcDriftPpm / 1000000;
+        uint64_t wakeAt = w.timerArmed ? w.nowUs + w.timerUs + driftUs : UINT64_MAX;
+        w.wakeCause = ESP_SLEEP_WAKEUP_TIMER;
+        if (w.ext1Mask != 0)
+        {
+            uint64_t press = nextButtonPressAfter(w.nowUs);
+            if (press < wakeAt)
+            {
+                wakeAt = press;
+                w.wakeCause = ESP_SLEEP_WAKEUP_EXT1;
+            }
+        }
+
+        if (wakeAt == UINT64_MAX || wakeAt > w.config.durationUs)
+        {
+            sleepUntil(w.config.durationUs > w.nowUs ? w.config.durationUs : w.nowUs);
+            break;
+        }
+
+        sleepUntil(wakeAt);
+        if (w.wakeCause == ESP_SLEEP_WAKEUP_TIMER)
+            w.stats.timerWakes++;
+        else
+            w.stats.buttonWakes++;
+    }
+
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    printSummary(w, cycles, wallSeconds);
+    return 0;
+}
+
+#endif // !PIO_UNIT_TESTING
@@ -0,0 +1,432 @@
+#include "HostSim.h"
+#include "esp_sleep.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Bounds of the section RTC_DATA_ATTR places variables in, provided by the linker
+extern uint8_t __start_rtc_data[] __attribute__((weak));
+extern uint8_t __stop_rtc_data[] __attribute__((weak));
+
+namespace hostsim
+{
+    // Rough cost of a log_x() line at 80 MHz: the call, lock and timestamp, then vsnprintf per character
+    static const uint64_t LOG_LINE_US = 40;
+    static const uint64_t LOG_CHAR_US = 2;
+
+    static World *sharedWorld = nullptr;
+    static bool deepSleeping = false;
+
+    World &world()
+    {
+        if (sharedWorld == nullptr)
+        {
+            void *mem = mmap(nullptr, sizeof(World), PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            if (mem == MAP_FAILED)
+            {
+                perror("mmap");
+                _exit(2);
+            }
+            memset(mem, 0, sizeof(World));
+            sharedWorld = static_cast<World *>(mem);
+        }
+        return *sharedWorld;
+    }
+
+    uint64_t nowUs()
+    {
+        return world().nowUs;
+    }
+
+    uint64_t uptimeUs()
+    {
+        World &w = world();
+        return w.nowUs - w.bootUs;
+    }
+
+    // Part of the active current that scales with the clock; the rest is leakage and the always-on domain
+    static float cpuActiveMa(uint16_t mhz)
+    {
+        return CPU_ACTIVE_MA * (0.35f + 0.65f * mhz / CPU_BOOT_MHZ);
+    }
+
+    static uint16_t cpuMhz()
+    {
+        World &w = world();
+        return w.cpuIdle ? w.cpuMinMhz : w.cpuMaxMhz;
+    }
+
+    static float baseCurrentMa()
+    {
+        if (deepSleeping)
+            return BOARD_DEEP_SLEEP_MA;
+        if (world().lightSleeping)
+            return CPU_LIGHT_SLEEP_MA;
+        return cpuActiveMa(cpuMhz());
+    }
+
+    float currentMa()
+    {
+        World &w = world();
+        float total = baseCurrentMa();
+        for (size_t i = 0; i < static_cast<size_t>(Load::COUNT); i++)
+            total += w.loads[i];
+        return total;
+    }
+
+    void setLoad(Load load, float milliamps)
+    {
+        size_t i = static_cast<size_t>(load);
+        World &w = world();
+        w.loads[i] = milliamps;
+        w.loadUntilUs[i] = 0;
+    }
+
+    void setLoadUntil(Load load, float milliamps, uint64_t untilUs, float thenMa)
+    {
+        size_t i = static_cast<size_t>(load);
+        World &w = world();
+        w.loads[i] = milliamps;
+        w.loadUntilUs[i] = untilUs;
+        w.loadThenMa[i] = thenMa;
+    }
+
+    static void integrate(uint64_t us)
+    {
+        World &w = world();
+        uint64_t start = w.nowUs;
+        uint64_t end = start + us;
+
+        double uAs = static_cast<double>(baseCurrentMa()) * us;
+        for (size_t i = 0; i < static_cast<size_t>(Load::COUNT); i++)
+        {
+            uint64_t until = w.loadUntilUs[i];
+            if (until != 0 && until < end)
+            {
+                uint64_t split = until > start ? until : start;
+                uAs += static_cast<double>(w.loads[i]) * (split - start);
+                uAs += static_cast<double>(w.loadThenMa[i]) * (end - split);
+                w.loads[i] = w.loadThenMa[i];
+                w.loadUntilUs[i] = 0;
+            }
+            else
+            {
+                uAs += static_cast<double>(w.loads[i]) * us;
+            }
+        }
+
+        if (w.loads[static_cast<size_t>(Load::RADIO)] > 0.0f)
+            w.stats.radioUs += us;
+        w.stats.consumedMah += uAs / 3.6e9;
+        w.nowUs = end;
+    }
+
+    [[noreturn]] static void saveRtcAndExit(ExitKind kind)
+    {
+        World &w = world();
+        if (w.rtcSize > 0)
+            memcpy(w.rtcImage, __start_rtc_data, w.rtcSize);
+        w.exitKind = kind;
+        fflush(stdout);
+        _exit(0);
+    }
+
+    void advanceUs(uint64_t us)
+    {
+        World &w = world();
+        integrate(us);
+
+        if (w.lightSleeping)
+        {
+            w.stats.lightSleepUs += us;
+        }
+        else
+        {
+            w.stats.awakeUs += us;
+            size_t clock = cpuMhz() / 40 - 1;
+            if (clock < 4)
+                w.stats.cpuUs[clock] += us;
+        }
+
+        if (w.config.maxAwakeUs != 0 && uptimeUs() > w.config.maxAwakeUs)
+        {
+            log('E', __FILE__, __LINE__, __FUNCTION__, "Awake for %llu s without sleeping, watchdog reset",
+                (unsigned long long)(uptimeUs() / US_PER_S));
+            w.stats.watchdogResets++;
+            saveRtcAndExit(ExitKind::WATCHDOG);
+        }
+
+        runDueTimers();
+    }
+
+    void advanceMs(uint32_t ms)
+    {
+        advanceUs(ms * US_PER_MS);
+    }
+
+    void idleUs(uint64_t us, bool lightSleepAllowed)
+    {
+        World &w = world();
+        if (!lightSleepAllowed || !w.pmLightSleep || w.pmLocks > 0)
+        {
+            w.cpuIdle = true;
+            advanceUs(us);
+            w.cpuIdle = false;
+            return;
+        }
+
+        // An automatic light sleep ends early for a due esp_timer, which then runs
+        uint64_t endUs = w.nowUs + us;
+        while (w.nowUs < endUs)
+        {
+            uint64_t stepUs = endUs - w.nowUs;
+            uint64_t dueUs = nextTimerDueUs();
+            if (dueUs != UINT64_MAX)
+            {
+                uint64_t untilDue = dueUs > uptimeUs() ? dueUs - uptimeUs() : 0;
+                if (untilDue < stepUs)
+                    stepUs = untilDue > 0 ? untilDue : 1;
+            }
+
+            w.lightSleeping = true;
+            advanceUs(stepUs);
+            w.lightSleeping = false;
+            w.stats.autoLightSleepUs += stepUs;
+            runDueTimers();
+        }
+    }
+
+    void cpuBoundUs(uint64_t us)
+    {
+        advanceUs(us * CPU_BOOT_MHZ / world().cpuMaxMhz);
+    }
+
+    bool buttonPressedAt(uint64_t atUs)
+    {
+        const Config &c = world().config;
+        if (c.buttonEverySeconds == 0)
+            return false;
+
+        uint64_t period = c.buttonEverySeconds * US_PER_S;
+        return atUs >= period && (atUs % period) < c.buttonHoldMs * US_PER_MS;
+    }
+
+    uint64_t nextButtonPressAfter(uint64_t atUs)
+    {
+        const Config &c = world().config;
+        if (c.buttonEverySeconds == 0)
+            return UINT64_MAX;
+
+        uint64_t period = c.buttonEverySeconds * US_PER_S;
+        return (atUs / period + 1) * period;
+    }
+
+    uint64_t nextButtonLevelAt(bool pressed, uint64_t atUs)
+    {
+        if (buttonPressedAt(atUs) == pressed)
+            return atUs;
+        if (pressed)
+            return nextButtonPressAfter(atUs);
+
+        const Config &c = world().config;
+        uint64_t period = c.buttonEverySeconds * US_PER_S;
+        return atUs / period * period + c.buttonHoldMs * US_PER_MS;
+    }
+
+    float stateOfChargePercent()
+    {
+        World &w = world();
+        float soc = 1.0f - static_cast<float>(w.stats.consumedMah) / w.config.batteryCapacityMah;
+        return (soc < 0.0f ? 0.0f : (soc > 1.0f ? 1.0f : soc)) * 100.0f;
+    }
+
+    float batteryVoltage()
+    {
+        // Open-circuit voltage of a Li-ion cell against state of charge, 10% steps
+        static const float OCV[] = {3.00f, 3.68f, 3.74f, 3.77f, 3.79f, 3.82f,
+                                    3.87f, 3.92f, 3.98f, 4.06f, 4.20f};
+        static const float INTERNAL_RESISTANCE_OHM = 0.15f;
+
+        float pos = stateOfChargePercent() / 10.0f;
+        size_t i = static_cast<size_t>(pos);
+        float ocv = (i >= 10) ? OCV[10] : OCV[i] + (OCV[i + 1] - OCV[i]) * (pos - i);
+        return ocv - currentMa() / 1000.0f * INTERNAL_RESISTANCE_OHM;
+    }
+
+    bool coordinatorReachable()
+    {
+        const Config &c = world().config;
+        uint64_t now = nowUs();
+        return !(now >= c.outageStartUs && now < c.outageEndUs);
+    }
+
+    float coordinatorPredictedCO2(uint64_t atUs)
+    {
+        const ZigbeeNetwork &z = world().zigbee;
+        if (z.prevCO2Us == 0 || z.lastCO2Us <= z.prevCO2Us || atUs <= z.lastCO2Us)
+            return z.lastCO2;
+
+        double slope = (static_cast<double>(z.lastCO2) - z.prevCO2) / (z.lastCO2Us - z.prevCO2Us);
+        double predicted = z.lastCO2 + slope * std::min<uint64_t>(atUs - z.lastCO2Us, 3600 * US_PER_S);
+        return predicted > 0.0 ? static_cast<float>(predicted) : 0.0f;
+    }
+
+    uint32_t random()
+    {
+        // xorshift32, state kept in the shared world so sequences continue across boots
+        uint32_t &x = world().rngState;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return x;
+    }
+
+    float gaussian(float sigma)
+    {
+        float u1 = (random() + 1.0f) / 4294967297.0f;
+        float u2 = (random() + 1.0f) / 4294967297.0f;
+        return sigma * sqrtf(-2.0f * logf(u1)) * cosf(6.2831853f * u2);
+    }
+
+    void deepSleep()
+    {
+        saveRtcAndExit(ExitKind::DEEP_SLEEP);
+    }
+
+    void restart(const char *reason)
+    {
+        log('W', __FILE__, __LINE__, __FUNCTION__, "Restart: %s", reason);
+        world().stats.restarts++;
+        saveRtcAndExit(ExitKind::RESTART);
+    }
+
+    void lightSleep()
+    {
+        World &w = world();
+        uint64_t wakeAt = w.timerArmed ? w.nowUs + w.timerUs : UINT64_MAX;
+        uint32_t cause = ESP_SLEEP_WAKEUP_TIMER;
+
+        if (w.gpioWakeArmed && w.gpioWakeLevel >= 0)
+        {
+            uint64_t level = nextButtonLevelAt(w.gpioWakeLevel != 0, w.nowUs);
+            if (level < wakeAt)
+            {
+                wakeAt = level;
+                cause = ESP_SLEEP_WAKEUP_GPIO;
+            }
+        }
+        if (w.ext1Mask != 0)
+        {
+            uint64_t press = nextButtonPressAfter(w.nowUs);
+            if (press < wakeAt)
+            {
+                wakeAt = press;
+                cause = ESP_SLEEP_WAKEUP_EXT1;
+            }
+        }
+
+        if (wakeAt == UINT64_MAX)
+        {
+            log('E', __FILE__, __LINE__, __FUNCTION__, "Light sleep without wakeup source");
+            wakeAt = w.nowUs + w.config.maxAwakeUs + 1;
+        }
+
+        w.lightSleeping = true;
+        advanceUs(wakeAt - w.nowUs);
+        w.lightSleeping = false;
+        w.wakeCause = cause;
+    }
+
+    static void printLog(char level, const char *file, int line, const char *func, const char *text)
+    {
+        const char *base = strrchr(file, '/');
+        base = base ? base + 1 : file;
+        printf("[%12.3f][%c][%s:%d] %s(): %s\n", nowUs() / 1e6, level, base, line, func, text);
+    }
+
+    void log(char level, const char *file, int line, const char *func, const char *fmt, ...)
+    {
+        if (!world().config.verbose)
+            return;
+
+        char text[512];
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(text, sizeof(text), fmt, args);
+        va_end(args);
+        printLog(level, file, line, func, text);
+    }
+
+    void firmwareLog(char level, const char *file, int line, const char *func, const char *fmt, ...)
+    {
+        char text[512];
+        va_list args;
+        va_start(args, fmt);
+        int length = vsnprintf(text, sizeof(text), fmt, args);
+        va_end(args);
+        if (world().config.verbose)
+            printLog(level, file, line, func, text);
+
+        // The log line is formatted and timestamped on the device even with no USB host to read it
+        uint64_t us = LOG_LINE_US + LOG_CHAR_US * static_cast<uint64_t>(std::max(length, 0));
+        World &w = world();
+        w.stats.logLines++;
+        w.stats.logUs += us * CPU_BOOT_MHZ / w.cpuMaxMhz;
+        cpuBoundUs(us);
+    }
+
+    // Parent side: advance the world through a deep sleep
+    void sleepUntil(uint64_t wakeAtUs)
+    {
+        World &w = world();
+        uint64_t duration = wakeAtUs - w.nowUs;
+        w.zigbee.started = false;
+        w.displayFrameThisBoot = false;
+        w.displayFirstPixelThisBoot = false;
+        setLoad(Load::RADIO, 0.0f);
+        deepSleeping = true;
+        integrate(duration);
+        deepSleeping = false;
+        w.stats.deepSleepUs += duration;
+    }
+
+    void resetForBoot()
+    {
+        World &w = world();
+        w.bootUs = w.nowUs;
+        w.timerArmed = false;
+        w.ext1Mask = 0;
+        w.gpioWakeArmed = false;
+        w.gpioWakeLevel = -1;
+        w.lightSleeping = false;
+        w.cpuMaxMhz = CPU_BOOT_MHZ;
+        w.cpuMinMhz = CPU_BOOT_MHZ;
+        w.pmLightSleep = false;
+        w.pmLocks = 0;
+        w.cpuIdle = false;
+        w.exitKind = ExitKind::NONE;
+        w.zigbee.started = false;
+        w.displayFrameThisBoot = false;
+        w.displayFirstPixelThisBoot = false;
+        setLoad(Load::RADIO, 0.0f);
+        w.stats.boots++;
+    }
+
+    size_t rtcSectionSize()
+    {
+        if (__start_rtc_data == nullptr || __stop_rtc_data == nullptr)
+            return 0;
+        return static_cast<size_t>(__stop_rtc_data - __start_rtc_data);
+    }
+
+    uint8_t *rtcSection()
+    {
+        return __start_rtc_data;
+    }
+}
@@ -0,0 +1,288 @@
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Simulated hardware for the native (Linux) build.
+ *
+ * Every wake cycle runs setup() in a forked child process, so all ordinary
+ * globals start from their power-on values exactly like on the device. Only
+ * RTC_DATA_ATTR variables (placed in the "rtc_data" section), the simulated
+ * clock, NVS, the SCD41 and the Zigbee network survive a deep sleep; they live
+ * in the World structure, which is mapped shared between parent and child.
+ */
+namespace hostsim
+{
+    static const uint64_t US_PER_MS = 1000ULL;
+    static const uint64_t US_PER_S = 1000000ULL;
+
+    // Rough current figures used for the ground-truth energy model. The board
+    // floor matches the README measurement, the rest are datasheet-order values.
+    static const float BOARD_DEEP_SLEEP_MA = 0.018f;
+    static const float CPU_LIGHT_SLEEP_MA = 0.18f;
+    static const float CPU_ACTIVE_MA = 22.0f; // at 80 MHz, see cpuActiveMa()
+    static const uint16_t CPU_BOOT_MHZ = 80;
+    static const float RADIO_ACTIVE_MA = 58.0f;
+    static const float SCD41_IDLE_MA = 0.15f;
+    static const float SCD41_POWER_DOWN_MA = 0.0004f;
+    static const float SCD41_MEASURING_MA = 18.0f;
+    static const float DISPLAY_ON_MA = 8.0f;
+
+    static const uint32_t BOOT_LATENCY_MS = 120;
+
+    enum class Load : uint8_t
+    {
+        SENSOR,
+        RADIO,
+        DISPLAY,
+        COUNT
+    };
+
+    enum class ExitKind : uint8_t
+    {
+        NONE,
+        DEEP_SLEEP,
+        RESTART,
+        WATCHDOG
+    };
+
+    struct Config
+    {
+        uint64_t maxCycles;
+        uint64_t durationUs;
+        uint64_t maxAwakeUs;
+        uint32_t seed;
+        bool verbose;
+        bool trace;
+        bool serialConnected;
+        bool echoSerial;
+        float batteryCapacityMah;
+        uint32_t joinMs;
+        uint32_t rejoinMs;
+        uint32_t fastRejoinMs;
+        uint8_t channel; // coordinator's 802.15.4 channel
+        uint64_t outageStartUs;
+        uint64_t outageEndUs;
+        uint64_t sensorFaultStartUs; // single shots started in this window hang until it ends
+        uint64_t sensorFaultEndUs;
+        uint64_t radioHangStartUs; // Zigbee.begin() blocks while in this window
+        uint64_t radioHangEndUs;
+        int32_t rtcDriftPpm; // deep sleep timer wakes this much late (positive) or early per sleep time
+        bool noTickless; // esp_pm_configure() refuses automatic light sleep, like the stock Arduino sdkconfig
+        uint32_t buttonEverySeconds;
+        uint32_t buttonHoldMs;
+        uint64_t benchmarkRuns; // --bench-battery: run the filter benchmark instead of the firmware
+        bool decodeTrace;       // --decode-trace: turn trace records on stdin into text instead
+    };
+
+    struct Stats
+    {
+        uint64_t boots;
+        uint64_t timerWakes;
+        uint64_t buttonWakes;
+        uint64_t restarts;
+        uint64_t watchdogResets;
+        uint64_t awakeUs;
+        uint64_t lightSleepUs;
+        uint64_t deepSleepUs;
+        // Awake time by CPU clock, index MHz / 40 - 1, and the automatic light sleeps within lightSleepUs
+        uint64_t cpuUs[4];
+        uint64_t autoLightSleepUs;
+        uint64_t i2cTransactions;
+        uint64_t i2cBytes;
+        uint64_t adcSamples;
+        uint64_t nvsOpens;
+        uint64_t nvsWrites;
+        uint64_t radioSessions;
+        uint64_t radioUs;
+        uint64_t zigbeeReports;
+        uint64_t co2Measurements;
+        // Distance of the spacing of consecutive CO2 readings from whole seconds, summed
+        uint64_t co2SpacingErrorUs;
+        uint64_t co2Spacings;
+        // |room CO2 - coordinator's view| summed per CO2 shot, see coordinatorPredictedCO2
+        double holdErrorPpm;
+        double predictErrorPpm;
+        uint64_t errorSamples;
+        // |room climate - coordinator's temperature and humidity| summed per shot of either kind
+        double temperatureErrorC;
+        double humidityErrorRh;
+        uint64_t climateErrorSamples;
+        // |reported battery percentage - actual state of charge| summed per battery report
+        double batteryErrorPct;
+        uint64_t batteryReports;
+        uint64_t analogReports;
+        uint64_t displayBytes;
+        uint64_t displayFrames;
+        // From the start of each frame to its refreshDisplay()
+        uint64_t displayUs;
+        uint64_t displayFrameBytes;
+        // Time since boot until the first frame drawn in a boot is on a lit panel
+        uint64_t displayFirstPixels;
+        uint64_t displayFirstPixelUs;
+        // Firmware log lines formatted, whether or not anything reads them, and the CPU time they took
+        uint64_t logLines;
+        uint64_t logUs;
+        double consumedMah;
+    };
+
+    static const size_t NVS_MAX_ENTRIES = 32;
+    static const size_t NVS_KEY_LEN = 16;
+    static const size_t NVS_VALUE_LEN = 64;
+
+    struct NvsEntry
+    {
+        bool used;
+        char ns[NVS_KEY_LEN];
+        char key[NVS_KEY_LEN];
+        uint8_t type;
+        uint8_t length;
+        uint8_t value[NVS_VALUE_LEN];
+    };
+
+    struct Scd41Settings
+    {
+        uint16_t ascEnabled;
+        uint16_t ascTarget;
+        uint16_t ascInitialPeriod;
+        uint16_t ascStandardPeriod;
+        float temperatureOffset;
+    };
+
+    struct Scd41State
+    {
+        Scd41Settings ram;
+        Scd41Settings eeprom;
+        uint8_t mode; // see Scd41Model in SensirionI2cScd4x.cpp
+        uint16_t pendingCommand;
+        uint64_t readyAtUs;
+        uint64_t lastCO2ReadyUs; // last CO2 reading that was not the first after wake-up
+        bool dataReady;
+        bool discardNext;
+        uint16_t co2;
+        float temperature;
+        float humidity;
+        uint32_t eepromWrites;
+        uint32_t singleShots;
+        uint32_t rhtShots;
+    };
+
+    struct ZigbeeNetwork
+    {
+        bool commissioned;
+        bool started;
+        uint64_t startedAtUs;
+        uint64_t connectAtUs;
+        uint8_t channel; // channel of the current session, 0 until connected
+        uint16_t lastCO2;
+        uint64_t lastCO2Us;
+        uint64_t lastCO2Session; // startedAtUs of the session that sent lastCO2
+        uint16_t prevCO2;        // newest value of the session before
+        uint64_t prevCO2Us;
+        float lastTemperature;
+        float lastHumidity;
+        uint8_t lastBattery;
+        float lastAnalogInput;
+    };
+
+    static const size_t RTC_IMAGE_MAX = 16384;
+
+    struct World
+    {
+        Config config;
+        Stats stats;
+
+        uint64_t nowUs;
+        uint64_t bootUs;
+        uint32_t wakeCause;
+        float loads[static_cast<size_t>(Load::COUNT)];
+        uint64_t loadUntilUs[static_cast<size_t>(Load::COUNT)];
+        float loadThenMa[static_cast<size_t>(Load::COUNT)];
+        bool lightSleeping;
+
+        // Power management: busy at cpuMaxMhz, idle at cpuMinMhz or in automatic light sleep
+        uint16_t cpuMaxMhz;
+        uint16_t cpuMinMhz;
+        bool pmLightSleep;
+        uint32_t pmLocks;
+        bool cpuIdle;
+
+        // Wake sources armed by the firmware before deep/light sleep
+        bool timerArmed;
+        uint64_t timerUs;
+        uint64_t ext1Mask;
+        bool gpioWakeArmed;
+        int8_t gpioWakeLevel; // Button level that ends a light sleep, -1 when not enabled
+
+        ExitKind exitKind;
+        uint32_t rngState;
+
+        NvsEntry nvs[NVS_MAX_ENTRIES];
+        Scd41State scd41;
+        ZigbeeNetwork zigbee;
+        double roomCO2;
+        uint64_t roomUpdatedUs;
+        bool displayPowered;
+        bool displayFrameThisBoot;
+        bool displayFirstPixelThisBoot;
+
+        size_t rtcSize;
+        uint8_t rtcImage[RTC_IMAGE_MAX];
+    };
+
+    World &world();
+
+    // Simulated clock
+    uint64_t nowUs();
+    uint64_t uptimeUs();
+    void advanceUs(uint64_t us);
+    void advanceMs(uint32_t ms);
+    // Waiting, e.g. in delay() or on the I2C bus: the CPU idles at its lowest clock, or light-sleeps
+    // when power management allows it, no lock is held and lightSleepAllowed (the I2C peripheral
+    // needs its clock)
+    void idleUs(uint64_t us, bool lightSleepAllowed = true);
+    // Work that runs on the CPU and takes us at 80 MHz, shorter or longer at the current clock
+    void cpuBoundUs(uint64_t us);
+
+    // Ground-truth current model
+    void setLoad(Load load, float milliamps);
+    void setLoadUntil(Load load, float milliamps, uint64_t untilUs, float thenMa);
+    float currentMa();
+
+    // Peripheral models
+    bool buttonPressedAt(uint64_t atUs);
+    uint64_t nextButtonPressAfter(uint64_t atUs);
+    // First time from atUs on that the button is at the given level
+    uint64_t nextButtonLevelAt(bool pressed, uint64_t atUs);
+    float batteryVoltage();
+    float stateOfChargePercent();
+    bool coordinatorReachable();
+    // The newest CO2 value received, extrapolated along the slope of the last two sessions for at most an hour
+    float coordinatorPredictedCO2(uint64_t atUs);
+    uint32_t random();
+    float gaussian(float sigma);
+
+    // Runs the callbacks of esp_timers that are due, unless in light sleep
+    void runDueTimers();
+    // Uptime at which the next esp_timer is due, UINT64_MAX with none armed
+    uint64_t nextTimerDueUs();
+
+    // Boot control
+    [[noreturn]] void deepSleep();
+    [[noreturn]] void restart(const char *reason);
+    void lightSleep();
+
+    // Used by the host runner between boots
+    void sleepUntil(uint64_t wakeAtUs);
+    void resetForBoot();
+    size_t rtcSectionSize();
+    uint8_t *rtcSection();
+
+    void log(char level, const char *file, int line, const char *func, const char *fmt, ...);
+    // A log_x() call of the firmware: printed like log(), and formatting it takes CPU time
+    void firmwareLog(char level, const char *file, int line, const char *func, const char *fmt, ...);
+}
+
+#endif
@@ -0,0 +1,210 @@
+#include "Preferences.h"
+
+// Flash access costs, roughly what nvs_open/nvs_get/nvs_set take on the C6
+static const uint32_t NVS_OPEN_US = 400;
+static const uint32_t NVS_READ_US = 60;
+static const uint32_t NVS_WRITE_US = 4000;
+
+enum : uint8_t
+{
+    TYPE_BOOL = 1,
+    TYPE_U8,
+    TYPE_U16,
+    TYPE_U32,
+    TYPE_U64,
+    TYPE_FLOAT,
+    TYPE_BLOB
+};
+
+bool Preferences::begin(const char *name, bool readOnly, const char *partitionLabel)
+{
+    if (opened)
+        return false;
+
+    strncpy(ns, name, sizeof(ns) - 1);
+    this->readOnly = readOnly;
+    opened = true;
+
+    hostsim::world().stats.nvsOpens++;
+    hostsim::advanceUs(NVS_OPEN_US);
+    return true;
+}
+
+void Preferences::end()
+{
+    opened = false;
+}
+
+hostsim::NvsEntry *Preferences::find(const char *key, uint8_t type)
+{
+    hostsim::World &w = hostsim::world();
+    for (hostsim::NvsEntry &entry : w.nvs)
+    {
+        if (entry.used && strcmp(entry.ns, ns) == 0 && strcmp(entry.key, key) == 0 &&
+            (type == 0 || entry.type == type))
+            return &entry;
+    }
+    return nullptr;
+}
+
+size_t Preferences::put(const char *key, uint8_t type, const void *value, size_t length)
+{
+    if (!opened || readOnly || length > hostsim::NVS_VALUE_LEN)
+        return 0;
+
+    hostsim::NvsEntry *entry = find(key, 0);
+    if (entry == nullptr)
+    {
+        for (hostsim::NvsEntry &candidate : hostsim::world().nvs)
+        {
+            if (!candidate.used)
+            {
+                entry = &candidate;
+                break;
+            }
+        }
+        if (entry == nullptr)
+            return 0;
+
+        memset(entry, 0, sizeof(*entry));
+        entry->used = true;
+        memcpy(entry->ns, ns, sizeof(entry->ns));
+        strncpy(entry->key, key, sizeof(entry->key) - 1);
+    }
+
+    entry->type = type;
+    entry->length = static_cast<uint8_t>(length);
+    memcpy(entry->value, value, length);
+
+    hostsim::world().stats.nvsWrites++;
+    hostsim::advanceUs(NVS_WRITE_US);
+    return length;
+}
+
+size_t Preferences::get(const char *key, uint8_t type, void *value, size_t maxLength)
+{
+    if (!opened)
+        return 0;
+
+    hostsim::advanceUs(NVS_READ_US);
+    hostsim::NvsEntry *entry = find(key, type);
+    if (entry == nullptr || entry->length > maxLength)
+        return 0;
+
+    memcpy(value, entry->value, entry->length);
+    return entry->length;
+}
+
+bool Preferences::clear()
+{
+    if (!opened || readOnly)
+        return false;
+
+    for (hostsim::NvsEntry &entry : hostsim::world().nvs)
+    {
+        if (entry.used && strcmp(entry.ns, ns) == 0)
+            entry.used = false;
+    }
+    return true;
+}
+
+bool Preferences::remove(const char *key)
+{
+    if (!opened || readOnly)
+        return false;
+
+    hostsim::NvsEntry *entry = find(key, 0);
+    if (entry == nullptr)
+        return false;
+    entry->used = false;
+    return true;
+}
+
+bool Preferences::isKey(const char *key)
+{
+    return opened && find(key, 0) != nullptr;
+}
+
+size_t Preferences::putBool(const char *key, bool value)
+{
+    uint8_t raw = value ? 1 : 0;
+    return put(key, TYPE_BOOL, &raw, sizeof(raw));
+}
+
+size_t Preferences::putUChar(const char *key, uint8_t value)
+{
+    return put(key, TYPE_U8, &value, sizeof(value));
+}
+
+size_t Preferences::putUShort(const char *key, uint16_t value)
+{
+    return put(key, TYPE_U16, &value, sizeof(value));
+}
+
+size_t Preferences::putUInt(const char *key, uint32_t value)
+{
+    return put(key, TYPE_U32, &value, sizeof(value));
+}
+
+size_t Preferences::putULong64(const char *key, uint64_t value)
+{
+    return put(key, TYPE_U64, &value, sizeof(value));
+}
+
+size_t Preferences::putFloat(const char *key, float value)
+{
+    return put(key, TYPE_FLOAT, &value, sizeof(value));
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t length)
+{
+    return put(key, TYPE_BLOB, value, length);
+}
+
+bool Preferences::getBool(const char *key, bool defaultValue)
+{
+    uint8_t raw = defaultValue ? 1 : 0;
+    get(key, TYPE_BOOL, &raw, sizeof(raw));
+    return raw != 0;
+}
+
+uint8_t Preferences::getUChar(const char *key, uint8_t defaultValue)
+{
+    get(key, TYPE_U8, &defaultValue, sizeof(defaultValue));
+    return defaultValue;
+}
+
+uint16_t Preferences::getUShort(const char *key, uint16_t defaultValue)
+{
+    get(key, TYPE_U16, &defaultValue, sizeof(defaultValue));
+    return defaultValue;
+}
+
+uint32_t Preferences::getUInt(const char *key, uint32_t defaultValue)
+{
+    get(key, TYPE_U32, &defaultValue, sizeof(defaultValue));
+    return defaultValue;
+}
+
+uint64_t Preferences::getULong64(const char *key, uint64_t defaultValue)
+{
+    get(key, TYPE_U64, &defaultValue, sizeof(defaultValue));
+    return defaultValue;
+}
+
+float Preferences::getFloat(const char *key, float defaultValue)
+{
+    get(key, TYPE_FLOAT, &defaultValue, sizeof(defaultValue));
+    return defaultValue;
+}
+
+size_t Preferences::getBytesLength(const char *key)
+{
+    hostsim::NvsEntry *entry = opened ? find(key, TYPE_BLOB) : nullptr;
+    return entry ? entry->length : 0;
+}
+
+size_t Preferences::getBytes(const char *key, void *buffer, size_t maxLength)
+{
+    return get(key, TYPE_BLOB, buffer, maxLength);
+}
@@ -0,0 +1,44 @@
+#ifndef NATIVE_HOST_PREFERENCES_H
+#define NATIVE_HOST_PREFERENCES_H
+
+#include "Arduino.h"
+
+// NVS stand-in backed by the simulated world, so values survive reboots
+class Preferences
+{
+private:
+    char ns[hostsim::NVS_KEY_LEN] = {0};
+    bool opened = false;
+    bool readOnly = false;
+
+    hostsim::NvsEntry *find(const char *key, uint8_t type);
+    size_t put(const char *key, uint8_t type, const void *value, size_t length);
+    size_t get(const char *key, uint8_t type, void *value, size_t maxLength);
+
+public:
+    bool begin(const char *name, bool readOnly = false, const char *partitionLabel = nullptr);
+    void end();
+
+    bool clear();
+    bool remove(const char *key);
+    bool isKey(const char *key);
+
+    size_t putBool(const char *key, bool value);
+    size_t putUChar(const char *key, uint8_t value);
+    size_t putUShort(const char *key, uint16_t value);
+    size_t putUInt(const char *key, uint32_t value);
+    size_t putULong64(const char *key, uint64_t value);
+    size_t putFloat(const char *key, float value);
+    size_t putBytes(const char *key, const void *value, size_t length);
+
+    bool getBool(const char *key, bool defaultValue = false);
+    uint8_t getUChar(const char *key, uint8_t defaultValue = 0);
+    uint16_t getUShort(const char *key, uint16_t defaultValue = 0);
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0);
+    uint64_t getULong64(const char *key, uint64_t defaultValue = 0);
+    float getFloat(const char *key, float defaultValue = NAN);
+    size_t getBytesLength(const char *key);
+    size_t getBytes(const char *key, void *buffer, size_t maxLength);
+};
+
+#endif
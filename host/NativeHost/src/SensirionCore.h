@@ -0,0 +1,55 @@
+#ifndef NATIVE_HOST_SENSIRION_CORE_H
+#define NATIVE_HOST_SENSIRION_CORE_H
+
+#include "Wire.h"
+
+enum HighLevelError : uint16_t
+{
+    NoError = 0,
+    WriteError = 0x0100,
+    ReadError = 0x0200,
+    TxFrameError = 0x0300,
+    RxFrameError = 0x0400,
+};
+
+enum LowLevelError : uint16_t
+{
+    CrcError = 1,
+    WrongNumberOfBytesError,
+    FragmentSizeError,
+    TxBufferTooSmallError,
+    NonemptyFrameError,
+    TimeoutError,
+    NotEnoughDataError,
+    InternalBufferSizeError,
+    I2cAddressNack,
+    I2cDataNack,
+    I2cOtherError,
+};
+
+void errorToString(uint16_t error, char errorMessage[], size_t errorMessageSize);
+
+class SensirionI2CTxFrame
+{
+private:
+    uint8_t *buffer;
+    size_t bufferSize;
+    size_t index = 0;
+
+public:
+    SensirionI2CTxFrame(uint8_t buffer[], size_t bufferSize) : buffer(buffer), bufferSize(bufferSize) {}
+
+    static SensirionI2CTxFrame createWithUInt16Command(uint16_t command, uint8_t buffer[], size_t bufferSize);
+    uint16_t addUInt16(uint16_t data);
+
+    uint16_t command() const { return static_cast<uint16_t>(buffer[0] << 8 | buffer[1]); }
+    size_t size() const { return index; }
+};
+
+class SensirionI2CCommunication
+{
+public:
+    static uint16_t sendFrame(uint8_t address, SensirionI2CTxFrame &frame, TwoWire &i2cBus);
+};
+
+#endif
@@ -0,0 +1,481 @@
+#include "SensirionI2cScd4x.h"
+
+#include <algorithm>
+
+namespace
+{
+    enum Command : uint16_t
+    {
+        SET_TEMPERATURE_OFFSET = 0x241d,
+        GET_TEMPERATURE_OFFSET = 0x2318,
+        SET_ASC_ENABLED = 0x2416,
+        GET_ASC_ENABLED = 0x2313,
+        SET_ASC_TARGET = 0x243a,
+        GET_ASC_TARGET = 0x233f,
+        SET_ASC_INITIAL_PERIOD = 0x2445,
+        GET_ASC_INITIAL_PERIOD = 0x2340,
+        SET_ASC_STANDARD_PERIOD = 0x244e,
+        GET_ASC_STANDARD_PERIOD = 0x234b,
+        GET_DATA_READY_STATUS = 0xe4b8,
+        READ_MEASUREMENT = 0xec05,
+        MEASURE_SINGLE_SHOT = 0x219d,
+        MEASURE_SINGLE_SHOT_RHT_ONLY = 0x2196,
+        PERSIST_SETTINGS = 0x3615,
+        GET_SERIAL_NUMBER = 0x3682,
+        REINIT = 0x3646,
+        POWER_DOWN = 0x36e0,
+        WAKE_UP = 0x36f6,
+    };
+
+    enum Mode : uint8_t
+    {
+        IDLE,
+        MEASURING,
+        POWERED_DOWN,
+    };
+
+    // Command execution times from the SCD4x datasheet
+    const uint32_t SINGLE_SHOT_MS = 5000;
+    // This unit completes single shots faster than the datasheet maximum, with some jitter
+    const float SINGLE_SHOT_TYPICAL_MS = 4820.0f;
+    const float SINGLE_SHOT_JITTER_MS = 8.0f;
+    const uint32_t RHT_ONLY_MS = 50;
+    const uint32_t PERSIST_MS = 800;
+    const uint32_t WAKE_UP_MS = 30;
+    const uint32_t REINIT_MS = 30;
+    const uint32_t COMMAND_MS = 1;
+
+    // Room model: one person at a desk during office hours, meetings twice a day
+    const double OUTDOOR_CO2 = 420.0;
+    const double PPM_PER_PERSON_HOUR = 600.0;
+    const double AIR_CHANGES_PER_HOUR = 1.0;
+    const uint64_t ROOM_STEP_US = 60 * hostsim::US_PER_S;
+    const float CO2_NOISE_PPM = 8.0f;
+
+    hostsim::Scd41State &state()
+    {
+        return hostsim::world().scd41;
+    }
+
+    double hourOfDay(uint64_t us)
+    {
+        return static_cast<double>(us % (24ULL * 3600 * hostsim::US_PER_S)) / (3600.0 * hostsim::US_PER_S);
+    }
+
+    int occupantsAt(uint64_t us)
+    {
+        uint64_t day = us / (24ULL * 3600 * hostsim::US_PER_S);
+        if (day % 7 >= 5)
+            return 0;
+
+        double hour = hourOfDay(us);
+        if (hour < 8.0 || hour >= 17.0)
+            return 0;
+        if ((hour >= 10.0 && hour < 11.0) || (hour >= 14.0 && hour < 15.5))
+            return 5;
+        return 1;
+    }
+
+    void updateRoom(uint64_t untilUs)
+    {
+        hostsim::World &w = hostsim::world();
+        if (w.roomCO2 == 0.0)
+            w.roomCO2 = OUTDOOR_CO2;
+
+        const double stepHours = static_cast<double>(ROOM_STEP_US) / (3600.0 * hostsim::US_PER_S);
+        while (w.roomUpdatedUs + ROOM_STEP_US <= untilUs)
+        {
+            double generation = occupantsAt(w.roomUpdatedUs) * PPM_PER_PERSON_HOUR;
+            double ventilation = AIR_CHANGES_PER_HOUR * (w.roomCO2 - OUTDOOR_CO2);
+            w.roomCO2 += (generation - ventilation) * stepHours;
+            w.roomUpdatedUs += ROOM_STEP_US;
+        }
+    }
+
+    void sample(hostsim::Scd41State &s)
+    {
+        updateRoom(s.readyAtUs);
+
+        double phase = (hourOfDay(s.readyAtUs) - 9.0) / 24.0 * 6.2831853;
+        float occupied = occupantsAt(s.readyAtUs) > 0 ? 0.8f : 0.0f;
+        float roomTemperature = 20.5f + static_cast<float>(sin(phase)) + occupied;
+        float roomHumidity = 45.0f - 4.0f * static_cast<float>(sin(phase));
+        s.temperature = roomTemperature - s.ram.temperatureOffset + hostsim::gaussian(0.05f);
+        s.humidity = roomHumidity + hostsim::gaussian(0.3f);
+
+        hostsim::World &world = hostsim::world();
+        if (world.zigbee.lastHumidity != 0.0f)
+        {
+            world.stats.temperatureErrorC += fabs(roomTemperature - world.zigbee.lastTemperature);
+            world.stats.humidityErrorRh += fabs(roomHumidity - world.zigbee.lastHumidity);
+            world.stats.climateErrorSamples++;
+        }
+
+        if (s.pendingCommand == MEASURE_SINGLE_SHOT_RHT_ONLY)
+        {
+            s.co2 = 0;
+        }
+        else
+        {
+            hostsim::World &w = hostsim::world();
+            if (w.zigbee.lastCO2 != 0)
+            {
+                w.stats.holdErrorPpm += fabs(w.roomCO2 - w.zigbee.lastCO2);
+                w.stats.predictErrorPpm += fabs(w.roomCO2 - hostsim::coordinatorPredictedCO2(hostsim::nowUs()));
+                w.stats.errorSamples++;
+            }
+
+            float co2 = static_cast<float>(w.roomCO2) + hostsim::gaussian(CO2_NOISE_PPM);
+            // The first single shot after wake-up is documented as unreliable
+            if (s.discardNext)
+                co2 += 80.0f + hostsim::gaussian(40.0f);
+            s.co2 = static_cast<uint16_t>(co2 < 0.0f ? 0.0f : co2);
+            if (!s.discardNext)
+            {
+                // Readings on a grid of whole seconds are spaced by whole seconds
+                if (s.lastCO2ReadyUs != 0)
+                {
+                    uint64_t offUs = (s.readyAtUs - s.lastCO2ReadyUs) % hostsim::US_PER_S;
+                    w.stats.co2SpacingErrorUs += std::min(offUs, hostsim::US_PER_S - offUs);
+                    w.stats.co2Spacings++;
+                }
+                s.lastCO2ReadyUs = s.readyAtUs;
+            }
+            s.discardNext = false;
+        }
+        s.dataReady = true;
+    }
+
+    // A shot started during a fault hangs until the fault clears
+    bool faultAt(uint64_t us)
+    {
+        const hostsim::Config &c = hostsim::world().config;
+        return us >= c.sensorFaultStartUs && us < c.sensorFaultEndUs;
+    }
+
+    void update()
+    {
+        hostsim::Scd41State &s = state();
+        if (s.mode == MEASURING && hostsim::nowUs() >= s.readyAtUs)
+        {
+            sample(s);
+            s.mode = IDLE;
+        }
+    }
+
+    bool accepts(uint16_t command)
+    {
+        update();
+        switch (state().mode)
+        {
+        case POWERED_DOWN:
+            return command == WAKE_UP;
+        case MEASURING:
+            return command == GET_DATA_READY_STATUS;
+        default:
+            return true;
+        }
+    }
+
+    void startShot(uint16_t command, uint32_t durationMs)
+    {
+        hostsim::Scd41State &s = state();
+        s.mode = MEASURING;
+        s.pendingCommand = command;
+        s.dataReady = false;
+        s.readyAtUs = hostsim::nowUs() + durationMs * hostsim::US_PER_MS;
+        hostsim::setLoadUntil(hostsim::Load::SENSOR, hostsim::SCD41_MEASURING_MA, s.readyAtUs, hostsim::SCD41_IDLE_MA);
+    }
+
+    // Write-only commands, shared by the driver and raw frames sent through SensirionI2CCommunication
+    uint16_t execute(uint16_t command)
+    {
+        if (!accepts(command))
+            return WriteError | I2cAddressNack;
+
+        hostsim::Scd41State &s = state();
+        switch (command)
+        {
+        case MEASURE_SINGLE_SHOT:
+            s.singleShots++;
+            hostsim::world().stats.co2Measurements++;
+            if (faultAt(hostsim::nowUs()))
+                startShot(command, static_cast<uint32_t>((hostsim::world().config.sensorFaultEndUs - hostsim::nowUs()) / hostsim::US_PER_MS));
+            else
+                startShot(command, static_cast<uint32_t>(std::min(SINGLE_SHOT_TYPICAL_MS + hostsim::gaussian(SINGLE_SHOT_JITTER_MS),
+                                                                  static_cast<float>(SINGLE_SHOT_MS))));
+            break;
+        case MEASURE_SINGLE_SHOT_RHT_ONLY:
+            s.rhtShots++;
+            startShot(command, RHT_ONLY_MS);
+            break;
+        case PERSIST_SETTINGS:
+            s.eeprom = s.ram;
+            s.eepromWrites++;
+            break;
+        case REINIT:
+            s.ram = s.eeprom;
+            break;
+        case POWER_DOWN:
+            s.mode = POWERED_DOWN;
+            s.dataReady = false;
+            hostsim::setLoad(hostsim::Load::SENSOR, hostsim::SCD41_POWER_DOWN_MA);
+            break;
+        case WAKE_UP:
+            if (s.mode == POWERED_DOWN)
+            {
+                s.mode = IDLE;
+                s.ram = s.eeprom;
+                s.discardNext = true;
+                hostsim::setLoad(hostsim::Load::SENSOR, hostsim::SCD41_IDLE_MA);
+            }
+            break;
+        default:
+            break;
+        }
+        return NoError;
+    }
+}
+
+void errorToString(uint16_t error, char errorMessage[], size_t errorMessageSize)
+{
+    const char *high = (error & 0xff00) == WriteError ? "Write error" : "Read error";
+    const char *low = (error & 0x00ff) == I2cAddressNack ? "address NACK" : "unknown";
+    snprintf(errorMessage, errorMessageSize, "%s: %s", high, low);
+}
+
+SensirionI2CTxFrame SensirionI2CTxFrame::createWithUInt16Command(uint16_t command, uint8_t buffer[], size_t bufferSize)
+{
+    SensirionI2CTxFrame frame(buffer, bufferSize);
+    frame.addUInt16(command);
+    return frame;
+}
+
+uint16_t SensirionI2CTxFrame::addUInt16(uint16_t data)
+{
+    if (index + 2 > bufferSize)
+        return TxFrameError | TxBufferTooSmallError;
+    buffer[index++] = static_cast<uint8_t>(data >> 8);
+    buffer[index++] = static_cast<uint8_t>(data & 0xff);
+    return NoError;
+}
+
+uint16_t SensirionI2CCommunication::sendFrame(uint8_t address, SensirionI2CTxFrame &frame, TwoWire &i2cBus)
+{
+    i2cBus.transfer(1 + frame.size());
+    if (address != SCD41_I2C_ADDR_62)
+        return WriteError | I2cAddressNack;
+    return execute(frame.command());
+}
+
+void SensirionI2cScd4x::begin(TwoWire &i2cBus, uint8_t i2cAddress)
+{
+    bus = &i2cBus;
+    address = i2cAddress;
+}
+
+int16_t SensirionI2cScd4x::writeWords(uint16_t command, size_t words, uint32_t executionMs)
+{
+    TwoWire &i2c = bus ? *bus : Wire;
+    if (!accepts(command))
+    {
+        i2c.transfer(1);
+        return WriteError | I2cAddressNack;
+    }
+
+    i2c.transfer(3 + words * 3);
+    delay(executionMs);
+    return NoError;
+}
+
+int16_t SensirionI2cScd4x::readWords(uint16_t command, size_t words, uint32_t executionMs)
+{
+    int16_t error = writeWords(command, 0, executionMs);
+    if (error != NoError)
+        return error;
+
+    (bus ? *bus : Wire).transfer(1 + words * 3);
+    return NoError;
+}
+
+int16_t SensirionI2cScd4x::setTemperatureOffset(float offsetTemperature)
+{
+    int16_t error = writeWords(SET_TEMPERATURE_OFFSET, 1, COMMAND_MS);
+    if (error == NoError)
+        state().ram.temperatureOffset = offsetTemperature;
+    return error;
+}
+
+int16_t SensirionI2cScd4x::getTemperatureOffset(float &offsetTemperature)
+{
+    int16_t error = readWords(GET_TEMPERATURE_OFFSET, 1, COMMAND_MS);
+    if (error == NoError)
+        offsetTemperature = state().ram.temperatureOffset;
+    return error;
+}
+
+int16_t SensirionI2cScd4x::setAutomaticSelfCalibrationEnabled(uint16_t ascEnabled)
+{
+    int16_t error = writeWords(SET_ASC_ENABLED, 1, COMMAND_MS);
+    if (error == NoError)
+        state().ram.ascEnabled = ascEnabled;
+    return error;
+}
+
+int16_t SensirionI2cScd4x::getAutomaticSelfCalibrationEnabled(uint16_t &ascEnabled)
+{
+    int16_t error = readWords(GET_ASC_ENABLED, 1, COMMAND_MS);
+    if (error == NoError)
+        ascEnabled = state().ram.ascEnabled;
+    return error;
+}
+
+int16_t SensirionI2cScd4x::setAutomaticSelfCalibrationTarget(uint16_t ascTarget)
+{
+    int16_t error = writeWords(SET_ASC_TARGET, 1, COMMAND_MS);
+    if (error == NoError)
+        state().ram.ascTarget = ascTarget;
+    return error;
+}
+
+int16_t SensirionI2cScd4x::getAutomaticSelfCalibrationTarget(uint16_t &ascTarget)
+{
+    int16_t error = readWords(GET_ASC_TARGET, 1, COMMAND_MS);
+    if (error == NoError)
+        ascTarget = state().ram.ascTarget;
+    return error;
+}
+
+int16_t SensirionI2cScd4x::setAutomaticSelfCalibrationInitialPeriod(uint16_t ascInitialPeriod)
+{
+    int16_t error = writeWords(SET_ASC_INITIAL_PERIOD, 1, COMMAND_MS);
+    if (error == NoError)
+        state().ram.ascInitialPeriod = ascInitialPeriod;
+    return error;
+}
+
+int16_t SensirionI2cScd4x::getAutomaticSelfCalibrationInitialPeriod(uint16_t &ascInitialPeriod)
+{
+    int16_t error = readWords(GET_ASC_INITIAL_PERIOD, 1, COMMAND_MS);
+    if (error == NoError)
+        ascInitialPeriod = state().ram.ascInitialPeriod;
+    return error;
+}
+
+int16_t SensirionI2cScd4x::setAutomaticSelfCalibrationStandardPeriod(uint16_t ascStandardPeriod)
+{
+    int16_t error = writeWords(SET_ASC_STANDARD_PERIOD, 1, COMMAND_MS);
+    if (error == NoError)
+        state().ram.ascStandardPeriod = ascStandardPeriod;
+    return error;
+}
+
+int16_t SensirionI2cScd4x::getAutomaticSelfCalibrationStandardPeriod(uint16_t &ascStandardPeriod)
+{
+    int16_t error = readWords(GET_ASC_STANDARD_PERIOD, 1, COMMAND_MS);
+    if (error == NoError)
+        ascStandardPeriod = state().ram.ascStandardPeriod;
+    return error;
+}
+
+int16_t SensirionI2cScd4x::getDataReadyStatus(bool &arg0)
+{
+    int16_t error = readWords(GET_DATA_READY_STATUS, 1, COMMAND_MS);
+    if (error == NoError)
+    {
+        update();
+        arg0 = state().dataReady;
+    }
+    return error;
+}
+
+int16_t SensirionI2cScd4x::readMeasurement(uint16_t &co2Concentration, float &temperature, float &relativeHumidity)
+{
+    hostsim::Scd41State &s = state();
+    update();
+    if (!s.dataReady)
+    {
+        (bus ? *bus : Wire).transfer(3);
+        return ReadError | I2cAddressNack;
+    }
+
+    int16_t error = readWords(READ_MEASUREMENT, 3, COMMAND_MS);
+    if (error != NoError)
+        return error;
+
+    co2Concentration = s.co2;
+    temperature = s.temperature;
+    relativeHumidity = s.humidity;
+    s.dataReady = false;
+    return NoError;
+}
+
+int16_t SensirionI2cScd4x::measureSingleShot()
+{
+    (bus ? *bus : Wire).transfer(3);
+    int16_t error = execute(MEASURE_SINGLE_SHOT);
+    if (error == NoError)
+        delay(SINGLE_SHOT_MS);
+    return error;
+}
+
+int16_t SensirionI2cScd4x::measureSingleShotRhtOnly()
+{
+    (bus ? *bus : Wire).transfer(3);
+    int16_t error = execute(MEASURE_SINGLE_SHOT_RHT_ONLY);
+    if (error == NoError)
+        delay(RHT_ONLY_MS);
+    return error;
+}
+
+int16_t SensirionI2cScd4x::measureAndReadSingleShot(uint16_t &co2Concentration, float &temperature, float &relativeHumidity)
+{
+    int16_t error = measureSingleShot();
+    if (error != NoError)
+        return error;
+    return readMeasurement(co2Concentration, temperature, relativeHumidity);
+}
+
+int16_t SensirionI2cScd4x::persistSettings()
+{
+    (bus ? *bus : Wire).transfer(3);
+    int16_t error = execute(PERSIST_SETTINGS);
+    if (error == NoError)
+        delay(PERSIST_MS);
+    return error;
+}
+
+int16_t SensirionI2cScd4x::reinit()
+{
+    (bus ? *bus : Wire).transfer(3);
+    int16_t error = execute(REINIT);
+    if (error == NoError)
+        delay(REINIT_MS);
+    return error;
+}
+
+int16_t SensirionI2cScd4x::powerDown()
+{
+    (bus ? *bus : Wire).transfer(3);
+    int16_t error = execute(POWER_DOWN);
+    if (error == NoError)
+        delay(COMMAND_MS);
+    return error;
+}
+
+int16_t SensirionI2cScd4x::wakeUp()
+{
+    // The sensor does not acknowledge wake_up, the driver ignores the result
+    (bus ? *bus : Wire).transfer(3);
+    execute(WAKE_UP);
+    delay(WAKE_UP_MS);
+    return NoError;
+}
+
+int16_t SensirionI2cScd4x::getSerialNumber(uint64_t &serialNumber)
+{
+    int16_t error = readWords(GET_SERIAL_NUMBER, 3, COMMAND_MS);
+    if (error == NoError)
+        serialNumber = 0x0000a5c3b2e1ULL;
+    return error;
+}
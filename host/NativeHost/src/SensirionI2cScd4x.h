@@ -0,0 +1,49 @@
+#ifndef NATIVE_HOST_SENSIRION_I2C_SCD4X_H
+#define NATIVE_HOST_SENSIRION_I2C_SCD4X_H
+
+#include "SensirionCore.h"
+
+#define SCD41_I2C_ADDR_62 0x62
+
+/**
+ * Stand-in for the Sensirion SCD4x driver, backed by a simulated SCD41 in
+ * single-shot mode: volatile and EEPROM settings, command execution times,
+ * power-down/wake-up and a room whose CO2 follows office occupancy.
+ */
+class SensirionI2cScd4x
+{
+private:
+    TwoWire *bus = nullptr;
+    uint8_t address = 0;
+
+    int16_t readWords(uint16_t command, size_t words, uint32_t executionMs);
+    int16_t writeWords(uint16_t command, size_t words, uint32_t executionMs);
+
+public:
+    void begin(TwoWire &i2cBus, uint8_t i2cAddress);
+
+    int16_t setTemperatureOffset(float offsetTemperature);
+    int16_t getTemperatureOffset(float &offsetTemperature);
+    int16_t setAutomaticSelfCalibrationEnabled(uint16_t ascEnabled);
+    int16_t getAutomaticSelfCalibrationEnabled(uint16_t &ascEnabled);
+    int16_t setAutomaticSelfCalibrationTarget(uint16_t ascTarget);
+    int16_t getAutomaticSelfCalibrationTarget(uint16_t &ascTarget);
+    int16_t setAutomaticSelfCalibrationInitialPeriod(uint16_t ascInitialPeriod);
+    int16_t getAutomaticSelfCalibrationInitialPeriod(uint16_t &ascInitialPeriod);
+    int16_t setAutomaticSelfCalibrationStandardPeriod(uint16_t ascStandardPeriod);
+    int16_t getAutomaticSelfCalibrationStandardPeriod(uint16_t &ascStandardPeriod);
+
+    int16_t getDataReadyStatus(bool &arg0);
+    int16_t readMeasurement(uint16_t &co2Concentration, float &temperature, float &relativeHumidity);
+    int16_t measureSingleShot();
+    int16_t measureSingleShotRhtOnly();
+    int16_t measureAndReadSingleShot(uint16_t &co2Concentration, float &temperature, float &relativeHumidity);
+
+    int16_t persistSettings();
+    int16_t reinit();
+    int16_t powerDown();
+    int16_t wakeUp();
+    int16_t getSerialNumber(uint64_t &serialNumber);
+};
+
+#endif
@@ -0,0 +1,239 @@
+#include "U8g2lib.h"
+
+struct u8g2_cb_struct
+{
+    uint8_t rotation;
+};
+
+struct u8x8_struct
+{
+    uint32_t bus_clock;
+};
+
+static const u8g2_cb_t rotation0 = {0};
+const u8g2_cb_t *U8G2_R0 = &rotation0;
+static u8x8_t u8x8 = {0};
+
+const uint8_t u8g2_font_logisoso32_tn[] = {20, 32};
+const uint8_t u8g2_font_9x18_tr[] = {9, 13};
+
+static const uint8_t TILE_COLUMNS = 16;
+static const uint8_t PAGE_COUNT = 8;
+static const size_t PAGE_BYTES = 128;
+static const size_t INIT_SEQUENCE_BYTES = 28;
+// Arduino Wire buffers 32 bytes: address and control byte, then up to 30 data bytes
+static const size_t I2C_CHUNK_BYTES = 30;
+// The SSD1315 display info asks for 400 kHz unless setBusClock() says otherwise
+static const uint32_t DEFAULT_BUS_CLOCK = 400000;
+// Rasterising one glyph into the buffer at 160 MHz
+static const uint64_t GLYPH_DRAW_US = 12;
+
+static uint64_t frameStartUs = 0;
+static uint64_t frameStartBytes = 0;
+
+// The first frame drawn in this boot is on a lit panel
+static void recordFirstPixel()
+{
+    hostsim::World &w = hostsim::world();
+    if (w.displayPowered && w.displayFrameThisBoot && !w.displayFirstPixelThisBoot)
+    {
+        w.displayFirstPixelThisBoot = true;
+        w.stats.displayFirstPixels++;
+        w.stats.displayFirstPixelUs += hostsim::uptimeUs();
+    }
+}
+
+// Like the U8x8 Arduino byte callback, set the clock at the start of every transfer and leave it there
+static void startTransfer()
+{
+    Wire.setClock(u8x8.bus_clock != 0 ? u8x8.bus_clock : DEFAULT_BUS_CLOCK);
+}
+
+static void sendCommands(size_t bytes)
+{
+    startTransfer();
+    hostsim::world().stats.displayBytes += bytes + 2;
+    Wire.transfer(bytes + 2);
+}
+
+static void sendData(size_t bytes)
+{
+    while (bytes > 0)
+    {
+        size_t chunk = bytes < I2C_CHUNK_BYTES ? bytes : I2C_CHUNK_BYTES;
+        startTransfer();
+        hostsim::world().stats.displayBytes += chunk + 2;
+        Wire.transfer(chunk + 2);
+        bytes -= chunk;
+    }
+}
+
+uint8_t u8x8_DrawTile(u8x8_t *u8x8, uint8_t x, uint8_t y, uint8_t cnt, uint8_t *tile_ptr)
+{
+    // Set column/page address, then 8 bytes per tile
+    sendCommands(3);
+    sendData(cnt * 8);
+    return 1;
+}
+
+void U8G2::beginFrame()
+{
+    frameStartUs = hostsim::nowUs();
+    frameStartBytes = hostsim::world().stats.displayBytes;
+}
+
+bool U8G2::begin()
+{
+    beginSimple();
+    firstPage();
+    while (nextPage())
+        ;
+    setPowerSave(0);
+    return true;
+}
+
+void U8G2::beginSimple()
+{
+    sendCommands(INIT_SEQUENCE_BYTES);
+}
+
+void U8G2::setPowerSave(uint8_t isEnable)
+{
+    sendCommands(1);
+    hostsim::world().displayPowered = isEnable == 0;
+    hostsim::setLoad(hostsim::Load::DISPLAY, isEnable ? 0.0f : hostsim::DISPLAY_ON_MA);
+    recordFirstPixel();
+}
+
+void U8G2::setBusClock(uint32_t clock_speed)
+{
+    u8x8.bus_clock = clock_speed;
+}
+
+void U8G2::refreshDisplay()
+{
+    hostsim::Stats &stats = hostsim::world().stats;
+    stats.displayFrames++;
+    stats.displayUs += hostsim::nowUs() - frameStartUs;
+    stats.displayFrameBytes += stats.displayBytes - frameStartBytes;
+    hostsim::world().displayFrameThisBoot = true;
+    recordFirstPixel();
+}
+
+void U8G2::setFont(const uint8_t *font)
+{
+    this->font = font;
+}
+
+void U8G2::drawPixel(int16_t x, int16_t y)
+{
+    if (x < 0 || x >= 128 || y < 0 || y >= 64)
+        return;
+    buffer[(y / 8) * PAGE_BYTES + x] |= 1 << (y % 8);
+}
+
+uint16_t U8G2::drawStr(int16_t x, int16_t y, const char *str)
+{
+    if (!font)
+        return 0;
+
+    for (const char *c = str; *c; c++, x += font[0])
+    {
+        hostsim::cpuBoundUs(GLYPH_DRAW_US);
+        // The last column is the gap to the next glyph
+        for (uint8_t column = 0; column + 1 < font[0]; column++)
+        {
+            uint32_t bits = (static_cast<uint8_t>(*c) * 2654435761u) ^ (column * 40503u);
+            bits ^= bits >> 13;
+            bits *= 0x5bd1e995u;
+            for (uint8_t row = 0; row < font[1]; row++)
+                if (bits & (1u << (row % 32)))
+                    drawPixel(x + column, y - font[1] + row);
+        }
+    }
+    return getStrWidth(str);
+}
+
+uint16_t U8G2::getStrWidth(const char *str)
+{
+    return font ? static_cast<uint16_t>(strlen(str) * font[0]) : 0;
+}
+
+void U8G2::drawCircle(int16_t x0, int16_t y0, int16_t rad)
+{
+    int16_t x = rad, y = 0, err = 1 - rad;
+    while (x >= y)
+    {
+        drawPixel(x0 + x, y0 + y), drawPixel(x0 - x, y0 + y), drawPixel(x0 + x, y0 - y), drawPixel(x0 - x, y0 - y);
+        drawPixel(x0 + y, y0 + x), drawPixel(x0 - y, y0 + x), drawPixel(x0 + y, y0 - x), drawPixel(x0 - y, y0 - x);
+        y++;
+        err += err < 0 ? 2 * y + 1 : 2 * (y - --x) + 1;
+    }
+}
+
+uint8_t *U8G2::getBufferPtr()
+{
+    return buffer;
+}
+
+uint8_t U8G2::getBufferTileWidth()
+{
+    return TILE_COLUMNS;
+}
+
+uint8_t U8G2::getBufferTileHeight()
+{
+    return PAGE_COUNT;
+}
+
+u8x8_t *U8G2::getU8x8()
+{
+    return &u8x8;
+}
+
+U8G2_SSD1315_128X64_NONAME_1_HW_I2C::U8G2_SSD1315_128X64_NONAME_1_HW_I2C(const u8g2_cb_t *rotation, uint8_t reset,
+                                                                         uint8_t clock, uint8_t data)
+{
+}
+
+void U8G2_SSD1315_128X64_NONAME_1_HW_I2C::firstPage()
+{
+    beginFrame();
+    page = 0;
+    memset(buffer, 0, sizeof(buffer));
+}
+
+uint8_t U8G2_SSD1315_128X64_NONAME_1_HW_I2C::nextPage()
+{
+    // The whole scene is drawn again for each page; only this page is sent
+    u8x8_DrawTile(&u8x8, 0, page, TILE_COLUMNS, buffer + page * PAGE_BYTES);
+    return ++page < PAGE_COUNT;
+}
+
+U8G2_SSD1315_128X64_NONAME_F_HW_I2C::U8G2_SSD1315_128X64_NONAME_F_HW_I2C(const u8g2_cb_t *rotation, uint8_t reset,
+                                                                         uint8_t clock, uint8_t data)
+{
+}
+
+void U8G2_SSD1315_128X64_NONAME_F_HW_I2C::firstPage()
+{
+    clearBuffer();
+}
+
+uint8_t U8G2_SSD1315_128X64_NONAME_F_HW_I2C::nextPage()
+{
+    sendBuffer();
+    return 0;
+}
+
+void U8G2_SSD1315_128X64_NONAME_F_HW_I2C::clearBuffer()
+{
+    beginFrame();
+    memset(buffer, 0, sizeof(buffer));
+}
+
+void U8G2_SSD1315_128X64_NONAME_F_HW_I2C::sendBuffer()
+{
+    for (uint8_t page = 0; page < PAGE_COUNT; page++)
+        u8x8_DrawTile(&u8x8, 0, page, TILE_COLUMNS, buffer + page * PAGE_BYTES);
+}
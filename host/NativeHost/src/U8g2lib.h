@@ -0,0 +1,81 @@
+#ifndef NATIVE_HOST_U8G2LIB_H
+#define NATIVE_HOST_U8G2LIB_H
+
+#include "Wire.h"
+
+/**
+ * Stand-in for the U8g2 SSD1315 drivers, page buffer (_1_) and full buffer
+ * (_F_). Glyphs are rasterised as fixed pseudo-random bit columns, enough for
+ * the frame to change exactly where the text does. The model accounts the I2C
+ * traffic, the time from the start of a frame to refreshDisplay(), and the
+ * panel current.
+ */
+
+#define U8X8_PIN_NONE 255
+
+typedef struct u8g2_cb_struct u8g2_cb_t;
+extern const u8g2_cb_t *U8G2_R0;
+
+typedef struct u8x8_struct u8x8_t;
+uint8_t u8x8_DrawTile(u8x8_t *u8x8, uint8_t x, uint8_t y, uint8_t cnt, uint8_t *tile_ptr);
+
+// Stand-in fonts are the advance width and the height above the baseline, in pixels
+extern const uint8_t u8g2_font_logisoso32_tn[];
+extern const uint8_t u8g2_font_9x18_tr[];
+
+class U8G2
+{
+protected:
+    const uint8_t *font = nullptr;
+    uint8_t buffer[128 * 64 / 8] = {};
+
+    void drawPixel(int16_t x, int16_t y);
+    void beginFrame();
+
+public:
+    bool begin();
+    void beginSimple();
+    void setPowerSave(uint8_t isEnable);
+    void setBusClock(uint32_t clock_speed);
+    void refreshDisplay();
+
+    virtual void firstPage() = 0;
+    virtual uint8_t nextPage() = 0;
+
+    void setFont(const uint8_t *font);
+    uint16_t drawStr(int16_t x, int16_t y, const char *str);
+    uint16_t getStrWidth(const char *str);
+    void drawCircle(int16_t x0, int16_t y0, int16_t rad);
+
+    uint8_t *getBufferPtr();
+    uint8_t getBufferTileWidth();
+    uint8_t getBufferTileHeight();
+    u8x8_t *getU8x8();
+};
+
+class U8G2_SSD1315_128X64_NONAME_1_HW_I2C : public U8G2
+{
+private:
+    uint8_t page = 0;
+
+public:
+    U8G2_SSD1315_128X64_NONAME_1_HW_I2C(const u8g2_cb_t *rotation, uint8_t reset = U8X8_PIN_NONE,
+                                        uint8_t clock = U8X8_PIN_NONE, uint8_t data = U8X8_PIN_NONE);
+
+    void firstPage() override;
+    uint8_t nextPage() override;
+};
+
+class U8G2_SSD1315_128X64_NONAME_F_HW_I2C : public U8G2
+{
+public:
+    U8G2_SSD1315_128X64_NONAME_F_HW_I2C(const u8g2_cb_t *rotation, uint8_t reset = U8X8_PIN_NONE,
+                                        uint8_t clock = U8X8_PIN_NONE, uint8_t data = U8X8_PIN_NONE);
+
+    void firstPage() override;
+    uint8_t nextPage() override;
+    void clearBuffer();
+    void sendBuffer();
+};
+
+#endif
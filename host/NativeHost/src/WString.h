@@ -0,0 +1,41 @@
+#ifndef NATIVE_HOST_WSTRING_H
+#define NATIVE_HOST_WSTRING_H
+
+#include <string>
+
+// Subset of the Arduino String class used by the firmware
+class String
+{
+private:
+    std::string value;
+
+public:
+    String(const char *str = "") : value(str ? str : "") {}
+    String(const std::string &str) : value(str) {}
+    explicit String(int number) : value(std::to_string(number)) {}
+    explicit String(unsigned int number) : value(std::to_string(number)) {}
+    explicit String(long number) : value(std::to_string(number)) {}
+    explicit String(unsigned long number) : value(std::to_string(number)) {}
+    String(float number, unsigned int decimalPlaces = 2);
+    String(double number, unsigned int decimalPlaces = 2);
+
+    const char *c_str() const { return value.c_str(); }
+    unsigned int length() const { return static_cast<unsigned int>(value.length()); }
+
+    String &operator+=(const String &rhs)
+    {
+        value += rhs.value;
+        return *this;
+    }
+
+    friend String operator+(const String &lhs, const String &rhs) { return String(lhs.value + rhs.value); }
+    friend String operator+(const String &lhs, const char *rhs) { return String(lhs.value + rhs); }
+    friend String operator+(const char *lhs, const String &rhs) { return String(lhs + rhs.value); }
+
+    bool operator==(const String &rhs) const { return value == rhs.value; }
+    bool operator==(const char *rhs) const { return value == rhs; }
+    bool operator!=(const String &rhs) const { return value != rhs.value; }
+    bool operator!=(const char *rhs) const { return value != rhs; }
+};
+
+#endif
@@ -0,0 +1,36 @@
+#include "Wire.h"
+
+TwoWire Wire;
+
+bool TwoWire::begin(int sda, int scl, uint32_t freq)
+{
+    if (freq != 0)
+        frequency = freq;
+    return true;
+}
+
+bool TwoWire::end()
+{
+    return true;
+}
+
+bool TwoWire::setClock(uint32_t freq)
+{
+    frequency = freq;
+    return true;
+}
+
+uint32_t TwoWire::getClock()
+{
+    return frequency;
+}
+
+void TwoWire::transfer(size_t bytes)
+{
+    hostsim::Stats &stats = hostsim::world().stats;
+    stats.i2cTransactions++;
+    stats.i2cBytes += bytes;
+
+    // 9 clocks per byte (8 data + ACK) plus start/stop overhead
+    hostsim::idleUs((bytes * 9 + 2) * hostsim::US_PER_S / frequency, false);
+}
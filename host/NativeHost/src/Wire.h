@@ -0,0 +1,28 @@
+#ifndef NATIVE_HOST_WIRE_H
+#define NATIVE_HOST_WIRE_H
+
+#include "Arduino.h"
+
+/**
+ * I2C bus stand-in. Devices on the bus are modelled by their driver
+ * stand-ins, which call transfer() to account the bus time of each
+ * transaction at the configured clock.
+ */
+class TwoWire
+{
+private:
+    uint32_t frequency = 100000;
+
+public:
+    bool begin(int sda = -1, int scl = -1, uint32_t freq = 0);
+    bool end();
+    bool setClock(uint32_t freq);
+    uint32_t getClock();
+
+    // Host only: time a transaction of the given number of bytes (address byte included)
+    void transfer(size_t bytes);
+};
+
+extern TwoWire Wire;
+
+#endif
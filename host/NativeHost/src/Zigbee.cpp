@@ -0,0 +1,234 @@
+#include "Zigbee.h"
+
+ZigbeeCore Zigbee;
+
+// Stack start-up before steering/rejoin begins, and the airtime of one report
+static const uint32_t STACK_START_MS = 250;
+static const uint32_t REPORT_AIRTIME_MS = 8;
+
+bool ZigbeeEP::transmit(const char *what)
+{
+    if (!Zigbee.connected())
+        return false;
+
+    hostsim::world().stats.zigbeeReports++;
+    hostsim::advanceMs(REPORT_AIRTIME_MS);
+    return true;
+}
+
+bool ZigbeeEP::setManufacturerAndModel(const char *name, const char *model)
+{
+    return true;
+}
+
+bool ZigbeeEP::setPowerSource(zb_power_source_t powerSource, uint8_t percentage)
+{
+    batteryPercentage = percentage;
+    return true;
+}
+
+bool ZigbeeEP::setBatteryPercentage(uint8_t percentage)
+{
+    batteryPercentage = percentage;
+    return true;
+}
+
+bool ZigbeeEP::reportBatteryPercentage()
+{
+    hostsim::World &w = hostsim::world();
+    w.zigbee.lastBattery = batteryPercentage;
+    w.stats.batteryErrorPct += fabs(batteryPercentage - hostsim::stateOfChargePercent());
+    w.stats.batteryReports++;
+    return transmit("battery");
+}
+
+bool ZigbeeCarbonDioxideSensor::setCarbonDioxide(float carbonDioxide)
+{
+    this->carbonDioxide = carbonDioxide;
+    return true;
+}
+
+bool ZigbeeCarbonDioxideSensor::setMinMaxValue(float min, float max)
+{
+    return true;
+}
+
+bool ZigbeeCarbonDioxideSensor::setTolerance(float tolerance)
+{
+    return true;
+}
+
+bool ZigbeeCarbonDioxideSensor::setReporting(uint16_t minInterval, uint16_t maxInterval, uint16_t delta)
+{
+    return true;
+}
+
+bool ZigbeeCarbonDioxideSensor::report()
+{
+    hostsim::ZigbeeNetwork &z = hostsim::world().zigbee;
+    if (z.lastCO2Us != 0 && z.lastCO2Session != z.startedAtUs)
+    {
+        z.prevCO2 = z.lastCO2;
+        z.prevCO2Us = z.lastCO2Us;
+    }
+    z.lastCO2 = static_cast<uint16_t>(carbonDioxide);
+    z.lastCO2Us = hostsim::nowUs();
+    z.lastCO2Session = z.startedAtUs;
+    return transmit("carbon dioxide");
+}
+
+bool ZigbeeTempSensor::setTemperature(float value)
+{
+    temperature = value;
+    return true;
+}
+
+bool ZigbeeTempSensor::setMinMaxValue(float min, float max)
+{
+    return true;
+}
+
+bool ZigbeeTempSensor::setTolerance(float tolerance)
+{
+    return true;
+}
+
+bool ZigbeeTempSensor::setReporting(uint16_t minInterval, uint16_t maxInterval, float delta)
+{
+    return true;
+}
+
+bool ZigbeeTempSensor::reportTemperature()
+{
+    hostsim::world().zigbee.lastTemperature = temperature;
+    return transmit("temperature");
+}
+
+void ZigbeeTempSensor::addHumiditySensor(float min, float max, float tolerance)
+{
+    humiditySensor = true;
+}
+
+bool ZigbeeTempSensor::setHumidity(float value)
+{
+    humidity = value;
+    return true;
+}
+
+bool ZigbeeTempSensor::setHumidityReporting(uint16_t minInterval, uint16_t maxInterval, float delta)
+{
+    return humiditySensor;
+}
+
+bool ZigbeeTempSensor::reportHumidity()
+{
+    if (!humiditySensor)
+        return false;
+
+    hostsim::world().zigbee.lastHumidity = humidity;
+    return transmit("humidity");
+}
+
+bool ZigbeeTempSensor::report()
+{
+    bool ok = reportTemperature();
+    if (humiditySensor)
+        ok = reportHumidity() && ok;
+    return ok;
+}
+
+bool ZigbeeAnalog::addAnalogInput()
+{
+    hasAnalogInput = true;
+    return true;
+}
+
+bool ZigbeeAnalog::setAnalogInput(float analog)
+{
+    analogInput = analog;
+    return hasAnalogInput;
+}
+
+bool ZigbeeAnalog::reportAnalogInput()
+{
+    if (!hasAnalogInput)
+        return false;
+
+    hostsim::World &w = hostsim::world();
+    w.zigbee.lastAnalogInput = analogInput;
+    w.stats.analogReports++;
+    return transmit("analog input");
+}
+
+bool ZigbeeCore::begin(esp_zb_cfg_t *roleConfig, bool eraseNvs)
+{
+    hostsim::World &w = hostsim::world();
+    if (eraseNvs)
+        w.zigbee.commissioned = false;
+
+    w.stats.radioSessions++;
+    hostsim::setLoad(hostsim::Load::RADIO, hostsim::RADIO_ACTIVE_MA);
+    w.zigbee.started = true;
+    w.zigbee.startedAtUs = w.nowUs;
+
+    w.zigbee.channel = 0;
+
+    uint32_t coordinatorMask = 1UL << w.config.channel;
+    if ((primaryChannelMask & coordinatorMask) == 0)
+    {
+        w.zigbee.connectAtUs = UINT64_MAX;
+    }
+    else
+    {
+        uint32_t latencyMs = w.config.joinMs;
+        if (w.zigbee.commissioned)
+            latencyMs = primaryChannelMask == coordinatorMask ? w.config.fastRejoinMs : w.config.rejoinMs;
+        w.zigbee.connectAtUs = w.nowUs + latencyMs * hostsim::US_PER_MS;
+    }
+
+    hostsim::cpuBoundUs(STACK_START_MS * hostsim::US_PER_MS);
+
+    // A stack that does not come up; only a deadline or the watchdog gets the firmware out
+    const hostsim::Config &c = w.config;
+    while (w.nowUs >= c.radioHangStartUs && w.nowUs < c.radioHangEndUs)
+        hostsim::cpuBoundUs(STACK_START_MS * hostsim::US_PER_MS);
+    return true;
+}
+
+void ZigbeeCore::setPrimaryChannelMask(uint32_t mask)
+{
+    primaryChannelMask = mask;
+}
+
+bool ZigbeeCore::addEndpoint(ZigbeeEP *ep)
+{
+    return true;
+}
+
+bool ZigbeeCore::started()
+{
+    return hostsim::world().zigbee.started;
+}
+
+bool ZigbeeCore::connected()
+{
+    hostsim::World &w = hostsim::world();
+    if (!w.zigbee.started || !hostsim::coordinatorReachable() || w.nowUs < w.zigbee.connectAtUs)
+        return false;
+
+    w.zigbee.commissioned = true;
+    w.zigbee.channel = w.config.channel;
+    return true;
+}
+
+void ZigbeeCore::factoryReset(bool autoRestart)
+{
+    hostsim::world().zigbee.commissioned = false;
+    if (autoRestart)
+        hostsim::restart("Zigbee factory reset");
+}
+
+uint8_t esp_zb_get_current_channel(void)
+{
+    return hostsim::world().zigbee.channel;
+}
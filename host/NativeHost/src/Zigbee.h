@@ -0,0 +1,151 @@
+#ifndef NATIVE_HOST_ZIGBEE_H
+#define NATIVE_HOST_ZIGBEE_H
+
+#include "Arduino.h"
+
+/**
+ * Stand-in for the arduino-esp32 Zigbee library. The stack is modelled as a
+ * radio that draws current from begin() until the next boot and reaches the
+ * coordinator after a join (first boot) or rejoin (commissioned) latency.
+ * A commissioned device limited to the coordinator's channel skips the
+ * channel scan and rejoins within the fast rejoin latency; a channel mask
+ * without the coordinator's channel never connects.
+ */
+
+#define ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK 0x07FFF800U
+
+typedef struct
+{
+    uint8_t ed_timeout;
+    uint32_t keep_alive;
+} esp_zb_zed_cfg_t;
+
+typedef struct
+{
+    uint8_t max_children;
+} esp_zb_zczr_cfg_t;
+
+typedef struct
+{
+    uint8_t esp_zb_role;
+    bool install_code_policy;
+    union
+    {
+        esp_zb_zczr_cfg_t zczr_cfg;
+        esp_zb_zed_cfg_t zed_cfg;
+    } nwk_cfg;
+} esp_zb_cfg_t;
+
+#define ESP_ZB_DEVICE_TYPE_ED 0x02
+#define ESP_ZB_ED_AGING_TIMEOUT_64MIN 6
+
+#define ZIGBEE_DEFAULT_ED_CONFIG()                                \
+    {                                                             \
+        .esp_zb_role = ESP_ZB_DEVICE_TYPE_ED,                     \
+        .install_code_policy = false,                             \
+        .nwk_cfg = {                                              \
+            .zed_cfg = {                                          \
+                .ed_timeout = ESP_ZB_ED_AGING_TIMEOUT_64MIN,      \
+                .keep_alive = 3000,                               \
+            },                                                    \
+        },                                                        \
+    }
+
+typedef enum
+{
+    ZB_POWER_SOURCE_UNKNOWN = 0x00,
+    ZB_POWER_SOURCE_MAINS = 0x01,
+    ZB_POWER_SOURCE_BATTERY = 0x03,
+} zb_power_source_t;
+
+class ZigbeeEP
+{
+protected:
+    uint8_t endpoint;
+    uint8_t batteryPercentage = 0xff;
+
+    bool transmit(const char *what);
+
+public:
+    ZigbeeEP(uint8_t endpoint) : endpoint(endpoint) {}
+    virtual ~ZigbeeEP() {}
+
+    uint8_t getEndpoint() { return endpoint; }
+    bool setManufacturerAndModel(const char *name, const char *model);
+    bool setPowerSource(zb_power_source_t powerSource, uint8_t percentage = 0xff);
+    bool setBatteryPercentage(uint8_t percentage);
+    bool reportBatteryPercentage();
+};
+
+class ZigbeeCarbonDioxideSensor : public ZigbeeEP
+{
+private:
+    float carbonDioxide = 0.0f;
+
+public:
+    ZigbeeCarbonDioxideSensor(uint8_t endpoint) : ZigbeeEP(endpoint) {}
+
+    bool setCarbonDioxide(float carbonDioxide);
+    bool setMinMaxValue(float min, float max);
+    bool setTolerance(float tolerance);
+    bool setReporting(uint16_t minInterval, uint16_t maxInterval, uint16_t delta);
+    bool report();
+};
+
+class ZigbeeTempSensor : public ZigbeeEP
+{
+private:
+    float temperature = 0.0f;
+    float humidity = 0.0f;
+    bool humiditySensor = false;
+
+public:
+    ZigbeeTempSensor(uint8_t endpoint) : ZigbeeEP(endpoint) {}
+
+    bool setTemperature(float value);
+    bool setMinMaxValue(float min, float max);
+    bool setTolerance(float tolerance);
+    bool setReporting(uint16_t minInterval, uint16_t maxInterval, float delta);
+    bool reportTemperature();
+
+    void addHumiditySensor(float min, float max, float tolerance);
+    bool setHumidity(float value);
+    bool setHumidityReporting(uint16_t minInterval, uint16_t maxInterval, float delta);
+    bool reportHumidity();
+
+    bool report();
+};
+
+class ZigbeeAnalog : public ZigbeeEP
+{
+private:
+    float analogInput = 0.0f;
+    bool hasAnalogInput = false;
+
+public:
+    ZigbeeAnalog(uint8_t endpoint) : ZigbeeEP(endpoint) {}
+
+    bool addAnalogInput();
+    bool setAnalogInput(float analog);
+    bool reportAnalogInput();
+};
+
+class ZigbeeCore
+{
+private:
+    uint32_t primaryChannelMask = ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK;
+
+public:
+    bool begin(esp_zb_cfg_t *roleConfig, bool eraseNvs = false);
+    void setPrimaryChannelMask(uint32_t mask);
+    bool addEndpoint(ZigbeeEP *ep);
+    bool started();
+    bool connected();
+    void factoryReset(bool autoRestart = true);
+};
+
+extern ZigbeeCore Zigbee;
+
+uint8_t esp_zb_get_current_channel(void);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef NATIVE_HOST_DRIVER_RTC_IO_H
+#define NATIVE_HOST_DRIVER_RTC_IO_H
+
+#include "esp_sleep.h"
+
+#endif
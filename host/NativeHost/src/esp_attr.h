@@ -0,0 +1,9 @@
+#ifndef NATIVE_HOST_ESP_ATTR_H
+#define NATIVE_HOST_ESP_ATTR_H
+
+// RTC slow memory is emulated by a dedicated section that the host runner
+// carries over from one simulated boot to the next.
+#define RTC_DATA_ATTR __attribute__((section("rtc_data"), used))
+#define IRAM_ATTR
+
+#endif
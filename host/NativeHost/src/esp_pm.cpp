@@ -0,0 +1,66 @@
+#include "esp_pm.h"
+#include "HostSim.h"
+
+struct esp_pm_lock
+{
+    bool used;
+    uint32_t count;
+};
+
+// Per boot, like the locks of a real boot
+static const size_t MAX_LOCKS = 4;
+static esp_pm_lock locks[MAX_LOCKS];
+
+esp_err_t esp_pm_configure(const void *config)
+{
+    const esp_pm_config_t *pm = static_cast<const esp_pm_config_t *>(config);
+    hostsim::World &w = hostsim::world();
+    if (pm->min_freq_mhz <= 0 || pm->max_freq_mhz < pm->min_freq_mhz || pm->max_freq_mhz > 160)
+        return ESP_FAIL;
+    if (pm->light_sleep_enable && w.config.noTickless)
+        return ESP_ERR_NOT_SUPPORTED;
+
+    w.cpuMaxMhz = static_cast<uint16_t>(pm->max_freq_mhz);
+    w.cpuMinMhz = static_cast<uint16_t>(pm->min_freq_mhz);
+    w.pmLightSleep = pm->light_sleep_enable;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char *name, esp_pm_lock_handle_t *out_handle)
+{
+    for (size_t i = 0; i < MAX_LOCKS; i++)
+    {
+        if (!locks[i].used)
+        {
+            locks[i] = {true, 0};
+            *out_handle = &locks[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_FAIL;
+}
+
+// Every lock type keeps the chip out of automatic light sleep; only that is modelled
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle)
+{
+    handle->count++;
+    hostsim::world().pmLocks++;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle)
+{
+    if (handle->count == 0)
+        return ESP_FAIL;
+    handle->count--;
+    hostsim::world().pmLocks--;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_delete(esp_pm_lock_handle_t handle)
+{
+    if (handle->count != 0)
+        return ESP_FAIL;
+    handle->used = false;
+    return ESP_OK;
+}
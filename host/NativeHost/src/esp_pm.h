@@ -0,0 +1,34 @@
+#ifndef NATIVE_HOST_ESP_PM_H
+#define NATIVE_HOST_ESP_PM_H
+
+#include <stdint.h>
+#include "esp_sleep.h"
+
+#define ESP_ERR_NOT_SUPPORTED 0x106
+
+typedef struct
+{
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_t;
+
+typedef enum
+{
+    ESP_PM_CPU_FREQ_MAX,
+    ESP_PM_APB_FREQ_MAX,
+    ESP_PM_NO_LIGHT_SLEEP,
+} esp_pm_lock_type_t;
+
+typedef struct esp_pm_lock *esp_pm_lock_handle_t;
+
+// Busy time runs at max_freq_mhz, idle time (delay(), I2C waits) at min_freq_mhz or in
+// automatic light sleep while no lock is held. Automatic light sleep is refused like a
+// build without tickless idle when the host runs with --no-tickless.
+esp_err_t esp_pm_configure(const void *config);
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char *name, esp_pm_lock_handle_t *out_handle);
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle);
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle);
+esp_err_t esp_pm_lock_delete(esp_pm_lock_handle_t handle);
+
+#endif
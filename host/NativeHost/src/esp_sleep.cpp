@@ -0,0 +1,84 @@
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+#include "rtc.h"
+#include "HostSim.h"
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us)
+{
+    hostsim::World &w = hostsim::world();
+    w.timerArmed = true;
+    w.timerUs = time_in_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_ext1_wakeup_io(uint64_t io_mask, esp_sleep_ext1_wakeup_mode_t level_mode)
+{
+    hostsim::world().ext1Mask |= io_mask;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_gpio_wakeup(void)
+{
+    hostsim::world().gpioWakeArmed = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_enable(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (intr_type != GPIO_INTR_LOW_LEVEL && intr_type != GPIO_INTR_HIGH_LEVEL)
+        return ESP_FAIL;
+    hostsim::world().gpioWakeLevel = intr_type == GPIO_INTR_HIGH_LEVEL ? 1 : 0;
+    return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_disable(gpio_num_t gpio_num)
+{
+    hostsim::world().gpioWakeLevel = -1;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_disable_wakeup_source(esp_sleep_source_t source)
+{
+    hostsim::World &w = hostsim::world();
+    switch (source)
+    {
+    case ESP_SLEEP_WAKEUP_ALL:
+        w.timerArmed = false;
+        w.ext1Mask = 0;
+        w.gpioWakeArmed = false;
+        break;
+    case ESP_SLEEP_WAKEUP_TIMER:
+        w.timerArmed = false;
+        break;
+    case ESP_SLEEP_WAKEUP_EXT1:
+        w.ext1Mask = 0;
+        break;
+    case ESP_SLEEP_WAKEUP_GPIO:
+        w.gpioWakeArmed = false;
+        break;
+    default:
+        break;
+    }
+    return ESP_OK;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void)
+{
+    return static_cast<esp_sleep_wakeup_cause_t>(hostsim::world().wakeCause);
+}
+
+void esp_deep_sleep_start(void)
+{
+    hostsim::deepSleep();
+}
+
+esp_err_t esp_light_sleep_start(void)
+{
+    hostsim::lightSleep();
+    return ESP_OK;
+}
+
+uint64_t esp_rtc_get_time_us(void)
+{
+    return hostsim::nowUs();
+}
@@ -0,0 +1,89 @@
+#include "esp_timer.h"
+#include "HostSim.h"
+
+struct esp_timer
+{
+    bool used;
+    bool armed;
+    uint64_t dueUs; // uptime
+    esp_timer_cb_t callback;
+    void *arg;
+};
+
+// Per boot, like the timers of a real boot
+static const size_t MAX_TIMERS = 4;
+static esp_timer timers[MAX_TIMERS];
+static bool dispatching = false;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    for (size_t i = 0; i < MAX_TIMERS; i++)
+    {
+        if (!timers[i].used)
+        {
+            timers[i] = {true, false, 0, create_args->callback, create_args->arg};
+            *out_handle = &timers[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (timer->armed)
+        return ESP_FAIL;
+    timer->armed = true;
+    timer->dueUs = hostsim::uptimeUs() + timeout_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer->armed)
+        return ESP_FAIL;
+    timer->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    timer->used = false;
+    timer->armed = false;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return static_cast<int64_t>(hostsim::uptimeUs());
+}
+
+namespace hostsim
+{
+    void runDueTimers()
+    {
+        if (dispatching || world().lightSleeping)
+            return;
+
+        dispatching = true;
+        for (size_t i = 0; i < MAX_TIMERS; i++)
+        {
+            esp_timer &timer = timers[i];
+            if (timer.armed && uptimeUs() >= timer.dueUs)
+            {
+                timer.armed = false;
+                timer.callback(timer.arg);
+            }
+        }
+        dispatching = false;
+    }
+
+    uint64_t nextTimerDueUs()
+    {
+        uint64_t dueUs = UINT64_MAX;
+        for (size_t i = 0; i < MAX_TIMERS; i++)
+            if (timers[i].armed && timers[i].dueUs < dueUs)
+                dueUs = timers[i].dueUs;
+        return dueUs;
+    }
+}
@@ -0,0 +1,8 @@
+#ifndef NATIVE_HOST_RTC_H
+#define NATIVE_HOST_RTC_H
+
+#include <stdint.h>
+
+uint64_t esp_rtc_get_time_us(void);
+
+#endif
@@ -0,0 +1,57 @@
+#include "BatteryEstimator.h"
+#include "Trace.h"
+#include <algorithm>
+
+static_assert(BatteryEstimator::curveIsMonotonic(), "discharge curve must rise in voltage and charge");
+static_assert(BatteryEstimator::percentForMilliVolts(3820) == 50.0f, "discharge curve lookup");
+static_assert(BatteryEstimator::percentForMilliVolts(3845) == 55.0f, "discharge curve interpolation");
+static_assert(BatteryEstimator::percentForMilliVolts(4300) == 100.0f, "discharge curve is clamped");
+
+// Time over which the voltage fully overrides the charge counter. The curve is flat in the middle,
+// so a single reading is only trusted a little while the counter drifts slowly.
+#define VOLTAGE_CORRECTION_SECONDS (2 * 24 * 3600.0f)
+
+struct ChargeCounter
+{
+    bool valid;
+    float percent;
+    float chargeMah;  // modelled charge since power-on at the last update
+    uint64_t timeUs;
+};
+
+RTC_DATA_ATTR static ChargeCounter counter = {};
+
+BatteryEstimator::BatteryEstimator(float capacityMah, float internalResistanceOhm)
+    : capacityMah(capacityMah), internalResistanceOhm(internalResistanceOhm)
+{
+}
+
+float BatteryEstimator::update(float voltage, float loadMa, float chargeMah, uint64_t timeMicros)
+{
+    float openCircuitMilliVolts = voltage * 1000.0f + loadMa * internalResistanceOhm;
+    float curvePercent = percentForMilliVolts(openCircuitMilliVolts);
+
+    if (!counter.valid || timeMicros < counter.timeUs || chargeMah < counter.chargeMah)
+    {
+        counter.percent = curvePercent;
+    }
+    else
+    {
+        float counted = counter.percent - (chargeMah - counter.chargeMah) * 100.0f / capacityMah;
+        float weight = std::min((timeMicros - counter.timeUs) / 1e6f / VOLTAGE_CORRECTION_SECONDS, 1.0f);
+        counter.percent = std::clamp(counted + (curvePercent - counted) * weight, 0.0f, 100.0f);
+    }
+
+    counter.valid = true;
+    counter.chargeMah = chargeMah;
+    counter.timeUs = timeMicros;
+
+    trace(TraceEvent::BATTERY, traceMilli(voltage), traceCenti(loadMa));
+    trace(TraceEvent::BATTERY_ESTIMATE, traceCenti(curvePercent), traceCenti(counter.percent));
+    return counter.percent;
+}
+
+float BatteryEstimator::stateOfChargePercent() const
+{
+    return counter.percent;
+}
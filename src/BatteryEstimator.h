@@ -0,0 +1,69 @@
+#ifndef BATTERY_ESTIMATOR_H
+#define BATTERY_ESTIMATOR_H
+
+#include "Arduino.h"
+
+struct DischargePoint
+{
+    uint16_t milliVolts; // open-circuit cell voltage
+    uint8_t percent;
+};
+
+// Open-circuit voltage of a Li-ion cell against state of charge, from empty to full
+static constexpr DischargePoint DISCHARGE_CURVE[] = {
+    {3000, 0}, {3450, 5}, {3680, 10}, {3740, 20}, {3770, 30}, {3790, 40}, {3820, 50},
+    {3870, 60}, {3920, 70}, {3980, 80}, {4060, 90}, {4200, 100},
+};
+static constexpr size_t DISCHARGE_CURVE_POINTS = sizeof(DISCHARGE_CURVE) / sizeof(DISCHARGE_CURVE[0]);
+
+/**
+ * @brief Battery state of charge from a charge counter, corrected by the cell voltage.
+ *
+ * Between readings the charge the EnergyMonitor modelled since the last one
+ * is counted off the capacity. Each reading pulls the count towards the
+ * state of charge on the discharge curve, in proportion to the time since
+ * the previous reading. The reading is first corrected for the drop over the
+ * cell's internal resistance at the present load. The counter starts from the
+ * curve at power-on and is kept in RTC memory.
+ */
+class BatteryEstimator
+{
+private:
+    float capacityMah;
+    float internalResistanceOhm;
+
+public:
+    BatteryEstimator(float capacityMah, float internalResistanceOhm);
+
+    /**
+     * @param voltage cell voltage under load.
+     * @param loadMa current drawn while the voltage was sampled.
+     * @param chargeMah modelled charge used since power-on.
+     * @param timeMicros RTC time.
+     * @return state of charge in percent.
+     */
+    float update(float voltage, float loadMa, float chargeMah, uint64_t timeMicros);
+
+    float stateOfChargePercent() const;
+
+    static constexpr float percentForMilliVolts(float milliVolts, size_t i = 1)
+    {
+        return milliVolts <= DISCHARGE_CURVE[0].milliVolts ? 0.0f
+               : i >= DISCHARGE_CURVE_POINTS              ? 100.0f
+               : milliVolts > DISCHARGE_CURVE[i].milliVolts
+                   ? percentForMilliVolts(milliVolts, i + 1)
+                   : DISCHARGE_CURVE[i - 1].percent +
+                         (DISCHARGE_CURVE[i].percent - DISCHARGE_CURVE[i - 1].percent) *
+                             (milliVolts - DISCHARGE_CURVE[i - 1].milliVolts) /
+                             static_cast<float>(DISCHARGE_CURVE[i].milliVolts - DISCHARGE_CURVE[i - 1].milliVolts);
+    }
+
+    static constexpr bool curveIsMonotonic(size_t i = 1)
+    {
+        return i >= DISCHARGE_CURVE_POINTS ||
+               (DISCHARGE_CURVE[i].milliVolts > DISCHARGE_CURVE[i - 1].milliVolts &&
+                DISCHARGE_CURVE[i].percent > DISCHARGE_CURVE[i - 1].percent && curveIsMonotonic(i + 1));
+    }
+};
+
+#endif
@@ -0,0 +1,39 @@
+#include "BatterySampler.h"
+#include "Trace.h"
+#include "rtc.h"
+
+struct BatteryReading
+{
+    bool valid;
+    uint16_t milliVolts;
+    uint64_t sampledAtUs;
+};
+
+RTC_DATA_ATTR static BatteryReading reading = {};
+
+BatterySampler::BatterySampler(uint8_t pin, uint32_t maxAgeSeconds) : pin(pin), maxAgeSeconds(maxAgeSeconds)
+{
+}
+
+uint32_t BatterySampler::readMilliVolts(bool fresh)
+{
+    uint64_t now = esp_rtc_get_time_us();
+    if (!fresh && reading.valid && now - reading.sampledAtUs < maxAgeSeconds * 1000000ULL)
+    {
+        trace(TraceEvent::BATTERY_REUSED, static_cast<int32_t>((now - reading.sampledAtUs) / 1000000ULL),
+              reading.milliVolts);
+        return reading.milliVolts;
+    }
+
+    pinMode(pin, INPUT);
+    uint16_t samples[BATTERY_SAMPLE_COUNT];
+    for (size_t i = 0; i < BATTERY_SAMPLE_COUNT; i++)
+    {
+        samples[i] = static_cast<uint16_t>(analogReadMilliVolts(pin));
+    }
+
+    reading.milliVolts = median(samples, BATTERY_SAMPLE_COUNT);
+    reading.sampledAtUs = now;
+    reading.valid = true;
+    return reading.milliVolts;
+}
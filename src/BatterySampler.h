@@ -0,0 +1,45 @@
+#ifndef BATTERY_SAMPLER_H
+#define BATTERY_SAMPLER_H
+
+#include "Arduino.h"
+#include <algorithm>
+
+#ifndef BATTERY_SAMPLE_COUNT
+#define BATTERY_SAMPLE_COUNT 31 // Odd, so the median is a single sample
+#endif
+
+/**
+ * @brief Median of a burst of ADC readings on the battery divider, without heap use.
+ *
+ * The burst is collected in a fixed buffer on the stack and the median found
+ * by selection instead of a full sort. The last result and its time are kept
+ * in RTC memory, so a reading younger than maxAgeSeconds is reused instead of
+ * sampling again.
+ */
+class BatterySampler
+{
+private:
+    uint8_t pin;
+    uint32_t maxAgeSeconds;
+
+public:
+    BatterySampler(uint8_t pin, uint32_t maxAgeSeconds);
+
+    /**
+     * @param fresh sample even if the last reading is recent enough.
+     * @return median ADC pin voltage in mV.
+     */
+    uint32_t readMilliVolts(bool fresh = false);
+
+    /**
+     * @brief Median of count samples, reordering them. count must be odd and non-zero.
+     */
+    static uint16_t median(uint16_t *samples, size_t count)
+    {
+        uint16_t *middle = samples + count / 2;
+        std::nth_element(samples, middle, samples + count);
+        return *middle;
+    }
+};
+
+#endif
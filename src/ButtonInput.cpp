@@ -0,0 +1,135 @@
+#include "ButtonInput.h"
+#include <algorithm>
+
+ButtonInput::ButtonInput(PowerManager &powerManager, uint8_t pin, uint32_t longPressMs, uint32_t debounceMs)
+    : powerManager(powerManager), pin(pin), longPressMs(longPressMs), debounceMs(debounceMs)
+{
+}
+
+void ButtonInput::begin()
+{
+    pinMode(pin, INPUT);
+    awaitingRelease = true;
+    queueHead = 0;
+    queueCount = 0;
+}
+
+void ButtonInput::setLightSleep(bool enabled)
+{
+    lightSleep = enabled;
+}
+
+// Sleeps until the pin settles at level and stamps edgeMs with the edge. A level that does not
+// last the debounce time is a bounce and waited out. Returns false after timeoutMs, 0 for never.
+bool ButtonInput::waitForLevel(uint8_t level, uint32_t timeoutMs)
+{
+    uint32_t start = millis();
+    while (true)
+    {
+        uint32_t elapsed = millis() - start;
+        if (timeoutMs > 0 && elapsed >= timeoutMs)
+            return false;
+        uint32_t remaining = timeoutMs > 0 ? timeoutMs - elapsed : 0;
+
+        if (lightSleep)
+        {
+            if (!powerManager.lightSleepUntilPin(pin, level, remaining))
+                continue;
+        }
+        else if (digitalRead(pin) != level)
+        {
+            delay(remaining > 0 ? std::min(debounceMs, remaining) : debounceMs);
+            continue;
+        }
+
+        edgeMs = millis();
+        if (lightSleep)
+            powerManager.lightSleepMs(debounceMs);
+        else
+            delay(debounceMs);
+
+        if (digitalRead(pin) == level)
+            return true;
+    }
+}
+
+void ButtonInput::run(uint32_t timeoutMs, bool untilEvent)
+{
+    uint32_t start = millis();
+    while (true)
+    {
+        uint32_t elapsed = millis() - start;
+        if (timeoutMs > 0 && elapsed >= timeoutMs)
+            return;
+        uint32_t remaining = timeoutMs > 0 ? timeoutMs - elapsed : 0;
+
+        if (awaitingRelease)
+        {
+            if (!waitForLevel(LOW, remaining))
+                return;
+            awaitingRelease = false;
+        }
+
+        if (!waitForLevel(HIGH, remaining))
+            return;
+
+        // Once pressed, the press is classified whatever the timeout
+        uint32_t pressedMs = edgeMs;
+        uint32_t heldMs = millis() - pressedMs;
+        if (heldMs < longPressMs && waitForLevel(LOW, longPressMs - heldMs))
+        {
+            push(ButtonEventType::SHORT_PRESS, pressedMs, edgeMs - pressedMs);
+        }
+        else
+        {
+            push(ButtonEventType::LONG_PRESS, pressedMs, millis() - pressedMs);
+            awaitingRelease = true;
+        }
+
+        if (untilEvent)
+            return;
+    }
+}
+
+void ButtonInput::push(ButtonEventType type, uint32_t pressedMs, uint32_t heldMs)
+{
+    if (queueCount == BUTTON_EVENT_QUEUE_SIZE)
+    {
+        log_w("Button queue full, dropping the oldest press");
+        queueHead = (queueHead + 1) % BUTTON_EVENT_QUEUE_SIZE;
+        queueCount--;
+    }
+
+    queue[(queueHead + queueCount) % BUTTON_EVENT_QUEUE_SIZE] = {type, pressedMs, heldMs};
+    queueCount++;
+    log_d("%s press at %lu ms, held %lu ms", type == ButtonEventType::LONG_PRESS ? "Long" : "Short",
+          static_cast<unsigned long>(pressedMs), static_cast<unsigned long>(heldMs));
+}
+
+bool ButtonInput::waitForEvent(ButtonEvent &event, uint32_t timeoutMs)
+{
+    if (queueCount == 0)
+        run(timeoutMs, true);
+    if (queueCount == 0)
+        return false;
+
+    event = queue[queueHead];
+    queueHead = (queueHead + 1) % BUTTON_EVENT_QUEUE_SIZE;
+    queueCount--;
+    return true;
+}
+
+void ButtonInput::idle(uint32_t ms)
+{
+    if (ms > 0)
+        run(ms, false);
+}
+
+bool ButtonInput::waitForRelease(uint32_t timeoutMs)
+{
+    if (!waitForLevel(LOW, timeoutMs))
+        return false;
+
+    awaitingRelease = false;
+    return true;
+}
@@ -0,0 +1,95 @@
+#ifndef BUTTON_INPUT_H
+#define BUTTON_INPUT_H
+
+#include "Arduino.h"
+#include "PowerManager.h"
+
+#ifndef BUTTON_DEBOUNCE_MS
+#define BUTTON_DEBOUNCE_MS 30
+#endif
+
+#define BUTTON_EVENT_QUEUE_SIZE 4
+
+enum class ButtonEventType : uint8_t
+{
+    SHORT_PRESS, // Released before the long press time
+    LONG_PRESS   // Held for the long press time, delivered while still held
+};
+
+struct ButtonEvent
+{
+    ButtonEventType type;
+    uint32_t pressedMs; // millis() at the press edge
+    uint32_t heldMs;
+};
+
+/**
+ * @brief Short and long presses of an active-high button, without busy waiting.
+ *
+ * Waits in light sleep with a GPIO level wakeup on the button pin, so the CPU
+ * only runs when the button changes. The wakeup timestamps the edge, which
+ * counts once the level is still there after the debounce time. A long press
+ * is delivered as soon as the long press time has passed and its release is
+ * ignored. Presses go through a small queue, so the ones made while the menu
+ * holds a message with idle() are not lost.
+ */
+class ButtonInput
+{
+private:
+    PowerManager &powerManager;
+    uint8_t pin;
+    uint32_t longPressMs;
+    uint32_t debounceMs;
+    bool lightSleep = true;
+    bool awaitingRelease = true;
+    uint32_t edgeMs = 0;
+    ButtonEvent queue[BUTTON_EVENT_QUEUE_SIZE];
+    uint8_t queueHead = 0;
+    uint8_t queueCount = 0;
+
+    bool waitForLevel(uint8_t level, uint32_t timeoutMs);
+    void run(uint32_t timeoutMs, bool untilEvent);
+    void push(ButtonEventType type, uint32_t pressedMs, uint32_t heldMs);
+
+public:
+    ButtonInput(PowerManager &powerManager, uint8_t pin, uint32_t longPressMs,
+                uint32_t debounceMs = BUTTON_DEBOUNCE_MS);
+
+    /**
+     * @brief Configure the pin and clear the queue.
+     *
+     * A press in progress, such as the one that woke the device, is ignored
+     * until the button is released.
+     */
+    void begin();
+
+    /**
+     * @brief Take the next press from the queue, waiting for one if it is empty.
+     *
+     * @param timeoutMs give up when no press starts within this time, 0 to wait forever.
+     * @return false on timeout.
+     */
+    bool waitForEvent(ButtonEvent &event, uint32_t timeoutMs);
+
+    /**
+     * @brief Sleep for a while, queueing the presses made meanwhile.
+     *
+     * A press still held at the end is classified first, so this can take up
+     * to the long press time longer.
+     */
+    void idle(uint32_t ms);
+
+    /**
+     * @brief Wait until the button is released, e.g. before a deep sleep that wakes on a press.
+     *
+     * @return false if it is still held after timeoutMs.
+     */
+    bool waitForRelease(uint32_t timeoutMs);
+
+    /**
+     * @brief Wait in light sleep, or in delay() slices while the radio has to keep running.
+     */
+    void setLightSleep(bool enabled);
+};
+
+#endif
@@ -1,13 +1,83 @@
 #include "CO2Sensor.h"
+#include "Trace.h"
 #include "Arduino.h"
 #include <SensirionI2cScd4x.h>
+#include "rtc.h"
+#include <algorithm>
 
 #define SCD41_I2C_ADDR_62 0x62
 
 char CO2Sensor::errorMessage[64];
 
-CO2Sensor::CO2Sensor(uint32_t samplingIntervalSeconds, float temperatureOffset)
-    : samplingIntervalSeconds(samplingIntervalSeconds), temperatureOffset(temperatureOffset)
+// The SCD41 EEPROM is specified for 2000 write cycles
+#define MIN_PERSIST_INTERVAL_US (7ULL * 24 * 3600 * 1000000)
+
+// 424ppm is the current average CO2 level in the atmosphere according to
+// https://www.co2.earth/daily-co2
+#define ASC_TARGET_PPM 424
+
+RTC_DATA_ATTR static bool CO2SensorPersisted = false;
+RTC_DATA_ATTR static uint64_t CO2SensorPersistedAtUs = 0;
+// Configuration in effect while CO2SensorInitialized is set, and the one in the EEPROM that the sensor
+// reloads on wake_up, once known
+RTC_DATA_ATTR static Scd41Config CO2SensorApplied = {};
+RTC_DATA_ATTR static Scd41Config CO2SensorEeprom = {};
+RTC_DATA_ATTR static bool CO2SensorEepromKnown = false;
+
+// Unknown after power-on: the sensor may still be powered down from before an ESP reset. Interrupted after a
+// wake cycle was cut short: powered all along, but idle or powered down.
+enum class SensorPower : uint8_t
+{
+    UNKNOWN,
+    AWAKE,
+    POWERED_DOWN,
+    INTERRUPTED
+};
+
+struct SensorPowerState
+{
+    SensorPower power;
+    bool discardNext;     // first single shot after wake_up is unreliable
+    float shotsPerSample; // single shots per kept reading, the ASC counts every shot
+};
+
+RTC_DATA_ATTR static SensorPowerState powerState = {};
+
+// A single shot costs about 90 mAs above idle (0.45 mA average at one shot per 5 minutes, 0.15 mA idle),
+// which the 0.15 mA idle current saved in power-down recovers after about 600 s
+#define DEFAULT_POWER_DOWN_MIN_SLEEP_SECONDS 600
+#define SCD41_WAKE_UP_MS 30
+// Number of readings the shots per sample ratio is averaged over
+#define SHOTS_PER_SAMPLE_WINDOW 96.0f
+
+// Single shot completion: datasheet maximum, hard timeout, polling slice and how much earlier
+// each on-time poll tries next time, so the learned latency tracks the sensor from above
+#define SINGLE_SHOT_MAX_MS 5000
+#define SINGLE_SHOT_TIMEOUT_MS 7000
+#define SINGLE_SHOT_POLL_SLICE_MS 20
+#define SINGLE_SHOT_PROBE_STEP_MS 2
+// measure_single_shot_rht_only execution time and its timeout
+#define SINGLE_SHOT_RHT_ONLY_MS 50
+#define SINGLE_SHOT_RHT_ONLY_TIMEOUT_MS 500
+
+struct MeasurementTiming
+{
+    uint16_t latencyMs; // predicted ready time after the start command, 0 until learned
+    uint32_t measurements;
+    uint32_t extraPolls; // polls that found the measurement not ready yet
+    uint32_t timeouts;
+    uint32_t busErrors;
+};
+
+RTC_DATA_ATTR static MeasurementTiming timing = {};
+
+static_assert(CO2Sensor::configurationFingerprint({1, ASC_TARGET_PPM, 44, 156, 0.0f}, 0) !=
+                  CO2Sensor::configurationFingerprint({1, ASC_TARGET_PPM, 44, 156, 0.01f}, 0),
+              "fingerprint must resolve the temperature offset");
+
+CO2Sensor::CO2Sensor(Settings &settings, I2CBus &bus, bool persistConfiguration)
+    : sleep(delay), settings(settings), bus(bus), persistConfiguration(persistConfiguration),
+      powerDownMinSleepSeconds(DEFAULT_POWER_DOWN_MIN_SLEEP_SECONDS)
 {
 }
 
@@ -17,225 +87,454 @@ void CO2Sensor::printError(const char *prefix, int16_t err)
     log_e("%s: %d, %s", prefix, err, errorMessage);
 }
 
-bool CO2Sensor::initialize()
+void CO2Sensor::beginBus()
 {
-    log_i("Configuring I2C for CO2 sensor...");
-    sensor.begin(Wire, SCD41_I2C_ADDR_62);
-    delay(100);
+    if (!busConfigured)
+    {
+        trace(TraceEvent::SCD41_BUS);
+        sensor.begin(Wire, SCD41_I2C_ADDR_62);
+        // Power-up time; after a deep sleep the sensor has been powered all along
+        if (powerState.power == SensorPower::UNKNOWN)
+        {
+            delay(100);
+        }
+        busConfigured = true;
+    }
+}
 
-    if (CO2SensorInitialized)
+bool CO2Sensor::wakeUp()
+{
+    if (powerState.power == SensorPower::AWAKE)
     {
         return true;
     }
 
-    log_i("Checking existing sensor configuration...");
-    if (checkConfiguration())
+    // wake_up (0x36F6) is not acknowledged and harmless when the sensor is already idle. Sent raw like the
+    // single shots, so the CPU sleeps through the wake-up time instead of the driver's delay().
+    uint8_t communication_buffer[2] = {0};
+    SensirionI2CTxFrame txFrame = SensirionI2CTxFrame::createWithUInt16Command(0x36f6, communication_buffer, 2);
+    if (bus.acquire(BusDevice::SCD41))
     {
-        CO2SensorInitialized = true;
-        return CO2SensorInitialized;
+        SensirionI2CCommunication::sendFrame(SCD41_I2C_ADDR_62, txFrame, Wire);
+        bus.release(BusDevice::SCD41);
     }
+    sleep(SCD41_WAKE_UP_MS);
+    if (powerState.power == SensorPower::POWERED_DOWN)
+    {
+        powerState.discardNext = true;
+    }
+    powerState.power = SensorPower::AWAKE;
+    return true;
+}
 
-    log_i("Initializing Sensirion SCD41...");
-
-    int16_t error = NO_ERROR;
+bool CO2Sensor::prepareForSleep(uint64_t sleepSeconds)
+{
+    if (powerState.power == SensorPower::POWERED_DOWN)
+    {
+        return true;
+    }
+    if (powerDownMinSleepSeconds == 0 || sleepSeconds < powerDownMinSleepSeconds)
+    {
+        return false;
+    }
 
-    // 424ppm is the current average CO2 level in the atmosphere according to
-    // https://www.co2.earth/daily-co2
-    error = sensor.setAutomaticSelfCalibrationTarget(424);
+    beginBus();
+    int16_t error = onBus([&] { return sensor.powerDown(); });
     if (error != NO_ERROR)
     {
-        printError("setAutomaticSelfCalibrationTarget", error);
+        printError("powerDown", error);
         return false;
     }
 
-    // The initial period represents the number of readings after powering up the sensor for the very first time to trigger the
-    // first automatic self-calibration. The standard period represents the number of subsequent readings periodically
-    // triggering ASC after completion of the initial period. Sensirion recommends adjusting the number of samples
-    // comprising initial and standard period to 2 and 7 days at the average intended sampling rate, respectively.
+    powerState.power = SensorPower::POWERED_DOWN;
+    // wake_up reloads the settings from EEPROM. When that configuration is known it is the one in effect
+    // afterwards, and setSamplingInterval() decides whether it is still close enough; otherwise it is checked again.
+    if (CO2SensorEepromKnown)
+    {
+        CO2SensorApplied = CO2SensorEeprom;
+    }
+    else
+    {
+        CO2SensorInitialized = false;
+    }
+    trace(TraceEvent::SCD41_POWER_DOWN, static_cast<int32_t>(sleepSeconds));
+    return true;
+}
+
+void CO2Sensor::markInterrupted()
+{
+    // A wake_up may have gone out before the cycle was cut short
+    if (powerState.power == SensorPower::POWERED_DOWN)
+    {
+        powerState.discardNext = true;
+    }
+    powerState.power = SensorPower::INTERRUPTED;
+}
 
-    // The parameter value represents twelve times the number of single shots defining the length of either period.
-    // Furthermore, this parameter must be an integer and a multiple of four.
+void CO2Sensor::setPowerDownMinSleep(uint32_t seconds)
+{
+    powerDownMinSleepSeconds = seconds;
+}
 
-    // Initial period, 2 days at x minute intervals: 2*24 * (60/x) / 12
-    // rounded to nearest multiple of 4
-    uint16_t initialPeriod = static_cast<uint16_t>(round((2 * 24 * (3600 / samplingIntervalSeconds) / 12) / 4) * 4);
-    error = sensor.setAutomaticSelfCalibrationInitialPeriod(initialPeriod);
-    if (error != NO_ERROR)
+bool CO2Sensor::isPoweredDown() const
+{
+    return powerState.power == SensorPower::POWERED_DOWN;
+}
+
+bool CO2Sensor::needsDiscardShot() const
+{
+    return isPoweredDown() || powerState.discardNext;
+}
+
+bool CO2Sensor::initialize()
+{
+    beginBus();
+    wakeUp();
+
+    if (CO2SensorInitialized)
     {
-        printError("setAutomaticSelfCalibrationInitialPeriod", error);
-        return false;
+        return true;
     }
 
-    // Standard period: 7 days at x minute intervals: 7*24 * (60/x) / 12
-    // rounded to nearest multiple of 4
-    uint16_t standardPeriod = static_cast<uint16_t>(round((7 * 24 * (3600 / samplingIntervalSeconds) / 12) / 4) * 4);
-    error = sensor.setAutomaticSelfCalibrationStandardPeriod(standardPeriod);
+    int16_t error = NO_ERROR;
+    uint64_t serialNumber = 0;
+    error = onBus([&] { return sensor.getSerialNumber(serialNumber); });
     if (error != NO_ERROR)
     {
-        printError("setAutomaticSelfCalibrationStandardPeriod", error);
+        printError("getSerialNumber", error);
         return false;
     }
 
-    // Aktiver autokalibrering
-    error = sensor.setAutomaticSelfCalibrationEnabled(true);
-    if (error != NO_ERROR)
+    Scd41Config desired = desiredConfiguration();
+    uint32_t fingerprint = configurationFingerprint(desired, serialNumber);
+    if (fingerprint == settings.getScd41Fingerprint())
     {
-        printError("setAutomaticSelfCalibrationEnabled", error);
-        return false;
+        trace(TraceEvent::SCD41_FINGERPRINT, static_cast<int32_t>(fingerprint));
+        CO2SensorApplied = desired;
+        CO2SensorEeprom = desired;
+        CO2SensorEepromKnown = true;
+        CO2SensorInitialized = true;
+        return true;
     }
 
-    error = sensor.setTemperatureOffset(temperatureOffset);
-    if (error != NO_ERROR)
+    trace(TraceEvent::SCD41_CONFIGURING);
+    uint8_t written = 0;
+    if (!applyConfiguration(desired, written))
     {
-        printError("setTemperatureOffset", error);
         return false;
     }
 
-    log_i("Sensiron SCD41 initialized with ASC.");
+    uint64_t now = esp_rtc_get_time_us();
+    if (persistConfiguration && (!CO2SensorPersisted || now - CO2SensorPersistedAtUs >= MIN_PERSIST_INTERVAL_US))
+    {
+        error = onBus([&] { return sensor.persistSettings(); });
+        if (error != NO_ERROR)
+        {
+            printError("persistSettings", error);
+            return false;
+        }
+        CO2SensorPersisted = true;
+        CO2SensorPersistedAtUs = now;
+        settings.setScd41Fingerprint(fingerprint);
+        CO2SensorEeprom = desired;
+        CO2SensorEepromKnown = true;
+        log_i("SCD41 configuration persisted (%d fields changed), fingerprint %08lx",
+              written, static_cast<unsigned long>(fingerprint));
+    }
+    else
+    {
+        // Configured in RAM only; checked again after the next power-on
+        trace(TraceEvent::SCD41_CONFIGURED, written);
+    }
 
+    CO2SensorApplied = desired;
     CO2SensorInitialized = true;
-    return CO2SensorInitialized;
+    return true;
+}
+
+Scd41Config CO2Sensor::desiredConfiguration() const
+{
+    // The initial period represents the number of readings after powering up the sensor for the very first time to trigger the
+    // first automatic self-calibration. The standard period represents the number of subsequent readings periodically
+    // triggering ASC after completion of the initial period. Sensirion recommends adjusting the number of samples
+    // comprising initial and standard period to 2 and 7 days at the average intended sampling rate, respectively.
+    Scd41Config config;
+    config.ascEnabled = 1;
+    config.ascTarget = ASC_TARGET_PPM;
+    // Discarded shots after wake_up count too, so the periods are scaled by the interval between shots
+    float shotsPerSample = powerState.shotsPerSample > 1.0f ? powerState.shotsPerSample : 1.0f;
+    uint32_t intervalSeconds = samplingIntervalSeconds ? samplingIntervalSeconds : settings.getSamplingIntervalSeconds();
+    uint32_t shotIntervalSeconds = static_cast<uint32_t>(intervalSeconds / shotsPerSample);
+    config.ascInitialPeriod = ascPeriodParameter(2 * 24, shotIntervalSeconds);
+    config.ascStandardPeriod = ascPeriodParameter(7 * 24, shotIntervalSeconds);
+    config.temperatureOffset = settings.getTemperatureOffset();
+    return config;
 }
 
-bool CO2Sensor::checkConfiguration()
+bool CO2Sensor::applyConfiguration(const Scd41Config &desired, uint8_t &written)
 {
+    // Read each field and rewrite only the ones that differ. A failed read counts as a difference.
     int16_t error = NO_ERROR;
+    written = 0;
 
-    // Check if automatic self-calibration is enabled
-    uint16_t ascEnabled;
-    error = sensor.getAutomaticSelfCalibrationEnabled(ascEnabled);
-    if (error != NO_ERROR)
+    uint16_t ascTarget = 0;
+    error = onBus([&] { return sensor.getAutomaticSelfCalibrationTarget(ascTarget); });
+    if (error != NO_ERROR || ascTarget != desired.ascTarget)
     {
-        log_d("Failed to read ASC status: error %d", error);
-        return false;
+        log_d("ASC target: current=%d, expected=%d", ascTarget, desired.ascTarget);
+        error = onBus([&] { return sensor.setAutomaticSelfCalibrationTarget(desired.ascTarget); });
+        if (error != NO_ERROR)
+        {
+            printError("setAutomaticSelfCalibrationTarget", error);
+            return false;
+        }
+        written++;
     }
-    log_d("Automatic self-calibration enabled: %d", ascEnabled);
 
-    if (ascEnabled == 0)
+    uint16_t initialPeriod = 0;
+    error = onBus([&] { return sensor.getAutomaticSelfCalibrationInitialPeriod(initialPeriod); });
+    if (error != NO_ERROR || initialPeriod != desired.ascInitialPeriod)
     {
-        log_d("Automatic self-calibration is not enabled");
-        return false;
+        log_d("ASC initial period: current=%d, expected=%d", initialPeriod, desired.ascInitialPeriod);
+        error = onBus([&] { return sensor.setAutomaticSelfCalibrationInitialPeriod(desired.ascInitialPeriod); });
+        if (error != NO_ERROR)
+        {
+            printError("setAutomaticSelfCalibrationInitialPeriod", error);
+            return false;
+        }
+        written++;
     }
 
-    // Check if the calibration target is set correctly (424 ppm)
-    uint16_t target;
-    error = sensor.getAutomaticSelfCalibrationTarget(target);
-    if (error != NO_ERROR)
+    uint16_t standardPeriod = 0;
+    error = onBus([&] { return sensor.getAutomaticSelfCalibrationStandardPeriod(standardPeriod); });
+    if (error != NO_ERROR || standardPeriod != desired.ascStandardPeriod)
     {
-        log_d("Failed to read ASC target: error %d", error);
-        return false;
+        log_d("ASC standard period: current=%d, expected=%d", standardPeriod, desired.ascStandardPeriod);
+        error = onBus([&] { return sensor.setAutomaticSelfCalibrationStandardPeriod(desired.ascStandardPeriod); });
+        if (error != NO_ERROR)
+        {
+            printError("setAutomaticSelfCalibrationStandardPeriod", error);
+            return false;
+        }
+        written++;
     }
-    log_d("Automatic self-calibration target: %d ppm", target);
 
-    if (target != 424)
+    uint16_t ascEnabled = 0;
+    error = onBus([&] { return sensor.getAutomaticSelfCalibrationEnabled(ascEnabled); });
+    if (error != NO_ERROR || ascEnabled != desired.ascEnabled)
     {
-        log_d("ASC target mismatch: current=%d, expected=424", target);
-        return false;
+        log_d("ASC enabled: current=%d, expected=%d", ascEnabled, desired.ascEnabled);
+        error = onBus([&] { return sensor.setAutomaticSelfCalibrationEnabled(desired.ascEnabled); });
+        if (error != NO_ERROR)
+        {
+            printError("setAutomaticSelfCalibrationEnabled", error);
+            return false;
+        }
+        written++;
     }
 
-    // Calculate expected periods based on sampling interval
-    uint16_t expectedInitialPeriod = static_cast<uint16_t>(round((2 * 24 * (3600 / samplingIntervalSeconds) / 12) / 4) * 4);
-    uint16_t expectedStandardPeriod = static_cast<uint16_t>(round((7 * 24 * (3600 / samplingIntervalSeconds) / 12) / 4) * 4);
+    float offset = NAN;
+    error = onBus([&] { return sensor.getTemperatureOffset(offset); });
+    if (error != NO_ERROR || !(fabsf(offset - desired.temperatureOffset) <= 0.01f))
+    {
+        log_d("Temperature offset: current=%.2f, expected=%.2f", offset, desired.temperatureOffset);
+        error = onBus([&] { return sensor.setTemperatureOffset(desired.temperatureOffset); });
+        if (error != NO_ERROR)
+        {
+            printError("setTemperatureOffset", error);
+            return false;
+        }
+        written++;
+    }
 
-    // Check if initial period is set correctly
-    uint16_t currentInitialPeriod;
-    error = sensor.getAutomaticSelfCalibrationInitialPeriod(currentInitialPeriod);
-    if (error != NO_ERROR)
+    return true;
+}
+
+uint16_t CO2Sensor::ascPeriodParameter(uint32_t hours, uint32_t samplingIntervalSeconds)
+{
+    // The sensor counts single shots and assumes one every 5 minutes, so the period
+    // in hours is scaled by 300 s / interval and rounded to a multiple of 4 (minimum 4).
+    float scaled = hours * 300.0f / samplingIntervalSeconds;
+    long rounded = lroundf(scaled / 4.0f) * 4;
+    return static_cast<uint16_t>(constrain(rounded, 4L, 65532L));
+}
+
+void CO2Sensor::setSamplingInterval(uint32_t samplingIntervalSeconds)
+{
+    this->samplingIntervalSeconds = samplingIntervalSeconds;
+    Scd41Config desired = desiredConfiguration();
+
+    // The average follows the daily occupancy pattern; only reconfigure when a period is off by more than
+    // a quarter, so the sensor is not rewritten back and forth every day
+    auto drifted = [](uint16_t desired, uint16_t applied)
+    { return abs(desired - applied) * 4 > applied; };
+    if (CO2SensorInitialized && (drifted(desired.ascInitialPeriod, CO2SensorApplied.ascInitialPeriod) ||
+                                 drifted(desired.ascStandardPeriod, CO2SensorApplied.ascStandardPeriod)))
     {
-        log_d("Failed to read ASC initial period: error %d", error);
-        return false;
+        trace(TraceEvent::SCD41_ASC_INTERVAL, static_cast<int32_t>(samplingIntervalSeconds));
+        CO2SensorInitialized = false;
     }
-    log_d("Automatic self-calibration initial period: %d", currentInitialPeriod);
+}
 
-    if (currentInitialPeriod != expectedInitialPeriod)
+void CO2Sensor::setSleepFunction(SleepFunction sleep)
+{
+    this->sleep = sleep;
+}
+
+bool CO2Sensor::measure(uint16_t &co2, float &temp, float &rh)
+{
+    if (!startMeasurement() || !waitForMeasurement())
     {
-        log_d("ASC initial period mismatch: current=%d, expected=%d", currentInitialPeriod, expectedInitialPeriod);
         return false;
     }
+    return readMeasurement(co2, temp, rh);
+}
 
-    // Check if standard period is set correctly
-    uint16_t currentStandardPeriod;
-    error = sensor.getAutomaticSelfCalibrationStandardPeriod(currentStandardPeriod);
-    if (error != NO_ERROR)
+bool CO2Sensor::startMeasurement(MeasurementKind kind)
+{
+    if (!initialize())
     {
-        log_d("Failed to read ASC standard period: error %d", error);
         return false;
     }
-    log_d("Automatic self-calibration standard period: %d", currentStandardPeriod);
 
-    if (currentStandardPeriod != expectedStandardPeriod)
+    // Temperature and humidity are not affected by wake-up, and only CO2 shots count for the ASC
+    if (kind == MeasurementKind::RHT_ONLY)
     {
-        log_d("ASC standard period mismatch: current=%d, expected=%d", currentStandardPeriod, expectedStandardPeriod);
-        return false;
+        return sendSingleShot(kind);
     }
 
-    // Check if temperature offset is set correctly
-    float currentTempOffset;
-    error = sensor.getTemperatureOffset(currentTempOffset);
-    if (error != NO_ERROR)
+    float shots = 1.0f;
+    if (powerState.discardNext)
     {
-        log_d("Failed to read temperature offset: error %d", error);
-        return false;
+        trace(TraceEvent::SCD41_DISCARD);
+        uint16_t co2;
+        float temp, rh;
+        if (!sendSingleShot(kind) || !waitForMeasurement() || !readMeasurement(co2, temp, rh))
+        {
+            return false;
+        }
+        powerState.discardNext = false;
+        shots = 2.0f;
     }
-    log_d("Current temperature offset: %.2f C", currentTempOffset);
 
-    if (fabs(currentTempOffset - temperatureOffset) > 0.01f)
+    if (powerState.shotsPerSample == 0.0f)
     {
-        log_d("Temperature offset mismatch: current=%.2f, expected=%.2f", currentTempOffset, temperatureOffset);
-        return false;
+        powerState.shotsPerSample = 1.0f;
     }
+    powerState.shotsPerSample += (shots - powerState.shotsPerSample) / SHOTS_PER_SAMPLE_WINDOW;
 
-    log_d("Sensor is properly configured (target=%d, initial=%d, standard=%d)",
-          target, currentInitialPeriod, currentStandardPeriod);
-    return true;
+    return sendSingleShot(kind);
 }
 
-bool CO2Sensor::measure(uint16_t &co2, float &temp, float &rh)
+bool CO2Sensor::sendSingleShot(MeasurementKind kind)
 {
-    if (!initialize())
-    {
-        return false;
-    }
+    uint8_t communication_buffer[9] = {0};
+
+    // Send the measure_single_shot (0x219D) or measure_single_shot_rht_only (0x2196) command
+    uint16_t command = kind == MeasurementKind::RHT_ONLY ? 0x2196 : 0x219d;
+    SensirionI2CTxFrame txFrame = SensirionI2CTxFrame::createWithUInt16Command(command, communication_buffer, 2);
+    int16_t error = onBus([&]
+                          { return SensirionI2CCommunication::sendFrame(SCD41_I2C_ADDR_62, txFrame, Wire); });
 
-    auto start = millis();
-    int16_t error = sensor.measureAndReadSingleShot(co2, temp, rh);
     if (error != NO_ERROR)
     {
-        printError("measureAndReadSingleShot", error);
+        printError(kind == MeasurementKind::RHT_ONLY ? "measureSingleShotRhtOnly" : "measureSingleShot", error);
         return false;
     }
 
-    log_i("CO2: %d ppm, Temp: %.2f C, RH: %.2f %%", co2, temp, rh);
-    log_i("Measurement took %lu ms", millis() - start);
+    measurementStartUs = esp_rtc_get_time_us();
+    measurementReady = false;
+    pendingKind = kind;
     return true;
 }
 
-bool CO2Sensor::startMeasurement()
+uint32_t CO2Sensor::predictedLatencyMs() const
 {
-    if (!initialize())
+    if (pendingKind == MeasurementKind::RHT_ONLY)
+        return SINGLE_SHOT_RHT_ONLY_MS;
+    return timing.latencyMs ? timing.latencyMs : SINGLE_SHOT_MAX_MS;
+}
+
+uint32_t CO2Sensor::getRemainingMeasurementMs() const
+{
+    uint32_t elapsedMs = (esp_rtc_get_time_us() - measurementStartUs) / 1000;
+    uint32_t predictedMs = predictedLatencyMs();
+    return elapsedMs < predictedMs ? predictedMs - elapsedMs : 0;
+}
+
+bool CO2Sensor::waitForMeasurement()
+{
+    bool learn = pendingKind == MeasurementKind::CO2;
+    uint32_t predictedMs = predictedLatencyMs();
+    uint32_t timeoutMs = learn ? SINGLE_SHOT_TIMEOUT_MS : SINGLE_SHOT_RHT_ONLY_TIMEOUT_MS;
+    uint32_t elapsedMs = (esp_rtc_get_time_us() - measurementStartUs) / 1000;
+    if (elapsedMs < predictedMs)
     {
-        return false;
+        sleep(predictedMs - elapsedMs);
     }
-    
-    uint8_t communication_buffer[9] = {0};
 
-    // Send the measure_single_shot command (0x219D)
-    SensirionI2CTxFrame txFrame = SensirionI2CTxFrame::createWithUInt16Command(0x219d, communication_buffer, 2);
-    int16_t error = SensirionI2CCommunication::sendFrame(SCD41_I2C_ADDR_62, txFrame, Wire);
-
-    if (error != NO_ERROR)
+    bool firstPoll = true;
+    while (true)
     {
-        printError("measureSingleShot", error);
-        return false;
+        bool dataReady = false;
+        int16_t error = onBus([&] { return sensor.getDataReadyStatus(dataReady); });
+        elapsedMs = (esp_rtc_get_time_us() - measurementStartUs) / 1000;
+
+        if (error != NO_ERROR)
+        {
+            timing.busErrors++;
+            printError("getDataReadyStatus", error);
+        }
+        else if (dataReady && !learn)
+        {
+            measurementReady = true;
+            return true;
+        }
+        else if (dataReady)
+        {
+            // On time: try a little earlier next time. Late: the sensor needs at least this long.
+            if (firstPoll)
+                timing.latencyMs = predictedMs > SINGLE_SHOT_PROBE_STEP_MS ? predictedMs - SINGLE_SHOT_PROBE_STEP_MS : predictedMs;
+            else
+                timing.latencyMs = std::min<uint32_t>(elapsedMs, SINGLE_SHOT_MAX_MS);
+            timing.measurements++;
+            measurementReady = true;
+            trace(TraceEvent::SCD41_READY, static_cast<int32_t>(elapsedMs), timing.latencyMs);
+            return true;
+        }
+        else
+        {
+            timing.extraPolls++;
+        }
+
+        if (elapsedMs >= timeoutMs)
+        {
+            timing.timeouts++;
+            log_e("Measurement not ready after %lu ms (%lu timeouts since power-on)",
+                  static_cast<unsigned long>(elapsedMs), static_cast<unsigned long>(timing.timeouts));
+            // Check the sensor configuration again before the next measurement
+            CO2SensorInitialized = false;
+            return false;
+        }
+
+        firstPoll = false;
+        sleep(SINGLE_SHOT_POLL_SLICE_MS);
     }
+}
 
-    return true;
+void CO2Sensor::printStats()
+{
+    Serial.printf("SCD41 single shots since power-on\n");
+    Serial.printf("%lu ready, predicted after %u ms, %lu extra polls, %lu timeouts, %lu bus errors\n",
+                  static_cast<unsigned long>(timing.measurements), timing.latencyMs,
+                  static_cast<unsigned long>(timing.extraPolls), static_cast<unsigned long>(timing.timeouts),
+                  static_cast<unsigned long>(timing.busErrors));
 }
 
 bool CO2Sensor::isMeasurementReady()
 {
     bool dataReady = false;
-    int16_t error = sensor.getDataReadyStatus(dataReady);
+    int16_t error = onBus([&] { return sensor.getDataReadyStatus(dataReady); });
     if (error != NO_ERROR)
     {
         printError("getDataReadyStatus", error);
@@ -246,19 +545,23 @@ bool CO2Sensor::isMeasurementReady()
 
 bool CO2Sensor::readMeasurement(uint16_t &co2, float &temp, float &rh)
 {
-    if (!isMeasurementReady())
+    // waitForMeasurement() already saw the data ready flag
+    if (!measurementReady && !isMeasurementReady())
     {
         log_w("Measurement not ready yet");
         return false;
     }
 
-    int16_t error = sensor.readMeasurement(co2, temp, rh);
+    measurementReady = false;
+    int16_t error = onBus([&] { return sensor.readMeasurement(co2, temp, rh); });
     if (error != NO_ERROR)
     {
         printError("readMeasurement", error);
         return false;
     }
 
-    log_i("CO2: %d ppm, Temp: %.2f C, RH: %.2f %%", co2, temp, rh);
+    if (pendingKind != MeasurementKind::RHT_ONLY)
+        trace(TraceEvent::READING_CO2, co2);
+    trace(TraceEvent::READING_CLIMATE, traceCenti(temp), traceCenti(rh));
     return true;
 }
@@ -3,42 +3,189 @@
 
 #include <Wire.h>
 #include <SensirionI2cScd4x.h>
+#include "Settings.h"
+#include "MeasurementKind.h"
+#include "I2CBus.h"
 
 #define NO_VALUE -123456789.0f
 #define NO_ERROR 0
 
 RTC_DATA_ATTR static bool CO2SensorInitialized = false;
 
+struct Scd41Config
+{
+    uint16_t ascEnabled;
+    uint16_t ascTarget;
+    uint16_t ascInitialPeriod;
+    uint16_t ascStandardPeriod;
+    float temperatureOffset;
+};
+
+// Sleeps the CPU while waiting for the sensor, delay() unless set otherwise
+typedef void (*SleepFunction)(uint32_t milliseconds);
+
 class CO2Sensor
 {
 private:
     SensirionI2cScd4x sensor;
-    uint32_t samplingIntervalSeconds;
-    float temperatureOffset = 0.0f;
+    SleepFunction sleep;
+    uint64_t measurementStartUs = 0;
+    bool measurementReady = false;
+    Settings &settings;
+    I2CBus &bus;
+    uint32_t samplingIntervalSeconds = 0;
+    bool persistConfiguration;
+    uint32_t powerDownMinSleepSeconds;
+    bool busConfigured = false;
+    MeasurementKind pendingKind = MeasurementKind::CO2;
     static char errorMessage[64];
 
-    bool initialize();
-    bool checkConfiguration();
+    void beginBus();
+    bool wakeUp();
+    bool sendSingleShot(MeasurementKind kind);
+    uint32_t predictedLatencyMs() const;
+    Scd41Config desiredConfiguration() const;
+    bool applyConfiguration(const Scd41Config &desired, uint8_t &written);
     void printError(const char *prefix, int16_t err);
 
+    // One driver call as an SCD41 bus transaction, retried on error
+    template <typename Operation>
+    int16_t onBus(Operation operation)
+    {
+        return bus.run(BusDevice::SCD41, operation);
+    }
+
+    static uint16_t ascPeriodParameter(uint32_t hours, uint32_t samplingIntervalSeconds);
+
+    static constexpr uint32_t fnv1a(uint32_t hash, uint16_t word)
+    {
+        return ((hash ^ (word & 0xff)) * 16777619u ^ (word >> 8)) * 16777619u;
+    }
+
 public:
-    CO2Sensor(uint32_t samplingIntervalSeconds, float temperatureOffset = 0.0f);
+    /**
+     * The temperature offset is taken from the settings, and so is the
+     * sampling interval until setSamplingInterval() is called.
+     *
+     * @param persistConfiguration write a changed configuration to the SCD41
+     * EEPROM, so it survives a power cycle. Limited to once a week.
+     */
+    CO2Sensor(Settings &settings, I2CBus &bus, bool persistConfiguration = true);
+
+    /**
+     * @brief FNV-1a hash of a configuration on a given sensor.
+     *
+     * The temperature offset is hashed in 0.01 °C steps. Usable in constant
+     * expressions, so fixed configurations hash at compile time.
+     */
+    static constexpr uint32_t configurationFingerprint(const Scd41Config &config, uint64_t serialNumber)
+    {
+        return fnv1a(fnv1a(fnv1a(fnv1a(fnv1a(fnv1a(fnv1a(fnv1a(2166136261u,
+                   static_cast<uint16_t>(serialNumber >> 32)), static_cast<uint16_t>(serialNumber >> 16)),
+                   static_cast<uint16_t>(serialNumber)), config.ascEnabled), config.ascTarget),
+                   config.ascInitialPeriod), config.ascStandardPeriod),
+                   static_cast<uint16_t>(static_cast<int16_t>(config.temperatureOffset * 100.0f +
+                                                              (config.temperatureOffset < 0 ? -0.5f : 0.5f))));
+    }
+
+    /**
+     * @brief Attach the sensor on the I2C bus and configure it if needed.
+     *
+     * Called implicitly by measure() and startMeasurement(). The bus is set up
+     * once per boot and the configuration checked once per power-on: a single
+     * serial number read, when the fingerprint of the desired configuration on
+     * this sensor matches the one last persisted.
+     */
+    bool initialize();
+
+    /**
+     * @brief Update the average interval between single shots.
+     *
+     * The ASC initial and standard periods are counted in single shots, so they
+     * are scaled by this interval. When the scaled values change, the sensor is
+     * reconfigured on the next initialize().
+     */
+    void setSamplingInterval(uint32_t samplingIntervalSeconds);
+
+    void setSleepFunction(SleepFunction sleep);
 
+    /**
+     * @brief Start a single shot, wait for it and read the result.
+     */
     bool measure(uint16_t &co2, float &temp, float &rh);
 
+    /**
+     * @brief Put the sensor into power-down before a deep sleep, when worth it.
+     *
+     * Waking up costs an extra single shot, because the first reading after
+     * wake_up has to be discarded. The sensor is therefore only powered down
+     * when the sleep is at least as long as the threshold set with
+     * setPowerDownMinSleep(). A sleep of that length is where the idle current
+     * saved pays for the extra shot. The next initialize() wakes it up again.
+     * RHT-only wakes in between do not need the discard, so they power the
+     * sensor down again as long as the next CO2 shot is far enough away.
+     *
+     * @param sleepSeconds time until the next CO2 shot.
+     * @return true if the sensor is powered down.
+     */
+    bool prepareForSleep(uint64_t sleepSeconds);
+
+    /**
+     * @brief Forget the power state after a wake cycle was cut short, without touching the bus.
+     *
+     * The sensor may have been left idle or powered down. The next
+     * initialize() sends wake_up and discards the first reading if the sensor
+     * was powered down before. The next prepareForSleep() powers it down again.
+     */
+    void markInterrupted();
+
+    /**
+     * @param seconds shortest deep sleep the sensor is powered down for, 0 to never power down.
+     */
+    void setPowerDownMinSleep(uint32_t seconds);
+    bool isPoweredDown() const;
+    // The next CO2 shot is preceded by one that is discarded, after the sensor was powered down
+    bool needsDiscardShot() const;
+
     /**
      * @brief Start a single shot measurement.
      *
-     * This function only triggers a measurement, which takes 5 seconds to complete.
-     * It is simply a copy of the measureSingleShot() function from the Sensirion library,
-     * except that it does not wait for the measurement to complete, which allows us to
-     * save power by putting the CPU to sleep while waiting.
+     * This function only triggers a measurement, which takes 5 seconds to complete,
+     * or 50 ms for an RHT-only shot. It is simply a copy of the measureSingleShot()
+     * function from the Sensirion library, except that it does not wait for the
+     * measurement to complete, which allows us to save power by putting the CPU to
+     * sleep while waiting.
      *
+     * @param kind full CO2 shot or temperature and humidity only.
      * @return error_code 0 on success, an error code otherwise.
      */
-    bool startMeasurement();
+    bool startMeasurement(MeasurementKind kind = MeasurementKind::CO2);
+
+    /**
+     * @brief Wait for the single shot started by startMeasurement().
+     *
+     * Sleeps until the latency learned for this sensor has passed, then polls
+     * the data ready status in short sleep slices. Gives up after a hard
+     * timeout. The latency and error counts are kept in RTC memory. RHT-only
+     * shots wait their fixed execution time and are not learned.
+     *
+     * @return true when a measurement is ready to read.
+     */
+    bool waitForMeasurement();
+
+    /**
+     * @brief Time left until the started single shot is predicted to be ready, 0 once it is due.
+     *
+     * Lets the caller start other slow work, like the radio, so that it ends
+     * together with the measurement.
+     */
+    uint32_t getRemainingMeasurementMs() const;
+
     bool readMeasurement(uint16_t &co2, float &temp, float &rh);
     bool isMeasurementReady();
+
+    // Single shot latency and errors since power-on
+    void printStats();
 };
 
 #endif
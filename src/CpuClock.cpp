@@ -0,0 +1,127 @@
+#include "CpuClock.h"
+#include "Trace.h"
+#include "rtc.h"
+
+#define LEVEL_COUNT static_cast<size_t>(ClockLevel::COUNT)
+
+struct ClockTotals
+{
+    uint64_t awakeUs[LEVEL_COUNT];
+    uint64_t lightSleepUs;
+};
+
+RTC_DATA_ATTR static ClockTotals totals = {};
+
+bool CpuClock::begin()
+{
+    levelStartUs = esp_rtc_get_time_us();
+
+    // Automatic light sleep needs tickless idle; try it first, then frequency scaling on its own
+    lightSleep = true;
+    enabled = true;
+    if (!configure(level))
+    {
+        lightSleep = false;
+        if (!configure(level))
+        {
+            log_w("Power management not available, CPU stays at %u MHz", levelMhz(level));
+            enabled = false;
+            return false;
+        }
+        log_w("No automatic light sleep without tickless idle, frequency scaling only");
+    }
+
+    if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "awake", &awakeLock) != ESP_OK)
+        awakeLock = nullptr;
+
+    trace(TraceEvent::POWER_MANAGEMENT, levelMhz(ClockLevel::MIN), levelMhz(level));
+    if (lightSleep)
+        trace(TraceEvent::AUTO_LIGHT_SLEEP);
+    return true;
+}
+
+bool CpuClock::configure(ClockLevel ceiling)
+{
+    esp_pm_config_t config = {};
+    config.max_freq_mhz = levelMhz(ceiling);
+    config.min_freq_mhz = levelMhz(ClockLevel::MIN);
+    config.light_sleep_enable = lightSleep;
+    return esp_pm_configure(&config) == ESP_OK;
+}
+
+void CpuClock::account()
+{
+    uint64_t now = esp_rtc_get_time_us();
+    totals.awakeUs[static_cast<size_t>(level)] += now - levelStartUs;
+    levelStartUs = now;
+}
+
+void CpuClock::setCeiling(ClockLevel ceiling)
+{
+    if (!enabled || ceiling == level)
+        return;
+
+    account();
+    if (configure(ceiling))
+        level = ceiling;
+    else
+        log_w("CPU clock ceiling of %u MHz refused", levelMhz(ceiling));
+}
+
+void CpuClock::holdAwake()
+{
+    if (awakeLock == nullptr || awakeHeld)
+        return;
+
+    esp_pm_lock_acquire(awakeLock);
+    awakeHeld = true;
+}
+
+void CpuClock::beginLightSleep()
+{
+    account();
+}
+
+void CpuClock::endLightSleep()
+{
+    uint64_t now = esp_rtc_get_time_us();
+    totals.lightSleepUs += now - levelStartUs;
+    levelStartUs = now;
+}
+
+bool CpuClock::isAutoLightSleep() const
+{
+    return enabled && lightSleep && !awakeHeld;
+}
+
+void CpuClock::printStats()
+{
+    account();
+
+    uint64_t total = totals.lightSleepUs;
+    for (size_t i = 0; i < LEVEL_COUNT; i++)
+        total += totals.awakeUs[i];
+
+    Serial.printf("CPU clock since power-on, automatic light sleep %s\n", lightSleep ? "on" : "off");
+    Serial.printf("%-12s %12s %6s\n", "ceiling", "time[ms]", "share");
+    for (size_t i = 0; i < LEVEL_COUNT; i++)
+    {
+        Serial.printf("%4u MHz     %12llu %5.1f%%\n", levelMhz(static_cast<ClockLevel>(i)), totals.awakeUs[i] / 1000,
+                      total > 0 ? totals.awakeUs[i] * 100.0f / total : 0.0f);
+    }
+    Serial.printf("%-12s %12llu %5.1f%%\n", "light sleep", totals.lightSleepUs / 1000,
+                  total > 0 ? totals.lightSleepUs * 100.0f / total : 0.0f);
+}
+
+uint16_t CpuClock::levelMhz(ClockLevel level)
+{
+    switch (level)
+    {
+    case ClockLevel::MIN:
+        return CPU_CLOCK_MIN_MHZ;
+    case ClockLevel::MAX:
+        return CPU_CLOCK_MAX_MHZ;
+    default:
+        return CPU_CLOCK_NORMAL_MHZ;
+    }
+}
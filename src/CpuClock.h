@@ -0,0 +1,73 @@
+#ifndef CPU_CLOCK_H
+#define CPU_CLOCK_H
+
+#include <esp_pm.h>
+#include "Arduino.h"
+
+#ifndef CPU_CLOCK_MIN_MHZ
+#define CPU_CLOCK_MIN_MHZ 40 // Crystal clock, no PLL
+#endif
+
+#ifndef CPU_CLOCK_NORMAL_MHZ
+#define CPU_CLOCK_NORMAL_MHZ 80
+#endif
+
+#ifndef CPU_CLOCK_MAX_MHZ
+#define CPU_CLOCK_MAX_MHZ 160
+#endif
+
+enum class ClockLevel : uint8_t
+{
+    MIN,    // I2C, display and ADC work, bound by the bus rather than the CPU
+    NORMAL, // Boot
+    MAX,    // Zigbee stack start, joining and its crypto
+    COUNT
+};
+
+/**
+ * @brief ESP-IDF power management: frequency scaling and automatic light sleep.
+ *
+ * The CPU runs at the ceiling of the current level while busy and drops to the
+ * crystal clock while idle, e.g. in delay() or waiting on the I2C bus. When
+ * nothing keeps it awake, an idle CPU light-sleeps on its own. This needs
+ * tickless idle in the sdkconfig; without it, begin() falls back to
+ * frequency scaling only. The time spent awake under each ceiling, which
+ * includes automatic light sleeps, is kept in RTC memory since power-on.
+ */
+class CpuClock
+{
+private:
+    bool enabled = false;
+    bool lightSleep = false;
+    esp_pm_lock_handle_t awakeLock = nullptr;
+    bool awakeHeld = false;
+    ClockLevel level = ClockLevel::NORMAL;
+    uint64_t levelStartUs = 0;
+
+    bool configure(ClockLevel ceiling);
+    void account();
+
+public:
+    bool begin();
+
+    /**
+     * @brief Highest clock the CPU may run at from now on.
+     */
+    void setCeiling(ClockLevel ceiling);
+
+    /**
+     * @brief Stop automatic light sleep until the next deep sleep, e.g. while the radio has to receive.
+     */
+    void holdAwake();
+
+    // Manual light sleeps are not counted at any clock
+    void beginLightSleep();
+    void endLightSleep();
+
+    bool isAutoLightSleep() const;
+
+    void printStats();
+    static uint16_t levelMhz(ClockLevel level);
+};
+
+#endif
@@ -1,67 +1,165 @@
 #include "Display.h"
+#include "Trace.h"
+#include "rtc.h"
 
-Display::Display() : u8g2(U8G2_R0, U8X8_PIN_NONE)
+struct PanelState
+{
+  bool initialized;
+  bool on;
+  bool frameValid;
+  uint8_t frame[DISPLAY_BUFFER_BYTES]; // What the panel shows
+};
+
+RTC_DATA_ATTR static PanelState panel = {};
+
+Display::Display(I2CBus &bus) : u8g2(U8G2_R0, U8X8_PIN_NONE), bus(bus)
 {
 }
 
 void Display::begin()
 {
-  u8g2.beginSimple();
+  // U8g2 sets this clock at the start of every transfer
+  u8g2.setBusClock(bus.deviceClockHz(BusDevice::DISPLAY));
+  if (panel.initialized || !bus.acquire(BusDevice::DISPLAY))
+    return;
+
+  u8g2.beginSimple(); // The init sequence leaves the panel off
+  bus.release(BusDevice::DISPLAY);
+  panel.initialized = true;
+  panel.on = false;
+  panel.frameValid = false;
 }
 
-void Display::showMeasurement(uint16_t co2, float temp, float rh, String message)
+void Display::showMeasurement(uint16_t co2, float temp, float rh, const char *message)
 {
-  u8g2.firstPage();
-  do
-  {
-    // Display CO2 measurement in big font
-    u8g2.setFont(u8g2_font_logisoso32_tn);
-    String co2Str = (co2 == 0) ? "--" : String(co2);
-    u8g2.drawStr(90 - u8g2.getStrWidth(co2Str.c_str()), 56, co2Str.c_str());
+  uint32_t start = micros();
+  char text[24];
 
-    u8g2.setFont(u8g2_font_9x18_tr);
-    u8g2.drawStr(94, 56 - 16, "CO2");
-    u8g2.drawStr(94, 56, "ppm");
+  u8g2.clearBuffer();
 
-    if (message != "")
+  // Display CO2 measurement in big font
+  u8g2.setFont(u8g2_font_logisoso32_tn);
+  if (co2 == 0)
+    strcpy(text, "--");
+  else
+    snprintf(text, sizeof(text), "%u", co2);
+  u8g2.drawStr(90 - u8g2.getStrWidth(text), 56, text);
+
+  u8g2.setFont(u8g2_font_9x18_tr);
+  u8g2.drawStr(94, 56 - 16, "CO2");
+  u8g2.drawStr(94, 56, "ppm");
+
+  if (message != nullptr && message[0] != '\0')
+  {
+    u8g2.drawStr(0, 12, message);
+  }
+  else
+  {
+    // temp and rh values top
+    if (temp != NO_VALUE)
     {
-      u8g2.setFont(u8g2_font_9x18_tr);
-      u8g2.drawStr(0, 12, message.c_str());
+      snprintf(text, sizeof(text), "%.1f", temp);
+      u8g2.drawStr(0, 12, text);
+      int tempStrWidth = u8g2.getStrWidth(text);
+
+      // Draw degree symbol
+      u8g2.drawCircle(tempStrWidth + 3, 4, 2);
+      u8g2.drawStr(tempStrWidth + 8, 12, "C");
     }
     else
     {
-      // temp and rh values top
-      u8g2.setFont(u8g2_font_9x18_tr); // smaller 14px font
+      u8g2.drawStr(0, 12, "--");
+    }
 
-      if (temp != NO_VALUE)
-      {
-        String tempStr = String(temp, 1);
-        u8g2.drawStr(0, 12, tempStr.c_str());
-        int tempStrWidth = u8g2.getStrWidth(tempStr.c_str());
+    if (rh != NO_VALUE)
+      snprintf(text, sizeof(text), "%.1f%%", rh);
+    else
+      strcpy(text, "--");
+    u8g2.drawStr(128 - u8g2.getStrWidth(text), 12, text);
+  }
 
-        // Draw degree symbol
-        u8g2.drawCircle(tempStrWidth + 3, 4, 2);
-        u8g2.drawStr(tempStrWidth + 8, 12, "C");
-      }
-      else
+  if (bus.acquire(BusDevice::DISPLAY))
+  {
+    sendChangedTiles();
+    bus.release(BusDevice::DISPLAY);
+  }
+  u8g2.refreshDisplay();
+
+  lastUpdateUs = micros() - start;
+  trace(TraceEvent::DISPLAY_UPDATE, lastTilesSent, static_cast<int32_t>(lastUpdateUs));
+}
+
+void Display::sendChangedTiles()
+{
+  uint8_t *frame = u8g2.getBufferPtr();
+  lastTilesSent = 0;
+
+  if (!panel.frameValid)
+  {
+    u8g2.sendBuffer();
+    memcpy(panel.frame, frame, DISPLAY_BUFFER_BYTES);
+    panel.frameValid = true;
+    lastTilesSent = DISPLAY_TILE_COLUMNS * DISPLAY_TILE_ROWS;
+    return;
+  }
+
+  // The buffer holds one row of tiles after the other, so each run of changed tiles is one transfer
+  for (uint8_t row = 0; row < DISPLAY_TILE_ROWS; row++)
+  {
+    uint8_t column = 0;
+    while (column < DISPLAY_TILE_COLUMNS)
+    {
+      size_t offset = (row * DISPLAY_TILE_COLUMNS + column) * 8;
+      if (memcmp(frame + offset, panel.frame + offset, 8) == 0)
       {
-        u8g2.drawStr(0, 12, "--");
+        column++;
+        continue;
       }
 
-      String rhStr = (rh != NO_VALUE) ? String(rh, 1) + "%" : "--";
-      u8g2.drawStr(128 - u8g2.getStrWidth(rhStr.c_str()), 12, rhStr.c_str());
+      uint8_t first = column;
+      size_t runOffset = offset;
+      do
+      {
+        column++;
+        offset += 8;
+      } while (column < DISPLAY_TILE_COLUMNS && memcmp(frame + offset, panel.frame + offset, 8) != 0);
+
+      uint8_t count = column - first;
+      u8x8_DrawTile(u8g2.getU8x8(), first, row, count, frame + runOffset);
+      memcpy(panel.frame + runOffset, frame + runOffset, count * 8);
+      lastTilesSent += count;
     }
+  }
+}
 
-  } while (u8g2.nextPage());
-  u8g2.refreshDisplay();
+uint16_t Display::getLastTilesSent() const
+{
+  return lastTilesSent;
+}
+
+uint32_t Display::getLastUpdateUs() const
+{
+  return lastUpdateUs;
 }
 
 void Display::turnOn()
 {
+  if (!bus.acquire(BusDevice::DISPLAY))
+    return;
+
   u8g2.setPowerSave(0);
+  bus.release(BusDevice::DISPLAY);
+  if (!panel.on)
+    trace(TraceEvent::DISPLAY_ON, static_cast<int32_t>(millis()));
+  panel.on = true;
 }
 
 void Display::turnOff()
 {
+  if (!bus.acquire(BusDevice::DISPLAY))
+    return;
+
   u8g2.setPowerSave(1);
+  bus.release(BusDevice::DISPLAY);
+  panel.on = false;
 }
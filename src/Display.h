@@ -3,20 +3,42 @@
 
 #include <U8g2lib.h>
 #include "Arduino.h"
+#include "I2CBus.h"
 
 #define NO_VALUE -123456789.0f
 
+#define DISPLAY_TILE_COLUMNS 16
+#define DISPLAY_TILE_ROWS 8
+#define DISPLAY_BUFFER_BYTES (DISPLAY_TILE_COLUMNS * DISPLAY_TILE_ROWS * 8)
+
 class Display {
 private:
-    U8G2_SSD1315_128X64_NONAME_1_HW_I2C u8g2;
+    U8G2_SSD1315_128X64_NONAME_F_HW_I2C u8g2;
+    I2CBus &bus;
+    uint16_t lastTilesSent = 0;
+    uint32_t lastUpdateUs = 0;
+
+    void sendChangedTiles();
 
 public:
-    Display();
+    Display(I2CBus &bus);
     
+    /**
+     * @brief Initialize the panel once per power-on.
+     *
+     * The panel stays powered through deep sleep and keeps its configuration
+     * and frame. A copy of that frame is kept in RTC memory, so after a deep
+     * sleep begin() sends nothing and the next update only sends the tiles
+     * that changed since.
+     */
     void begin();
-    void showMeasurement(uint16_t co2, float temp, float rh, String message = "");
+    void showMeasurement(uint16_t co2, float temp, float rh, const char *message = nullptr);
     void turnOn();
     void turnOff();
+
+    // Last showMeasurement(): tiles sent over I2C, 128 for a full frame, and the time it took
+    uint16_t getLastTilesSent() const;
+    uint32_t getLastUpdateUs() const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,250 @@
+#include "EnergyMonitor.h"
+#include "Trace.h"
+#include <esp_sleep.h>
+#include "rtc.h"
+
+static const size_t PHASE_COUNT = static_cast<size_t>(EnergyPhase::COUNT);
+
+// Modelled supply current. The CPU is counted at 80 MHz while awake, whatever
+// ceiling CpuClock sets and however long it idles; each phase adds what it
+// switches on. The deep sleep floor is the README board measurement,
+// the SCD41 idles on top of it whenever it is not measuring.
+static const float CPU_ACTIVE_MA = 22.0f;
+static const float CPU_LIGHT_SLEEP_MA = 0.18f;
+static const float DEEP_SLEEP_MA = 0.018f;
+static const float SENSOR_IDLE_MA = 0.15f;
+static const float SENSOR_POWER_DOWN_MA = 0.0004f;
+static const float PHASE_EXTRA_MA[PHASE_COUNT] = {
+    SENSOR_IDLE_MA,         // BOOT
+    SENSOR_IDLE_MA,         // SENSOR_INIT
+    18.0f,                  // MEASURE: SCD41 single shot
+    SENSOR_IDLE_MA,         // BATTERY
+    SENSOR_IDLE_MA + 58.0f, // RADIO_CONNECT: 802.15.4 receiver
+    SENSOR_IDLE_MA + 58.0f, // REPORT
+    SENSOR_IDLE_MA + 8.0f,  // DISPLAY: SSD1315 panel
+    SENSOR_IDLE_MA,         // DEEP_SLEEP
+};
+
+static const uint32_t DEFAULT_BOOT_LATENCY_US = 100000;
+
+struct EnergyTotals
+{
+    uint32_t cycles;
+    uint32_t entries[PHASE_COUNT];
+    uint64_t activeUs[PHASE_COUNT];
+    uint64_t lightSleepUs[PHASE_COUNT];
+    uint64_t sleepStartUs;
+    uint64_t plannedSleepUs;
+    uint32_t bootLatencyUs;
+    uint64_t sensorDownUs; // part of the deep sleep time with the SCD41 powered down
+    bool sensorPoweredDown;
+};
+
+RTC_DATA_ATTR static EnergyTotals totals = {};
+
+EnergyMonitor::EnergyMonitor()
+    : currentPhase(EnergyPhase::BOOT), phaseStartUs(0), lightSleepStartUs(0), cycleStartUs(0), started(false)
+{
+}
+
+void EnergyMonitor::start()
+{
+    started = true;
+    uint64_t now = esp_rtc_get_time_us();
+    uint64_t bootUs;
+
+    if (totals.sleepStartUs == 0)
+    {
+        // Cold boot: RTC memory is fresh and only the time since app start is known
+        bootUs = micros();
+    }
+    else
+    {
+        uint64_t elapsed = now - totals.sleepStartUs;
+        uint64_t sleptUs;
+        if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER && elapsed >= totals.plannedSleepUs)
+        {
+            sleptUs = totals.plannedSleepUs;
+            totals.bootLatencyUs = static_cast<uint32_t>(elapsed - sleptUs);
+        }
+        else
+        {
+            uint64_t latency = totals.bootLatencyUs ? totals.bootLatencyUs : DEFAULT_BOOT_LATENCY_US;
+            sleptUs = elapsed > latency ? elapsed - latency : 0;
+        }
+        bootUs = elapsed - sleptUs;
+
+        size_t sleep = static_cast<size_t>(EnergyPhase::DEEP_SLEEP);
+        totals.activeUs[sleep] += sleptUs;
+        totals.entries[sleep]++;
+        if (totals.sensorPoweredDown)
+            totals.sensorDownUs += sleptUs;
+    }
+
+    size_t boot = static_cast<size_t>(EnergyPhase::BOOT);
+    totals.activeUs[boot] += bootUs;
+    totals.entries[boot]++;
+    totals.cycles++;
+
+    cycleStartUs = now - bootUs;
+    currentPhase = EnergyPhase::BOOT;
+    phaseStartUs = now;
+}
+
+void EnergyMonitor::closePhase(uint64_t nowUs)
+{
+    size_t index = static_cast<size_t>(currentPhase);
+    totals.activeUs[index] += nowUs - phaseStartUs;
+    phaseStartUs = nowUs;
+}
+
+void EnergyMonitor::beginPhase(EnergyPhase phase)
+{
+    if (!started)
+        start();
+
+    closePhase(esp_rtc_get_time_us());
+    currentPhase = phase;
+    totals.entries[static_cast<size_t>(phase)]++;
+}
+
+void EnergyMonitor::beginLightSleep()
+{
+    if (!started)
+        start();
+
+    lightSleepStartUs = esp_rtc_get_time_us();
+}
+
+void EnergyMonitor::endLightSleep()
+{
+    uint64_t now = esp_rtc_get_time_us();
+    uint64_t slept = now - lightSleepStartUs;
+    size_t index = static_cast<size_t>(currentPhase);
+
+    // Move the light-sleep interval out of the phase's active time
+    totals.lightSleepUs[index] += slept;
+    phaseStartUs += slept;
+}
+
+void EnergyMonitor::setSensorPoweredDown(bool poweredDown)
+{
+    totals.sensorPoweredDown = poweredDown;
+}
+
+void EnergyMonitor::endCycle(uint64_t plannedSleepMicros)
+{
+    if (!started)
+        start();
+
+    uint64_t now = esp_rtc_get_time_us();
+    closePhase(now);
+
+    totals.sleepStartUs = now;
+    totals.plannedSleepUs = plannedSleepMicros;
+}
+
+void EnergyMonitor::traceCycle() const
+{
+    trace(TraceEvent::WAKE_CYCLE, static_cast<int32_t>(totals.cycles),
+          static_cast<int32_t>((totals.sleepStartUs - cycleStartUs) / 1000));
+    trace(TraceEvent::ENERGY, traceCenti(averageCurrentMa() * 1000.0f), traceMilli(projectedMahPerDay()));
+}
+
+float EnergyMonitor::currentLoadMa() const
+{
+    size_t index = static_cast<size_t>(currentPhase);
+    float sensorMa = totals.sensorPoweredDown ? SENSOR_POWER_DOWN_MA - SENSOR_IDLE_MA : 0.0f;
+    return CPU_ACTIVE_MA + PHASE_EXTRA_MA[index] + (currentPhase == EnergyPhase::MEASURE ? 0.0f : sensorMa);
+}
+
+float EnergyMonitor::phaseChargeMah(EnergyPhase phase) const
+{
+    size_t index = static_cast<size_t>(phase);
+    double microampSeconds;
+    if (phase == EnergyPhase::DEEP_SLEEP)
+    {
+        microampSeconds = (DEEP_SLEEP_MA + PHASE_EXTRA_MA[index]) * totals.activeUs[index] -
+                          (PHASE_EXTRA_MA[index] - SENSOR_POWER_DOWN_MA) * totals.sensorDownUs;
+    }
+    else
+    {
+        microampSeconds = (CPU_ACTIVE_MA + PHASE_EXTRA_MA[index]) * totals.activeUs[index] +
+                          (CPU_LIGHT_SLEEP_MA + PHASE_EXTRA_MA[index]) * totals.lightSleepUs[index];
+    }
+    return static_cast<float>(microampSeconds / 3.6e9);
+}
+
+float EnergyMonitor::totalChargeMah() const
+{
+    float total = 0.0f;
+    for (size_t i = 0; i < PHASE_COUNT; i++)
+        total += phaseChargeMah(static_cast<EnergyPhase>(i));
+    return total;
+}
+
+float EnergyMonitor::averageCurrentMa() const
+{
+    uint64_t elapsedUs = 0;
+    for (size_t i = 0; i < PHASE_COUNT; i++)
+        elapsedUs += totals.activeUs[i] + totals.lightSleepUs[i];
+
+    if (elapsedUs == 0)
+        return 0.0f;
+    return totalChargeMah() * 3.6e9f / elapsedUs;
+}
+
+float EnergyMonitor::projectedMahPerDay() const
+{
+    return averageCurrentMa() * 24.0f;
+}
+
+float EnergyMonitor::projectedBatteryLifeDays() const
+{
+    float perDay = projectedMahPerDay();
+    return perDay > 0.0f ? BATTERY_CAPACITY_MAH / perDay : 0.0f;
+}
+
+void EnergyMonitor::printReport()
+{
+    float total = totalChargeMah();
+
+    Serial.printf("Energy over %lu wake cycles since power-on\n", static_cast<unsigned long>(totals.cycles));
+    Serial.printf("%-14s %8s %12s %12s %10s %6s\n", "phase", "count", "active[ms]", "light[ms]", "mAh", "share");
+    for (size_t i = 0; i < PHASE_COUNT; i++)
+    {
+        EnergyPhase phase = static_cast<EnergyPhase>(i);
+        float charge = phaseChargeMah(phase);
+        Serial.printf("%-14s %8lu %12llu %12llu %10.4f %5.1f%%\n", phaseName(phase),
+                      static_cast<unsigned long>(totals.entries[i]),
+                      totals.activeUs[i] / 1000, totals.lightSleepUs[i] / 1000, charge,
+                      total > 0.0f ? charge * 100.0f / total : 0.0f);
+    }
+    Serial.printf("Average %.1f uA, %.3f mAh/day, %.0f days on %d mAh\n", averageCurrentMa() * 1000.0f,
+                  projectedMahPerDay(), projectedBatteryLifeDays(), BATTERY_CAPACITY_MAH);
+}
+
+const char *EnergyMonitor::phaseName(EnergyPhase phase)
+{
+    switch (phase)
+    {
+    case EnergyPhase::BOOT:
+        return "boot";
+    case EnergyPhase::SENSOR_INIT:
+        return "sensor init";
+    case EnergyPhase::MEASURE:
+        return "measure";
+    case EnergyPhase::BATTERY:
+        return "battery";
+    case EnergyPhase::RADIO_CONNECT:
+        return "radio connect";
+    case EnergyPhase::REPORT:
+        return "report";
+    case EnergyPhase::DISPLAY:
+        return "display";
+    case EnergyPhase::DEEP_SLEEP:
+        return "deep sleep";
+    default:
+        return "?";
+    }
+}
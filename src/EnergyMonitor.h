@@ -0,0 +1,80 @@
+#ifndef ENERGY_MONITOR_H
+#define ENERGY_MONITOR_H
+
+#include "Arduino.h"
+
+#ifndef BATTERY_CAPACITY_MAH
+#define BATTERY_CAPACITY_MAH 2000
+#endif
+
+enum class EnergyPhase : uint8_t
+{
+    BOOT,          // ROM, bootloader and setup() up to the first phase
+    SENSOR_INIT,   // CO2Sensor::initialize
+    MEASURE,       // startMeasurement -> lightSleep -> isMeasurementReady -> readMeasurement
+    BATTERY,       // readBatteryVoltage
+    RADIO_CONNECT, // ZigbeeManager::initialize/connect
+    REPORT,        // Zigbee reports
+    DISPLAY,       // Display and menu
+    DEEP_SLEEP,
+    COUNT
+};
+
+/**
+ * @brief Per-phase time and modelled charge of the wake cycles since power-on.
+ *
+ * Each wake is split into phases. The time spent awake and in light sleep is
+ * recorded per phase in RTC memory, and the charge is derived from a modelled
+ * current for each phase. Deep sleep is accounted at the following boot, once
+ * it is known how long the chip actually slept, and also separately for the
+ * part the SCD41 spent powered down.
+ */
+class EnergyMonitor
+{
+private:
+    EnergyPhase currentPhase;
+    uint64_t phaseStartUs;
+    uint64_t lightSleepStartUs;
+    uint64_t cycleStartUs;
+    bool started;
+
+    void start();
+    void closePhase(uint64_t nowUs);
+
+public:
+    EnergyMonitor();
+
+    void beginPhase(EnergyPhase phase);
+    void beginLightSleep();
+    void endLightSleep();
+
+    /**
+     * @brief Whether the SCD41 is powered down for the coming deep sleep.
+     */
+    void setSensorPoweredDown(bool poweredDown);
+
+    /**
+     * @brief Close the current phase before entering deep sleep.
+     *
+     * @param plannedSleepMicros timer wakeup the chip is about to sleep for.
+     */
+    void endCycle(uint64_t plannedSleepMicros);
+
+    // Trace the cycle endCycle() closed
+    void traceCycle() const;
+
+    // Modelled supply current of the phase the CPU is awake in right now
+    float currentLoadMa() const;
+
+    float phaseChargeMah(EnergyPhase phase) const;
+    float totalChargeMah() const;
+    float averageCurrentMa() const;
+    float projectedMahPerDay() const;
+    float projectedBatteryLifeDays() const;
+
+    void printReport();
+
+    static const char *phaseName(EnergyPhase phase);
+};
+
+#endif
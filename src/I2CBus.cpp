@@ -0,0 +1,123 @@
+#include "I2CBus.h"
+#include "rtc.h"
+
+#define DEVICE_COUNT static_cast<size_t>(BusDevice::COUNT)
+
+struct BusStats
+{
+    uint32_t transactions[DEVICE_COUNT];
+    uint64_t busyUs[DEVICE_COUNT];
+    uint32_t maxUs[DEVICE_COUNT];
+    uint32_t errors[DEVICE_COUNT];
+    uint32_t retries[DEVICE_COUNT];
+};
+
+RTC_DATA_ATTR static BusStats stats = {};
+
+I2CBus::I2CBus(TwoWire &wire, int sda, int scl) : wire(wire), sda(sda), scl(scl)
+{
+}
+
+void I2CBus::configure(BusDevice device, const BusDeviceConfig &config)
+{
+    configs[static_cast<size_t>(device)] = config;
+}
+
+uint32_t I2CBus::deviceClockHz(BusDevice device) const
+{
+    return configs[static_cast<size_t>(device)].clockHz;
+}
+
+bool I2CBus::begin()
+{
+    if (!wire.begin(sda, scl))
+    {
+        log_e("I2C bus failed to start");
+        return false;
+    }
+
+    clockHz = wire.getClock();
+    return true;
+}
+
+bool I2CBus::acquire(BusDevice device)
+{
+    if (open)
+    {
+        log_e("I2C bus: %s transaction while %s holds the bus", deviceName(device), deviceName(owner));
+        return false;
+    }
+
+    size_t index = static_cast<size_t>(device);
+    const BusDeviceConfig &config = configs[index];
+    if (used[index])
+    {
+        uint32_t idleUs = micros() - lastEndUs[index];
+        if (idleUs < config.spacingUs)
+            delayMicroseconds(config.spacingUs - idleUs);
+    }
+
+    if (config.clockHz != 0 && config.clockHz != clockHz)
+    {
+        wire.setClock(config.clockHz);
+        clockHz = config.clockHz;
+    }
+
+    open = true;
+    owner = device;
+    startUs = micros();
+    return true;
+}
+
+void I2CBus::release(BusDevice device, bool failed)
+{
+    if (!open || owner != device)
+        return;
+
+    size_t index = static_cast<size_t>(device);
+    uint32_t endUs = micros();
+    uint32_t elapsedUs = endUs - startUs;
+
+    stats.transactions[index]++;
+    stats.busyUs[index] += elapsedUs;
+    if (elapsedUs > stats.maxUs[index])
+        stats.maxUs[index] = elapsedUs;
+    if (failed)
+        stats.errors[index]++;
+
+    lastEndUs[index] = endUs;
+    used[index] = true;
+    open = false;
+}
+
+void I2CBus::recordRetry(BusDevice device)
+{
+    stats.retries[static_cast<size_t>(device)]++;
+}
+
+void I2CBus::printStats()
+{
+    Serial.printf("I2C bus since power-on\n");
+    Serial.printf("%-8s %8s %8s %12s %10s %7s %7s\n", "device", "clock", "count", "busy[ms]", "max[us]", "errors",
+                  "retries");
+    for (size_t i = 0; i < DEVICE_COUNT; i++)
+    {
+        Serial.printf("%-8s %8lu %8lu %12llu %10lu %7lu %7lu\n", deviceName(static_cast<BusDevice>(i)),
+                      static_cast<unsigned long>(configs[i].clockHz), static_cast<unsigned long>(stats.transactions[i]),
+                      stats.busyUs[i] / 1000, static_cast<unsigned long>(stats.maxUs[i]),
+                      static_cast<unsigned long>(stats.errors[i]), static_cast<unsigned long>(stats.retries[i]));
+    }
+}
+
+const char *I2CBus::deviceName(BusDevice device)
+{
+    switch (device)
+    {
+    case BusDevice::SCD41:
+        return "SCD41";
+    case BusDevice::DISPLAY:
+        return "display";
+    default:
+        return "none";
+    }
+}
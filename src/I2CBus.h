@@ -0,0 +1,85 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <Wire.h>
+#include "Arduino.h"
+
+enum class BusDevice : uint8_t
+{
+    SCD41,
+    DISPLAY,
+    COUNT
+};
+
+struct BusDeviceConfig
+{
+    uint32_t clockHz;
+    uint32_t spacingUs; // From the end of one transaction to the start of the next on the same device
+    uint8_t retries;    // Extra attempts after a failed transaction
+};
+
+/**
+ * @brief The I2C bus shared by the SCD41 and the display.
+ *
+ * Every transaction goes through acquire() and release(), or run(). Before a
+ * transaction the bus is switched to the clock of its device, and the device
+ * gets the spacing it needs since its previous transaction. Only one
+ * transaction is open at a time; all bus access happens in the Arduino task,
+ * so a nested acquire() is a bug and refused. Transaction count, bus time,
+ * errors and retries are kept per device in RTC memory since power-on.
+ */
+class I2CBus
+{
+private:
+    TwoWire &wire;
+    int sda;
+    int scl;
+    BusDeviceConfig configs[static_cast<size_t>(BusDevice::COUNT)] = {};
+    uint32_t lastEndUs[static_cast<size_t>(BusDevice::COUNT)] = {};
+    bool used[static_cast<size_t>(BusDevice::COUNT)] = {};
+    uint32_t clockHz = 0;
+    bool open = false;
+    BusDevice owner = BusDevice::COUNT;
+    uint32_t startUs = 0;
+
+    static const char *deviceName(BusDevice device);
+
+public:
+    I2CBus(TwoWire &wire, int sda, int scl);
+
+    void configure(BusDevice device, const BusDeviceConfig &config);
+    uint32_t deviceClockHz(BusDevice device) const;
+    bool begin();
+
+    bool acquire(BusDevice device);
+    void release(BusDevice device, bool failed = false);
+
+    /**
+     * @brief One transaction, retried as configured for the device.
+     *
+     * @param operation returns 0 on success, like the Sensirion driver calls.
+     * @return the error of the last attempt, 0 on success.
+     */
+    template <typename Operation>
+    int16_t run(BusDevice device, Operation operation)
+    {
+        if (!acquire(device))
+            return -1;
+
+        int16_t error = operation();
+        for (uint8_t attempt = 0; error != 0 && attempt < configs[static_cast<size_t>(device)].retries; attempt++)
+        {
+            recordRetry(device);
+            delayMicroseconds(configs[static_cast<size_t>(device)].spacingUs);
+            error = operation();
+        }
+
+        release(device, error != 0);
+        return error;
+    }
+
+    void recordRetry(BusDevice device);
+    void printStats();
+};
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef MEASUREMENT_KIND_H
+#define MEASUREMENT_KIND_H
+
+#include <stdint.h>
+
+// SCD41 single shot flavours. Zero is the full shot, so zeroed RTC memory starts with one.
+enum class MeasurementKind : uint8_t
+{
+    CO2,     // measure_single_shot: CO2, temperature and humidity in about 5 s
+    RHT_ONLY // measure_single_shot_rht_only: temperature and humidity in about 50 ms, CO2 reads 0
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "PowerGovernor.h"
+#include "rtc.h"
+
+// Extra charge needed to move back to a fuller tier
+#define TIER_HYSTERESIS_PERCENT 3
+
+struct GovernorState
+{
+    bool valid;
+    uint8_t tier;
+    bool changeReported;
+};
+
+RTC_DATA_ATTR static GovernorState state = {};
+
+PowerGovernor::PowerGovernor(PowerManager &powerManager, const PowerPolicy *policies, size_t policyCount)
+    : powerManager(powerManager), policies(policies), policyCount(policyCount)
+{
+}
+
+bool PowerGovernor::update()
+{
+    uint8_t percent = powerManager.readBatteryPercentage();
+
+    size_t target = 0;
+    while (target < policyCount - 1 && percent < policies[target].minPercent)
+    {
+        target++;
+    }
+
+    if (!state.valid)
+    {
+        // Power-on, usually a fresh battery: nothing to report unless it already starts degraded
+        state.valid = true;
+        state.tier = target;
+        state.changeReported = target == 0;
+        log_i("Battery %d%%, power tier %s", percent, policies[target].name);
+        return target != 0;
+    }
+
+    if (target < state.tier && percent < policies[target].minPercent + TIER_HYSTERESIS_PERCENT)
+    {
+        target = state.tier;
+    }
+    if (target == state.tier)
+    {
+        return false;
+    }
+
+    log_w("Battery %d%%, power tier %s -> %s", percent, policies[state.tier].name, policies[target].name);
+    state.tier = target;
+    state.changeReported = false;
+    return true;
+}
+
+const PowerPolicy &PowerGovernor::policy() const
+{
+    return policies[state.tier < policyCount ? state.tier : 0];
+}
+
+uint8_t PowerGovernor::tier() const
+{
+    return state.tier;
+}
+
+uint32_t PowerGovernor::samplingIntervalSeconds(uint32_t intervalSeconds) const
+{
+    return static_cast<uint32_t>(intervalSeconds * policy().intervalScale);
+}
+
+float PowerGovernor::reportingScale() const
+{
+    return policy().reportingScale;
+}
+
+uint32_t PowerGovernor::rhtIntervalSeconds() const
+{
+    return policy().rhtIntervalSeconds;
+}
+
+uint32_t PowerGovernor::displayTimeoutSeconds() const
+{
+    return policy().displayTimeoutSeconds;
+}
+
+bool PowerGovernor::radioAllowed() const
+{
+    return policy().radio || !state.changeReported;
+}
+
+bool PowerGovernor::tierChangePending() const
+{
+    return !state.changeReported;
+}
+
+void PowerGovernor::tierChangeReported()
+{
+    state.changeReported = true;
+}
@@ -0,0 +1,63 @@
+#ifndef POWER_GOVERNOR_H
+#define POWER_GOVERNOR_H
+
+#include "Arduino.h"
+#include "PowerManager.h"
+
+/**
+ * @brief What a wake cycle may spend in one battery tier.
+ */
+struct PowerPolicy
+{
+    const char *name;
+    uint8_t minPercent;             // tier applies from this state of charge upwards
+    float intervalScale;            // CO2 sampling interval multiplier
+    float reportingScale;           // reporting threshold multiplier
+    uint32_t rhtIntervalSeconds;    // 0 for CO2 shots only
+    uint32_t displayTimeoutSeconds;
+    bool radio;                     // false: buffer samples locally, no Zigbee
+};
+
+/**
+ * @brief Picks the power policy tier from the battery state of charge.
+ *
+ * The policies are ordered from full to empty; the last one applies below all
+ * others. Moving to a fuller tier needs a few percent more than its threshold,
+ * so the tier does not flap on a noisy reading. The tier and whether its
+ * change has been reported over Zigbee are kept in RTC memory.
+ */
+class PowerGovernor
+{
+private:
+    PowerManager &powerManager;
+    const PowerPolicy *policies;
+    size_t policyCount;
+
+public:
+    PowerGovernor(PowerManager &powerManager, const PowerPolicy *policies, size_t policyCount);
+
+    /**
+     * @brief Read the battery state and move to the matching tier.
+     *
+     * @return true if the tier changed.
+     */
+    bool update();
+
+    const PowerPolicy &policy() const;
+    uint8_t tier() const;
+
+    uint32_t samplingIntervalSeconds(uint32_t intervalSeconds) const;
+    float reportingScale() const;
+    uint32_t rhtIntervalSeconds() const;
+    uint32_t displayTimeoutSeconds() const;
+
+    /**
+     * @brief Whether the radio may be used: always in tiers with radio, and
+     * once more after entering a radio-silent tier to report the change.
+     */
+    bool radioAllowed() const;
+    bool tierChangePending() const;
+    void tierChangeReported();
+};
+
+#endif
@@ -1,70 +1,140 @@
 #include "PowerManager.h"
+#include "Trace.h"
 #include "rtc.h"
+#include "driver/gpio.h"
 #include <algorithm>
 
+// Bus-bound work at the crystal clock, the Zigbee stack and its crypto at the top
+static const ClockLevel PHASE_CLOCKS[] = {
+  ClockLevel::NORMAL, // BOOT
+  ClockLevel::MIN,    // SENSOR_INIT
+  ClockLevel::MIN,    // MEASURE
+  ClockLevel::MIN,    // BATTERY
+  ClockLevel::MAX,    // RADIO_CONNECT
+  ClockLevel::MAX,    // REPORT
+  ClockLevel::MIN,    // DISPLAY
+  ClockLevel::MIN,    // DEEP_SLEEP
+};
+static_assert(sizeof(PHASE_CLOCKS) / sizeof(PHASE_CLOCKS[0]) == static_cast<size_t>(EnergyPhase::COUNT),
+              "one clock level per energy phase");
+
 PowerManager::PowerManager(uint8_t batPin) : PowerManager(batPin, 0)
 {
 }
 
 PowerManager::PowerManager(uint8_t batPin, uint8_t btnPin)
-    : batteryPin(batPin), buttonPin(btnPin), voltageDividerRatio(2.0f),
-      minVoltage(3.55f), maxVoltage(3.90f)
+    : batteryPin(batPin), buttonPin(btnPin), batterySampler(batPin, BATTERY_SAMPLE_MAX_AGE_SECONDS),
+      batteryEstimator(BATTERY_CAPACITY_MAH, BATTERY_INTERNAL_RESISTANCE_OHM),
+      // 2x 10MΩ divider
+      voltageDividerRatio(2.0f), wakeScheduler(MIN_SLEEP_MS)
 {
 }
 
-uint8_t PowerManager::readBatteryPercentage()
+uint8_t PowerManager::readBatteryPercentage(bool fresh)
 {
-  float voltage = readBatteryVoltage();
-
-  // linear mapping from voltage range to 0-100%
-  float percentage = ((voltage - minVoltage) / (maxVoltage - minVoltage)) * 100.0f;
-
-  log_i("Battery voltage: %.4f V, Battery percentage: %.1f %%", voltage, percentage);
-  return static_cast<uint8_t>(constrain(percentage, 0.0f, 100.0f));
+  float voltage = readBatteryVoltage(fresh);
+  float percentage = batteryEstimator.update(voltage, energyMonitor.currentLoadMa(),
+                                             energyMonitor.totalChargeMah(), getCurrentTimeMicros());
+  return static_cast<uint8_t>(lroundf(percentage));
 }
 
-float PowerManager::readBatteryVoltage()
+float PowerManager::readBatteryVoltage(bool fresh)
 {
-  pinMode(batteryPin, INPUT);
-  std::vector<uint32_t> voltageReadings;
-  voltageReadings.reserve(31);
-
-  // Take multiple samples for better accuracy
-  for (int i = 0; i < 31; i++)
-  {
-    voltageReadings.push_back(analogReadMilliVolts(batteryPin));
-  }
-
-  // calculate median
-  std::sort(voltageReadings.begin(), voltageReadings.end());
-  float medianVoltage = static_cast<float>(voltageReadings[voltageReadings.size() / 2]);
+  // Median of a burst of samples for better accuracy
+  float medianVoltage = static_cast<float>(batterySampler.readMilliVolts(fresh));
 
   // Adjust for voltage divider
   medianVoltage = voltageDividerRatio * medianVoltage / 1000.0f;
   return medianVoltage;
 }
 
-void PowerManager::goToSleep(uint64_t wakeupTimeSeconds)
+void PowerManager::goToSleepUntil(uint64_t nextWakeupMicros)
 {
-  goToSleepUntil(wakeupTimeSeconds * US_TO_S_FACTOR);
+  trace(TraceEvent::DEEP_SLEEP, static_cast<int32_t>(nextWakeupMicros / US_TO_S_FACTOR));
+
+  enableButtonWakeup();
+
+  energyMonitor.endCycle(nextWakeupMicros);
+  energyMonitor.traceCycle();
+  if (Serial)
+  {
+    energyMonitor.printReport();
+    Serial.flush();
+  }
+
+  esp_sleep_enable_timer_wakeup(nextWakeupMicros);
+  wakeScheduler.sleeping(getCurrentTimeMicros(), nextWakeupMicros);
+
+  esp_deep_sleep_start();
 }
 
-void PowerManager::goToSleepUntil(uint64_t nextWakeupMicros)
+void PowerManager::forceSleepUntil(uint64_t nextWakeupMicros)
 {
-  log_i("Going to sleep for %llu seconds...", nextWakeupMicros / US_TO_S_FACTOR);
-
   enableButtonWakeup();
+  energyMonitor.endCycle(nextWakeupMicros);
 
   esp_sleep_enable_timer_wakeup(nextWakeupMicros);
+  wakeScheduler.sleeping(getCurrentTimeMicros(), nextWakeupMicros);
 
   esp_deep_sleep_start();
 }
 
-void PowerManager::lightSleep(uint64_t sleepTimeSeconds)
+void PowerManager::setLightSleepDeadline(uint64_t rtcMicros)
+{
+  lightSleepDeadlineUs = rtcMicros;
+}
+
+// Rounded up, so that a sleep of this length ends at or after the deadline
+uint64_t PowerManager::msUntilDeadline()
+{
+  uint64_t now = getCurrentTimeMicros();
+  return lightSleepDeadlineUs > now ? (lightSleepDeadlineUs - now + 999) / 1000 : 0;
+}
+
+void PowerManager::lightSleepMs(uint64_t sleepTimeMs)
+{
+  if (lightSleepDeadlineUs != 0)
+    sleepTimeMs = std::min(sleepTimeMs, msUntilDeadline());
+  if (sleepTimeMs == 0)
+    return;
+
+  esp_sleep_enable_timer_wakeup(sleepTimeMs * 1000);
+  energyMonitor.beginLightSleep();
+  cpuClock.beginLightSleep();
+  esp_light_sleep_start();
+  cpuClock.endLightSleep();
+  energyMonitor.endLightSleep();
+}
+
+bool PowerManager::lightSleepUntilPin(uint8_t pin, uint8_t level, uint64_t timeoutMs)
 {
-  log_i("Light sleep for %llu seconds...", sleepTimeSeconds);
-  esp_sleep_enable_timer_wakeup(sleepTimeSeconds * US_TO_S_FACTOR);
+  if (lightSleepDeadlineUs != 0)
+  {
+    uint64_t leftMs = msUntilDeadline();
+    if (leftMs == 0)
+      return false;
+    timeoutMs = timeoutMs > 0 ? std::min(timeoutMs, leftMs) : leftMs;
+  }
+
+  gpio_num_t gpio = static_cast<gpio_num_t>(pin);
+  gpio_wakeup_enable(gpio, level == HIGH ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  if (timeoutMs > 0)
+    esp_sleep_enable_timer_wakeup(timeoutMs * 1000);
+  else
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+
+  energyMonitor.beginLightSleep();
+  cpuClock.beginLightSleep();
   esp_light_sleep_start();
+  cpuClock.endLightSleep();
+  energyMonitor.endLightSleep();
+  bool reached = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO;
+
+  // Later light sleeps must not end on the pin
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+  gpio_wakeup_disable(gpio);
+  return reached;
 }
 
 WakeupReason PowerManager::getWakeupReason(bool displayOn)
@@ -92,19 +162,44 @@ uint64_t PowerManager::getCurrentTimeMicros()
   return esp_rtc_get_time_us();
 }
 
-uint64_t PowerManager::calculateNextWakeup(uint64_t intervalSeconds, uint64_t lastMeasurementTime)
+uint64_t PowerManager::timeUntilDue(uint64_t intervalSeconds, uint64_t lastMeasurementTime)
 {
   uint64_t currentTime = getCurrentTimeMicros();
   uint64_t timeSinceLastMeasurement = (lastMeasurementTime == 0) ? 0 : (currentTime - lastMeasurementTime);
 
   uint64_t intervalMicros = intervalSeconds * US_TO_S_FACTOR;
-  uint64_t nextWakeup = std::clamp(intervalMicros - timeSinceLastMeasurement,
-                                   1000000ULL, intervalMicros);
+  uint64_t minMicros = MIN_SLEEP_MS * 1000ULL;
+  if (timeSinceLastMeasurement + minMicros >= intervalMicros)
+    return minMicros;
+  return intervalMicros - timeSinceLastMeasurement;
+}
 
-  log_i("Time since previous measurement: %llu s", timeSinceLastMeasurement / US_TO_S_FACTOR);
-  log_i("Next wakeup in: %llu s", nextWakeup / US_TO_S_FACTOR);
+uint64_t PowerManager::calculateNextWakeup(uint64_t co2IntervalSeconds, uint64_t lastCO2Time,
+                                           uint64_t rhtIntervalSeconds, uint64_t lastRHTTime, bool coldSensor,
+                                           MeasurementKind &kind)
+{
+  uint64_t co2Due =
+      wakeScheduler.sleepFor(wakeScheduler.untilDue(getCurrentTimeMicros(), co2IntervalSeconds), coldSensor);
+  kind = MeasurementKind::CO2;
+  if (rhtIntervalSeconds == 0)
+  {
+    trace(TraceEvent::NEXT_WAKEUP_CO2, static_cast<int32_t>(co2Due / US_TO_S_FACTOR));
+    return co2Due;
+  }
 
-  return nextWakeup;
+  // A CO2 shot measures temperature and humidity as well
+  uint64_t rhtDue = timeUntilDue(rhtIntervalSeconds, std::max(lastRHTTime, lastCO2Time));
+  // No RHT-only wake in the last half interval before a CO2 shot
+  if (rhtDue + rhtIntervalSeconds * US_TO_S_FACTOR / 2 < co2Due)
+  {
+    kind = MeasurementKind::RHT_ONLY;
+    trace(TraceEvent::NEXT_WAKEUP_RHT, static_cast<int32_t>(rhtDue / US_TO_S_FACTOR),
+          static_cast<int32_t>(co2Due / US_TO_S_FACTOR));
+    return rhtDue;
+  }
+
+  trace(TraceEvent::NEXT_WAKEUP_CO2, static_cast<int32_t>(co2Due / US_TO_S_FACTOR));
+  return co2Due;
 }
 
 void PowerManager::enableButtonWakeup()
@@ -120,3 +215,29 @@ void PowerManager::disableButtonWakeup()
 {
   esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_EXT1);
 }
+
+
+void PowerManager::beginPhase(EnergyPhase phase)
+{
+  energyMonitor.beginPhase(phase);
+
+  // The receiver stays up from here until the deep sleep, an automatic light sleep would stop it
+  if (phase == EnergyPhase::RADIO_CONNECT)
+    cpuClock.holdAwake();
+  cpuClock.setCeiling(PHASE_CLOCKS[static_cast<size_t>(phase)]);
+}
+
+EnergyMonitor &PowerManager::getEnergyMonitor()
+{
+  return energyMonitor;
+}
+
+CpuClock &PowerManager::getCpuClock()
+{
+  return cpuClock;
+}
+
+WakeScheduler &PowerManager::getWakeScheduler()
+{
+  return wakeScheduler;
+}
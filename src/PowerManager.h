@@ -4,6 +4,24 @@
 #include <esp_sleep.h>
 #include "Arduino.h"
 #include "driver/rtc_io.h"
+#include "EnergyMonitor.h"
+#include "CpuClock.h"
+#include "WakeScheduler.h"
+#include "MeasurementKind.h"
+#include "BatterySampler.h"
+#include "BatteryEstimator.h"
+
+#ifndef BATTERY_SAMPLE_MAX_AGE_SECONDS
+#define BATTERY_SAMPLE_MAX_AGE_SECONDS 3600 // The cell voltage moves over days, not minutes
+#endif
+
+#ifndef MIN_SLEEP_MS
+#define MIN_SLEEP_MS 1000 // Shortest deep sleep, however late the next measurement is
+#endif
+
+#ifndef BATTERY_INTERNAL_RESISTANCE_OHM
+#define BATTERY_INTERNAL_RESISTANCE_OHM 0.15f
+#endif
 
 enum class WakeupReason {
     POWER_ON,
@@ -17,10 +35,15 @@ class PowerManager {
 private:
     uint8_t batteryPin;
     uint8_t buttonPin;
+    BatterySampler batterySampler;
+    BatteryEstimator batteryEstimator;
     float voltageDividerRatio;
-    float minVoltage;
-    float maxVoltage;
+    EnergyMonitor energyMonitor;
+    CpuClock cpuClock;
+    WakeScheduler wakeScheduler;
+    uint64_t lightSleepDeadlineUs = 0;
     
+    uint64_t msUntilDeadline();
     static const uint64_t US_TO_S_FACTOR = 1000000ULL;
 
 public:
@@ -28,22 +51,42 @@ public:
     PowerManager(uint8_t batPin, uint8_t btnPin);
     
     // Battery management
-    uint8_t readBatteryPercentage();
-    float readBatteryVoltage();
+    // Reuse a reading younger than BATTERY_SAMPLE_MAX_AGE_SECONDS unless fresh is set
+    uint8_t readBatteryPercentage(bool fresh = false);
+    float readBatteryVoltage(bool fresh = false);
     
     // Sleep management
-    void goToSleep(uint64_t wakeupTimeSeconds);
     void goToSleepUntil(uint64_t nextWakeupMicros);
-    void lightSleep(uint64_t sleepTimeSeconds);
+    // The same from the esp_timer task, for a cycle cut short: writes RTC memory only, no trace or Serial
+    void forceSleepUntil(uint64_t nextWakeupMicros);
+    void lightSleepMs(uint64_t sleepTimeMs);
+    // Light sleep until the pin is at the given level, or timeoutMs passed (0 for no timeout).
+    // Returns true when woken by the pin; returns at once if the pin already is at that level.
+    bool lightSleepUntilPin(uint8_t pin, uint8_t level, uint64_t timeoutMs);
+    // Light sleeps end by this RTC time, so that a timer due then can run; 0 for no limit
+    void setLightSleepDeadline(uint64_t rtcMicros);
     WakeupReason getWakeupReason(bool displayOn);
     
     // Timing utilities
     uint64_t getCurrentTimeMicros();
-    uint64_t calculateNextWakeup(uint64_t intervalSeconds, uint64_t lastMeasurementTime);
+    // Mixed schedule: CO2 shots on the grid of the wake scheduler every co2IntervalSeconds and RHT-only
+    // shots every rhtIntervalSeconds in between. coldSensor: the next CO2 shot needs a discarded shot first.
+    // Returns the sleep time and sets kind to the measurement due at that wakeup.
+    uint64_t calculateNextWakeup(uint64_t co2IntervalSeconds, uint64_t lastCO2Time,
+                                 uint64_t rhtIntervalSeconds, uint64_t lastRHTTime, bool coldSensor,
+                                 MeasurementKind &kind);
+    // At least MIN_SLEEP_MS, also when overdue
+    uint64_t timeUntilDue(uint64_t intervalSeconds, uint64_t lastMeasurementTime);
+    WakeScheduler &getWakeScheduler();
     
     // Power optimization
     void enableButtonWakeup();
     void disableButtonWakeup();
+
+    // Energy accounting; each phase also sets the CPU clock ceiling
+    void beginPhase(EnergyPhase phase);
+    EnergyMonitor &getEnergyMonitor();
+    CpuClock &getCpuClock();
 };
 
 #endif
@@ -0,0 +1,50 @@
+#include "RadioBackoff.h"
+#include "Trace.h"
+#include <algorithm>
+
+struct BackoffState
+{
+    uint32_t failures;
+    uint64_t nextAttemptUs;
+};
+
+RTC_DATA_ATTR static BackoffState state = {};
+
+RadioBackoff::RadioBackoff(uint32_t baseSeconds, uint32_t maxSeconds)
+    : baseSeconds(baseSeconds), maxSeconds(maxSeconds)
+{
+}
+
+bool RadioBackoff::attemptAllowed(uint64_t timeMicros) const
+{
+    return state.failures == 0 || timeMicros >= state.nextAttemptUs;
+}
+
+void RadioBackoff::recordFailure(uint64_t timeMicros)
+{
+    state.failures++;
+
+    uint64_t waitSeconds = maxSeconds;
+    if (state.failures <= 32)
+        waitSeconds = std::min<uint64_t>(static_cast<uint64_t>(baseSeconds) << (state.failures - 1), maxSeconds);
+    state.nextAttemptUs = timeMicros + waitSeconds * 1000000ULL;
+}
+
+void RadioBackoff::recordSuccess()
+{
+    if (state.failures > 0)
+        trace(TraceEvent::RADIO_BACK, static_cast<int32_t>(state.failures));
+
+    state.failures = 0;
+    state.nextAttemptUs = 0;
+}
+
+uint32_t RadioBackoff::consecutiveFailures() const
+{
+    return state.failures;
+}
+
+uint64_t RadioBackoff::nextAttemptMicros() const
+{
+    return state.nextAttemptUs;
+}
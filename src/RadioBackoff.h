@@ -0,0 +1,36 @@
+#ifndef RADIO_BACKOFF_H
+#define RADIO_BACKOFF_H
+
+#include "Arduino.h"
+
+/**
+ * @brief Exponential backoff between radio attempts after failed connects.
+ *
+ * Each consecutive failure doubles the wait before the next attempt, from
+ * baseSeconds up to maxSeconds. A successful connect resets it. State is kept
+ * in RTC memory so the backoff spans deep sleep; sampling is not affected.
+ */
+class RadioBackoff
+{
+private:
+    uint32_t baseSeconds;
+    uint32_t maxSeconds;
+
+public:
+    RadioBackoff(uint32_t baseSeconds, uint32_t maxSeconds);
+
+    /**
+     * @param timeMicros RTC time.
+     * @return false while backing off.
+     */
+    bool attemptAllowed(uint64_t timeMicros) const;
+
+    // Only writes RTC memory, so a forced sleep may call it from the esp_timer task
+    void recordFailure(uint64_t timeMicros);
+    void recordSuccess();
+
+    uint32_t consecutiveFailures() const;
+    uint64_t nextAttemptMicros() const;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#include "ReportingPolicy.h"
+#include "Trace.h"
+#include <algorithm>
+
+// Linear extrapolation overshoots once ventilation takes over, so the
+// predictor holds its value after this long
+static const float PREDICTION_HORIZON_SECONDS = 3600.0f;
+
+struct ReportedState
+{
+    bool valid;
+    uint16_t co2;
+    uint64_t timeUs;
+    float slopePpmPerSecond;
+};
+
+RTC_DATA_ATTR static ReportedState state = {};
+
+void ReportingPolicy::reported(uint16_t co2, uint64_t timeMicros)
+{
+    if (state.valid && timeMicros > state.timeUs)
+    {
+        float elapsedSeconds = (timeMicros - state.timeUs) / 1000000.0f;
+        state.slopePpmPerSecond = (static_cast<float>(co2) - static_cast<float>(state.co2)) / elapsedSeconds;
+    }
+    else
+    {
+        state.slopePpmPerSecond = 0.0f;
+    }
+
+    state.valid = true;
+    state.co2 = co2;
+    state.timeUs = timeMicros;
+}
+
+float ReportingPolicy::predictedCO2(uint64_t timeMicros) const
+{
+    if (!state.valid || timeMicros <= state.timeUs)
+        return state.co2;
+
+    float elapsedSeconds = std::min((timeMicros - state.timeUs) / 1000000.0f, PREDICTION_HORIZON_SECONDS);
+    float predicted = state.co2 + state.slopePpmPerSecond * elapsedSeconds;
+    return predicted > 0.0f ? predicted : 0.0f;
+}
+
+bool ReportingPolicy::hasReported() const
+{
+    return state.valid;
+}
+
+uint16_t ReportingPolicy::lastReportedCO2() const
+{
+    return state.co2;
+}
+
+DeltaReportingPolicy::DeltaReportingPolicy(uint16_t deltaPpm) : ReportingPolicy(deltaPpm)
+{
+}
+
+bool DeltaReportingPolicy::shouldReport(uint16_t co2, uint64_t) const
+{
+    if (!hasReported())
+        return true;
+
+    int difference = abs(co2 - lastReportedCO2());
+    int delta = static_cast<int>(thresholdPpm * thresholdScale);
+    if (difference >= delta)
+    {
+        trace(TraceEvent::REPORT_DELTA_REACHED, difference, delta);
+        return true;
+    }
+
+    trace(TraceEvent::REPORT_DELTA_BELOW, difference, delta);
+    return false;
+}
+
+PredictiveReportingPolicy::PredictiveReportingPolicy(uint16_t bandPpm, uint16_t holdLimitPpm)
+    : ReportingPolicy(bandPpm), holdLimitPpm(holdLimitPpm)
+{
+}
+
+bool PredictiveReportingPolicy::shouldReport(uint16_t co2, uint64_t timeMicros) const
+{
+    if (!hasReported())
+        return true;
+
+    float predicted = predictedCO2(timeMicros);
+    float error = fabsf(co2 - predicted);
+    int band = static_cast<int>(thresholdPpm * thresholdScale);
+    if (error >= band)
+    {
+        trace(TraceEvent::REPORT_BAND_LEFT, co2, lroundf(predicted));
+        return true;
+    }
+
+    int difference = abs(co2 - lastReportedCO2());
+    int holdLimit = static_cast<int>(holdLimitPpm * thresholdScale);
+    if (holdLimit > 0 && difference >= holdLimit)
+    {
+        trace(TraceEvent::REPORT_HOLD_LIMIT_REACHED, difference, holdLimit);
+        return true;
+    }
+
+    trace(TraceEvent::REPORT_BAND_WITHIN, co2, lroundf(predicted));
+    return false;
+}
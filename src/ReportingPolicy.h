@@ -0,0 +1,93 @@
+#ifndef REPORTING_POLICY_H
+#define REPORTING_POLICY_H
+
+#include "Arduino.h"
+
+/**
+ * @brief Decides whether a CO2 reading has to reach the Zigbee consumer now.
+ *
+ * The last reading the consumer received is kept in RTC memory and shared by
+ * all policies, so switching policy needs no migration. A reading that does
+ * not have to be reported stays in the sample buffer until the next upload.
+ */
+class ReportingPolicy
+{
+protected:
+    uint16_t thresholdPpm;
+    float thresholdScale = 1.0f;
+
+public:
+    explicit ReportingPolicy(uint16_t thresholdPpm) : thresholdPpm(thresholdPpm) {}
+    virtual ~ReportingPolicy() {}
+
+    /**
+     * @brief Check a new reading against what the consumer currently knows.
+     *
+     * @param co2 reading in ppm.
+     * @param timeMicros RTC time of the reading.
+     * @return true if the reading should be uploaded without waiting.
+     */
+    virtual bool shouldReport(uint16_t co2, uint64_t timeMicros) const = 0;
+
+    /**
+     * @brief Record the newest reading the consumer has received, at the
+     * time it received it.
+     */
+    void reported(uint16_t co2, uint64_t timeMicros);
+
+    /**
+     * @brief Value the consumer's predictor holds at timeMicros: the last
+     * reported reading extrapolated along the slope between the last two
+     * radio sessions, for at most an hour.
+     */
+    float predictedCO2(uint64_t timeMicros) const;
+
+    bool hasReported() const;
+    uint16_t lastReportedCO2() const;
+
+    /**
+     * @brief Set the policy's threshold in ppm, the delta or the band.
+     */
+    void setThreshold(uint16_t ppm) { thresholdPpm = ppm; }
+
+    /**
+     * @brief Widen (or narrow) the policy's threshold, e.g. to save battery.
+     */
+    void setThresholdScale(float scale) { thresholdScale = scale; }
+};
+
+/**
+ * @brief Reports when the reading moved deltaPpm away from the last report.
+ */
+class DeltaReportingPolicy : public ReportingPolicy
+{
+public:
+    explicit DeltaReportingPolicy(uint16_t deltaPpm);
+
+    bool shouldReport(uint16_t co2, uint64_t timeMicros) const override;
+};
+
+/**
+ * @brief Dead-band reporting around a last value plus slope predictor.
+ *
+ * The device and the consumer run the same predictor over the reported
+ * readings. A reading is only sent when it leaves the band of bandPpm around
+ * the prediction, so a steady drift is followed without extra reports and a
+ * stable room is not reported for its noise.
+ *
+ * A consumer that holds the last value instead never sees the drift, so a
+ * reading that moved holdLimitPpm away from the last report is sent as well.
+ * 0 leaves the hold limit out, for consumers that all extrapolate.
+ */
+class PredictiveReportingPolicy : public ReportingPolicy
+{
+private:
+    uint16_t holdLimitPpm;
+
+public:
+    PredictiveReportingPolicy(uint16_t bandPpm, uint16_t holdLimitPpm);
+
+    bool shouldReport(uint16_t co2, uint64_t timeMicros) const override;
+};
+
+#endif
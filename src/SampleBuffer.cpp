@@ -0,0 +1,34 @@
+#include "SampleBuffer.h"
+
+void SampleBuffer::push(const Sample &sample)
+{
+    if (full())
+    {
+        // Overwrite the oldest sample
+        samples[head] = sample;
+        head = (head + 1) % SAMPLE_BUFFER_CAPACITY;
+        dropped++;
+        return;
+    }
+
+    samples[(head + count) % SAMPLE_BUFFER_CAPACITY] = sample;
+    count++;
+}
+
+const Sample &SampleBuffer::at(size_t index) const
+{
+    return samples[(head + index) % SAMPLE_BUFFER_CAPACITY];
+}
+
+const Sample &SampleBuffer::newest() const
+{
+    return at(count - 1);
+}
+
+void SampleBuffer::removeOldest()
+{
+    if (count == 0)
+        return;
+    head = (head + 1) % SAMPLE_BUFFER_CAPACITY;
+    count--;
+}
@@ -0,0 +1,46 @@
+#ifndef SAMPLE_BUFFER_H
+#define SAMPLE_BUFFER_H
+
+#include "Arduino.h"
+
+#ifndef SAMPLE_BUFFER_CAPACITY
+#define SAMPLE_BUFFER_CAPACITY 384 // Two days of samples waiting for an upload, about 4.6 KB of RTC memory
+#endif
+
+struct Sample
+{
+    uint32_t timeSeconds;        // RTC time since power-on
+    uint16_t co2;                // ppm
+    int16_t temperatureCenti;    // 0.01 °C
+    uint16_t humidityCenti;      // 0.01 %RH
+    uint8_t batteryPercentage;
+};
+
+/**
+ * @brief Fixed-size ring of samples, meant to live in RTC memory.
+ *
+ * The class has no constructor so an RTC_DATA_ATTR instance is only
+ * zero-initialized at power-on and keeps its contents across deep sleep.
+ * When full, the oldest sample is overwritten.
+ */
+class SampleBuffer
+{
+private:
+    Sample samples[SAMPLE_BUFFER_CAPACITY];
+    uint16_t head;  // index of the oldest sample
+    uint16_t count;
+    uint32_t dropped;
+
+public:
+    void push(const Sample &sample);
+    const Sample &at(size_t index) const; // 0 is the oldest sample
+    const Sample &newest() const;
+    void removeOldest();
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == SAMPLE_BUFFER_CAPACITY; }
+    uint32_t droppedCount() const { return dropped; }
+};
+
+#endif
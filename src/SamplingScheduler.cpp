@@ -0,0 +1,89 @@
+#include "SamplingScheduler.h"
+#include "Trace.h"
+#include <algorithm>
+
+// Time the average interval is smoothed over; a week spans the weekday/weekend occupancy pattern
+static const float AVERAGE_WINDOW_SECONDS = 7 * 24 * 3600.0f;
+// Weight of the newest rate estimate
+static const float RATE_SMOOTHING = 0.5f;
+
+struct SchedulerState
+{
+    bool primed;
+    uint16_t lastCO2;
+    uint64_t lastTimeUs;
+    float ratePpmPerMinute;
+    uint32_t intervalSeconds;
+    float windowSeconds; // time and sample count, both decayed over AVERAGE_WINDOW_SECONDS
+    float windowSamples;
+};
+
+RTC_DATA_ATTR static SchedulerState state = {};
+
+SamplingScheduler::SamplingScheduler(uint32_t nominalSeconds, uint32_t minSeconds, uint32_t maxSeconds,
+                                     uint16_t targetChangePpm, uint16_t noisePpm)
+    : nominalSeconds(nominalSeconds), minSeconds(minSeconds), maxSeconds(maxSeconds),
+      targetChangePpm(targetChangePpm), noisePpm(noisePpm)
+{
+}
+
+void SamplingScheduler::update(uint16_t co2, uint64_t timeMicros)
+{
+    if (!state.primed || timeMicros <= state.lastTimeUs)
+    {
+        state.primed = true;
+        state.lastCO2 = co2;
+        state.lastTimeUs = timeMicros;
+        return;
+    }
+
+    float elapsedSeconds = (timeMicros - state.lastTimeUs) / 1000000.0f;
+    float change = fabsf(static_cast<float>(co2) - static_cast<float>(state.lastCO2));
+    change = change > noisePpm ? change - noisePpm : 0.0f;
+
+    float rate = change * 60.0f / elapsedSeconds;
+    state.ratePpmPerMinute = RATE_SMOOTHING * rate + (1.0f - RATE_SMOOTHING) * state.ratePpmPerMinute;
+
+    if (state.windowSamples == 0.0f)
+    {
+        // Start from a day at the nominal interval
+        state.windowSeconds = 24 * 3600.0f;
+        state.windowSamples = state.windowSeconds / nominalSeconds;
+    }
+    float decay = 1.0f - std::min(elapsedSeconds / AVERAGE_WINDOW_SECONDS, 1.0f);
+    state.windowSeconds = state.windowSeconds * decay + elapsedSeconds;
+    state.windowSamples = state.windowSamples * decay + 1.0f;
+
+    uint32_t current = intervalSeconds();
+    uint32_t target = maxSeconds;
+    if (state.ratePpmPerMinute > 0.0f)
+        target = static_cast<uint32_t>(std::min(targetChangePpm * 60.0f / state.ratePpmPerMinute,
+                                                static_cast<float>(maxSeconds)));
+
+    state.intervalSeconds = std::clamp(target, minSeconds, std::min(maxSeconds, current * 2));
+    state.lastCO2 = co2;
+    state.lastTimeUs = timeMicros;
+
+    trace(TraceEvent::SAMPLING_INTERVAL, traceCenti(state.ratePpmPerMinute),
+          static_cast<int32_t>(state.intervalSeconds));
+}
+
+void SamplingScheduler::setNominalInterval(uint32_t seconds)
+{
+    nominalSeconds = seconds;
+}
+
+uint32_t SamplingScheduler::intervalSeconds() const
+{
+    return state.intervalSeconds ? state.intervalSeconds : nominalSeconds;
+}
+
+uint32_t SamplingScheduler::averageIntervalSeconds() const
+{
+    return state.windowSamples > 0.0f ? static_cast<uint32_t>(state.windowSeconds / state.windowSamples) : nominalSeconds;
+}
+
+float SamplingScheduler::ratePpmPerMinute() const
+{
+    return state.ratePpmPerMinute;
+}
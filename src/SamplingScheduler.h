@@ -0,0 +1,50 @@
+#ifndef SAMPLING_SCHEDULER_H
+#define SAMPLING_SCHEDULER_H
+
+#include "Arduino.h"
+
+/**
+ * @brief Picks the next CO2 sampling interval from the recent rate of change.
+ *
+ * The interval is chosen so that consecutive samples differ by roughly
+ * targetChangePpm: short while CO2 ramps during a meeting, long while an
+ * empty room is flat. Changes within the sensor noise band count as flat.
+ * The interval may shrink immediately but at most doubles per sample.
+ * State is kept in RTC memory.
+ */
+class SamplingScheduler
+{
+private:
+    uint32_t nominalSeconds;
+    uint32_t minSeconds;
+    uint32_t maxSeconds;
+    uint16_t targetChangePpm;
+    uint16_t noisePpm;
+
+public:
+    SamplingScheduler(uint32_t nominalSeconds, uint32_t minSeconds, uint32_t maxSeconds,
+                      uint16_t targetChangePpm = 20, uint16_t noisePpm = 10);
+
+    /**
+     * @brief Feed a new CO2 reading and recompute the interval.
+     *
+     * @param co2 reading in ppm.
+     * @param timeMicros RTC time of the reading.
+     */
+    void update(uint16_t co2, uint64_t timeMicros);
+
+    // Interval before the first rate is known, and the start of the long-run average
+    void setNominalInterval(uint32_t seconds);
+
+    uint32_t intervalSeconds() const;
+
+    /**
+     * @brief Long-run average of the actual sampling interval, used to scale
+     * the SCD41 automatic self-calibration periods.
+     */
+    uint32_t averageIntervalSeconds() const;
+
+    float ratePpmPerMinute() const;
+};
+
+#endif
@@ -0,0 +1,187 @@
+#include "Settings.h"
+#include <esp_rom_crc.h>
+
+// Bump when SettingsValues changes so caches with the old layout are reloaded
+#define SETTINGS_LAYOUT_VERSION 2
+
+enum SettingsField : uint8_t
+{
+    FIELD_ZIGBEE_ENABLED = 1 << 0,
+    FIELD_ZIGBEE_CHANNEL = 1 << 1,
+    FIELD_SAMPLING_INTERVAL = 1 << 2,
+    FIELD_REPORTING_DELTA = 1 << 3,
+    FIELD_TEMPERATURE_OFFSET = 1 << 4,
+    FIELD_SCD41_FINGERPRINT = 1 << 5,
+};
+
+struct SettingsCache
+{
+    uint32_t crc;
+    uint8_t dirty; // SettingsField bits not yet written to NVS
+    SettingsValues values;
+};
+
+RTC_DATA_ATTR static SettingsCache cache = {};
+
+static uint32_t cacheCrc()
+{
+    uint32_t crc = esp_rom_crc32_le(SETTINGS_LAYOUT_VERSION, &cache.dirty, sizeof(cache.dirty));
+    return esp_rom_crc32_le(crc, reinterpret_cast<const uint8_t *>(&cache.values), sizeof(cache.values));
+}
+
+Settings::Settings(const SettingsValues &defaults) : defaults(defaults)
+{
+}
+
+SettingsValues &Settings::values()
+{
+    if (cache.crc == cacheCrc())
+        return cache.values;
+
+    // Power-on or corrupted cache: reload everything from NVS
+    SettingsValues &v = cache.values;
+    preferences.begin("zigbee", true);
+    v.zigbeeEnabled = preferences.getBool("enabled", defaults.zigbeeEnabled);
+    v.zigbeeChannel = preferences.getUChar("channel", defaults.zigbeeChannel);
+    preferences.end();
+
+    preferences.begin("sensor", true);
+    v.samplingIntervalSeconds = preferences.getUInt("interval", defaults.samplingIntervalSeconds);
+    v.reportingDeltaCO2 = preferences.getUShort("delta", defaults.reportingDeltaCO2);
+    v.temperatureOffset = preferences.getFloat("tempOffset", defaults.temperatureOffset);
+    v.scd41Fingerprint = preferences.getUInt("scd41Config", defaults.scd41Fingerprint);
+    preferences.end();
+
+    cache.dirty = 0;
+    cache.crc = cacheCrc();
+    log_d("Settings loaded from NVS");
+    return cache.values;
+}
+
+void Settings::markDirty(uint8_t field)
+{
+    cache.dirty |= field;
+    cache.crc = cacheCrc();
+}
+
+bool Settings::isZigbeeEnabled()
+{
+    return values().zigbeeEnabled;
+}
+
+void Settings::setZigbeeEnabled(bool enabled)
+{
+    if (values().zigbeeEnabled == enabled)
+        return;
+    cache.values.zigbeeEnabled = enabled;
+    markDirty(FIELD_ZIGBEE_ENABLED);
+}
+
+uint8_t Settings::getZigbeeChannel()
+{
+    return values().zigbeeChannel;
+}
+
+void Settings::setZigbeeChannel(uint8_t channel)
+{
+    if (values().zigbeeChannel == channel)
+        return;
+    cache.values.zigbeeChannel = channel;
+    markDirty(FIELD_ZIGBEE_CHANNEL);
+}
+
+uint32_t Settings::getSamplingIntervalSeconds()
+{
+    return values().samplingIntervalSeconds;
+}
+
+void Settings::setSamplingIntervalSeconds(uint32_t seconds)
+{
+    if (values().samplingIntervalSeconds == seconds)
+        return;
+    cache.values.samplingIntervalSeconds = seconds;
+    markDirty(FIELD_SAMPLING_INTERVAL);
+}
+
+uint16_t Settings::getReportingDeltaCO2()
+{
+    return values().reportingDeltaCO2;
+}
+
+void Settings::setReportingDeltaCO2(uint16_t ppm)
+{
+    if (values().reportingDeltaCO2 == ppm)
+        return;
+    cache.values.reportingDeltaCO2 = ppm;
+    markDirty(FIELD_REPORTING_DELTA);
+}
+
+float Settings::getTemperatureOffset()
+{
+    return values().temperatureOffset;
+}
+
+void Settings::setTemperatureOffset(float offset)
+{
+    if (values().temperatureOffset == offset)
+        return;
+    cache.values.temperatureOffset = offset;
+    markDirty(FIELD_TEMPERATURE_OFFSET);
+}
+
+uint32_t Settings::getScd41Fingerprint()
+{
+    return values().scd41Fingerprint;
+}
+
+void Settings::setScd41Fingerprint(uint32_t fingerprint)
+{
+    if (values().scd41Fingerprint == fingerprint)
+        return;
+    cache.values.scd41Fingerprint = fingerprint;
+    markDirty(FIELD_SCD41_FINGERPRINT);
+}
+
+bool Settings::commit()
+{
+    const SettingsValues &v = values();
+    if (cache.dirty == 0)
+        return true;
+
+    bool ok = true;
+    if (cache.dirty & (FIELD_ZIGBEE_ENABLED | FIELD_ZIGBEE_CHANNEL))
+    {
+        ok &= preferences.begin("zigbee", false);
+        if (cache.dirty & FIELD_ZIGBEE_ENABLED)
+            ok &= preferences.putBool("enabled", v.zigbeeEnabled) > 0;
+        if (cache.dirty & FIELD_ZIGBEE_CHANNEL)
+            ok &= preferences.putUChar("channel", v.zigbeeChannel) > 0;
+        preferences.end();
+    }
+
+    if (cache.dirty & (FIELD_SAMPLING_INTERVAL | FIELD_REPORTING_DELTA | FIELD_TEMPERATURE_OFFSET | FIELD_SCD41_FINGERPRINT))
+    {
+        ok &= preferences.begin("sensor", false);
+        if (cache.dirty & FIELD_SAMPLING_INTERVAL)
+            ok &= preferences.putUInt("interval", v.samplingIntervalSeconds) > 0;
+        if (cache.dirty & FIELD_REPORTING_DELTA)
+            ok &= preferences.putUShort("delta", v.reportingDeltaCO2) > 0;
+        if (cache.dirty & FIELD_TEMPERATURE_OFFSET)
+            ok &= preferences.putFloat("tempOffset", v.temperatureOffset) > 0;
+        if (cache.dirty & FIELD_SCD41_FINGERPRINT)
+            ok &= preferences.putUInt("scd41Config", v.scd41Fingerprint) > 0;
+        preferences.end();
+    }
+
+    if (!ok)
+    {
+        // Keep the fields dirty and retry at the next commit
+        log_e("Failed to write settings to NVS");
+        return false;
+    }
+
+    log_i("Settings written to NVS (fields 0x%02x)", cache.dirty);
+    cache.dirty = 0;
+    cache.crc = cacheCrc();
+    return true;
+}
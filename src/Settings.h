@@ -0,0 +1,65 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <Preferences.h>
+#include "Arduino.h"
+
+// Field order avoids padding, the CRC covers the raw bytes
+struct SettingsValues
+{
+    float temperatureOffset;           // °C, SCD41 temperature offset
+    uint32_t samplingIntervalSeconds;  // nominal CO2 sampling interval
+    uint32_t scd41Fingerprint;         // configuration persisted to the SCD41 EEPROM, 0 if unknown
+    uint16_t reportingDeltaCO2;        // ppm, the reporting policy's delta or band
+    uint8_t zigbeeChannel;             // channel of the last session, 0 if unknown
+    bool zigbeeEnabled;
+};
+
+/**
+ * @brief Typed settings cached in RTC memory in front of NVS.
+ *
+ * The values are read from NVS once per power-on and then served from RTC
+ * memory, which is validated with a CRC so a corrupted or stale layout is
+ * reloaded. Setters only touch the cache and mark the field dirty; commit()
+ * writes the changed fields back to NVS, normally right before deep sleep.
+ * All instances share the same cache.
+ */
+class Settings
+{
+private:
+    SettingsValues defaults;
+    Preferences preferences;
+
+    SettingsValues &values();
+    void markDirty(uint8_t field);
+
+public:
+    explicit Settings(const SettingsValues &defaults);
+
+    bool isZigbeeEnabled();
+    void setZigbeeEnabled(bool enabled);
+
+    uint8_t getZigbeeChannel();
+    void setZigbeeChannel(uint8_t channel);
+
+    uint32_t getSamplingIntervalSeconds();
+    void setSamplingIntervalSeconds(uint32_t seconds);
+
+    uint16_t getReportingDeltaCO2();
+    void setReportingDeltaCO2(uint16_t ppm);
+
+    float getTemperatureOffset();
+    void setTemperatureOffset(float offset);
+
+    uint32_t getScd41Fingerprint();
+    void setScd41Fingerprint(uint32_t fingerprint);
+
+    /**
+     * @brief Write fields changed since the last commit to NVS.
+     *
+     * @return true if nothing had to be written or all writes succeeded.
+     */
+    bool commit();
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "Trace.h"
+#include "rtc.h"
+
+static_assert(sizeof(TraceRecord) == 16, "the decoder reads 16-byte records");
+static_assert(static_cast<size_t>(TraceEvent::COUNT) <= UINT16_MAX, "event IDs are 16 bits");
+
+struct TraceRing
+{
+    uint16_t next;    // slot the next record goes to
+    uint16_t count;   // records not flushed yet
+    uint32_t dropped; // overwritten since the last flush
+    TraceRecord records[TRACE_CAPACITY];
+};
+
+RTC_DATA_ATTR static TraceRing ring = {};
+
+void trace(TraceEvent event, int32_t a, int32_t b)
+{
+    TraceRecord &record = ring.records[ring.next];
+    record.timeMs = static_cast<uint32_t>(esp_rtc_get_time_us() / 1000);
+    record.event = static_cast<uint16_t>(event);
+    record.reserved = 0;
+    record.a = a;
+    record.b = b;
+
+    ring.next = (ring.next + 1) % TRACE_CAPACITY;
+    if (ring.count < TRACE_CAPACITY)
+        ring.count++;
+    else
+        ring.dropped++;
+}
+
+int32_t traceCenti(float value)
+{
+    return static_cast<int32_t>(lroundf(value * 100.0f));
+}
+
+int32_t traceMilli(float value)
+{
+    return static_cast<int32_t>(lroundf(value * 1000.0f));
+}
+
+// The record bytes as they are in memory, little-endian on the ESP32-C6
+static void writeRecord(const TraceRecord &record)
+{
+    static const char DIGITS[] = "0123456789abcdef";
+    char line[sizeof(TRACE_LINE_PREFIX) + 2 * sizeof(TraceRecord)];
+    size_t length = sizeof(TRACE_LINE_PREFIX) - 1;
+    memcpy(line, TRACE_LINE_PREFIX, length);
+
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&record);
+    for (size_t i = 0; i < sizeof(TraceRecord); i++)
+    {
+        line[length++] = DIGITS[bytes[i] >> 4];
+        line[length++] = DIGITS[bytes[i] & 0x0f];
+    }
+    line[length++] = '\n';
+    Serial.write(reinterpret_cast<const uint8_t *>(line), length);
+}
+
+void traceFlush()
+{
+    size_t first = (ring.next + TRACE_CAPACITY - ring.count) % TRACE_CAPACITY;
+    if (ring.dropped > 0)
+    {
+        TraceRecord dropped = {ring.records[first].timeMs, static_cast<uint16_t>(TraceEvent::DROPPED), 0,
+                               static_cast<int32_t>(ring.dropped), 0};
+        writeRecord(dropped);
+    }
+
+    for (size_t i = 0; i < ring.count; i++)
+        writeRecord(ring.records[(first + i) % TRACE_CAPACITY]);
+
+    ring.count = 0;
+    ring.dropped = 0;
+}
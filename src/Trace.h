@@ -0,0 +1,53 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "Arduino.h"
+#include "TraceEvents.h"
+
+#ifndef TRACE_CAPACITY
+#define TRACE_CAPACITY 128 // Records kept in RTC memory between flushes, 16 bytes each
+#endif
+
+// Line prefix of a flushed record, followed by the record in hex
+#define TRACE_LINE_PREFIX "#T1 "
+
+enum class TraceEvent : uint16_t
+{
+#define TRACE_EVENT_ID(name, format) name,
+    TRACE_EVENTS(TRACE_EVENT_ID)
+#undef TRACE_EVENT_ID
+    COUNT
+};
+
+struct TraceRecord
+{
+    uint32_t timeMs; // RTC time, wraps after 49 days
+    uint16_t event;
+    uint16_t reserved;
+    int32_t a;
+    int32_t b;
+};
+
+/**
+ * @brief Records an event with two packed arguments in the RTC memory ring.
+ *
+ * Costs a few stores instead of formatting a log line, so it can sit on
+ * paths that run every wake cycle. The ring survives deep sleep; when it is
+ * full the oldest records are overwritten and counted. Fractions go in as
+ * fixed point, see traceCenti() and TraceEvents.h.
+ */
+void trace(TraceEvent event, int32_t a = 0, int32_t b = 0);
+
+// Hundredths for a %h argument, thousandths for %k
+int32_t traceCenti(float value);
+int32_t traceMilli(float value);
+
+/**
+ * @brief Writes the ring to Serial, one line per record, and empties it.
+ *
+ * Only worth calling with a USB host attached. The native program turns the
+ * lines back into text with --decode-trace.
+ */
+void traceFlush();
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+/**
+ * Every trace event with the text the decoder prints for it. The firmware
+ * only takes the names from here, the strings stay out of its flash.
+ *
+ * A format gets the two arguments of the record in order: %d, %u and %x as
+ * 32-bit integers, %h as hundredths and %k as thousandths of a unit. New
+ * events go at the end, so a decoder built from an older table still names
+ * the records it knows; events no longer recorded keep their place.
+ */
+#define TRACE_EVENTS(EVENT)                                                                           \
+    EVENT(DROPPED, "%u older events overwritten before a host read them")                             \
+    EVENT(POWER_MANAGEMENT, "Power management on: %u-%u MHz")                                         \
+    EVENT(AUTO_LIGHT_SLEEP, "Automatic light sleep on")                                               \
+    EVENT(WAKE_STATE, "Wake state %d took %u ms")                                                     \
+    EVENT(DISPLAY_ON, "Display on %u ms after wake")                                                  \
+    EVENT(DISPLAY_UPDATE, "Display update: %u tiles in %u us")                                        \
+    EVENT(CO2_OVERDUE, "CO2 reading overdue, measuring now")                                          \
+    EVENT(SCD41_BUS, "Configuring I2C for CO2 sensor")                                                \
+    EVENT(SCD41_FINGERPRINT, "SCD41 configuration fingerprint %08x matches")                          \
+    EVENT(SCD41_CONFIGURING, "Configuring Sensirion SCD41")                                           \
+    EVENT(SCD41_CONFIGURED, "SCD41 configured (%d fields changed), not persisted")                    \
+    EVENT(SCD41_ASC_INTERVAL, "Average sampling interval now %u s, ASC periods will be reconfigured") \
+    EVENT(SCD41_DISCARD, "Discarding the first reading after wake-up")                                \
+    EVENT(SCD41_READY, "Measurement ready after %u ms, next prediction %u ms")                        \
+    EVENT(SCD41_POWER_DOWN, "SCD41 powered down for %u s")                                            \
+    EVENT(READING_CO2, "CO2: %d ppm")                                                                 \
+    EVENT(READING_CLIMATE, "Temp: %h C, RH: %h %%")                                                   \
+    EVENT(CLIMATE_CHANGED, "Temperature changed %h C, humidity %h %%RH since the last CO2 shot")      \
+    EVENT(BATTERY, "Battery %k V at %h mA")                                                           \
+    EVENT(BATTERY_ESTIMATE, "Battery %h %% on the curve, %h %% estimated")                            \
+    EVENT(BATTERY_REUSED, "Battery sampled %u s ago, reusing %u mV")                                  \
+    EVENT(SAMPLING_INTERVAL, "CO2 rate %h ppm/min, next sampling interval %u s")                      \
+    EVENT(REPORT_DELTA_REACHED, "CO2 change (%d ppm) reached reporting delta (%d ppm)")               \
+    EVENT(REPORT_DELTA_BELOW, "CO2 change (%d ppm) less than reporting delta (%d ppm)")               \
+    EVENT(REPORT_BAND_LEFT, "CO2 %d ppm left the band around the predicted %d ppm")                   \
+    EVENT(REPORT_BAND_WITHIN, "CO2 %d ppm within the band around the predicted %d ppm")               \
+    EVENT(UPLOAD_RADIO_AHEAD, "Upload due, starting Zigbee %u ms before the measurement is ready")    \
+    EVENT(UPLOAD_RADIO_STARTED, "Zigbee started during the measurement, uploading")                   \
+    EVENT(UPLOAD_TIER_CHANGED, "Power tier changed to %u, uploading")                                 \
+    EVENT(UPLOAD_CO2, "CO2 %d ppm needs reporting, uploading")                                        \
+    EVENT(UPLOAD_BUFFER_FULL, "%u samples buffered, uploading")                                       \
+    EVENT(BUFFERED, "CO2 %d ppm does not need reporting, buffering sample %u")                        \
+    EVENT(RADIO_OFF, "Radio off in power tier %u, keeping %u samples buffered")                       \
+    EVENT(RADIO_BACKING_OFF, "Radio backing off after %u failures, keeping %u samples buffered")      \
+    EVENT(RADIO_BACK, "Radio back after %u failed attempts")                                          \
+    EVENT(ZIGBEE_FAST_REJOIN, "Fast rejoin on channel %d")                                            \
+    EVENT(ZIGBEE_ALREADY_STARTED, "Zigbee already initialized")                                       \
+    EVENT(ZIGBEE_STARTING, "Starting Zigbee")                                                         \
+    EVENT(ZIGBEE_STARTED, "Zigbee started")                                                           \
+    EVENT(ZIGBEE_CONNECTING, "Connecting to Zigbee network")                                          \
+    EVENT(ZIGBEE_ALREADY_CONNECTED, "Already connected to Zigbee network")                            \
+    EVENT(ZIGBEE_CONNECTED, "Connected to Zigbee network on channel %d in %u ms")                     \
+    EVENT(REPORTED_CO2, "Reported CO2: %d ppm")                                                       \
+    EVENT(REPORTED_BATTERY, "Reported battery: %u %%")                                                \
+    EVENT(REPORTED_SAMPLES, "Reported %u buffered samples, %u left for the next upload")              \
+    EVENT(REPORTED_POWER_TIER, "Reported power tier: %u")                                             \
+    EVENT(REPORTED_TEMPERATURE, "Reported temperature: %h C")                                         \
+    EVENT(REPORTED_HUMIDITY, "Reported humidity: %h %%")                                              \
+    EVENT(NEXT_WAKEUP, "Next wakeup in: %u s, %u s since the previous measurement")                   \
+    EVENT(NEXT_WAKEUP_CO2, "Next wakeup in: %u s (CO2)")                                              \
+    EVENT(NEXT_WAKEUP_RHT, "Next wakeup in: %u s (RHT only, CO2 in %u s)")                            \
+    EVENT(WAKE_CYCLE, "Wake cycle %u: awake %u ms")                                                   \
+    EVENT(ENERGY, "%h uA average since power-on, %k mAh/day projected")                               \
+    EVENT(LIGHT_SLEEP, "Light sleep for %u s")                                                        \
+    EVENT(DEEP_SLEEP, "Going to sleep for %u s")                                                      \
+    EVENT(SAMPLE_OVERWRITTEN, "Sample buffer full, oldest overwritten (%u since power-on)")          \
+    EVENT(REPORT_HOLD_LIMIT_REACHED, "CO2 change (%d ppm) reached the hold limit (%d ppm) within the band") \
+    EVENT(WAKE_STATE_MISSED, "Wake state %d overran its %u ms budget, the last cycle was forced to sleep")
+
+#endif
@@ -0,0 +1,128 @@
+#include "WakeCycle.h"
+#include "Trace.h"
+#include "rtc.h"
+
+#define STATE_COUNT static_cast<size_t>(WakeState::COUNT)
+
+struct WakeCycleStats
+{
+    uint32_t entries[STATE_COUNT];
+    uint32_t misses[STATE_COUNT];
+    uint32_t maxMs[STATE_COUNT];
+    bool missed;           // the last cycle was forced to sleep
+    WakeState missedState; // in this state
+};
+
+RTC_DATA_ATTR static WakeCycleStats stats = {};
+
+WakeCycle::WakeCycle(PowerManager &powerManager, const uint32_t *budgetsMs)
+    : powerManager(powerManager), budgetsMs(budgetsMs)
+{
+}
+
+bool WakeCycle::begin(DeadlineHandler onDeadline)
+{
+    handler = onDeadline;
+
+    if (stats.missed)
+    {
+        size_t index = static_cast<size_t>(stats.missedState);
+        log_e("Wake state %s overran its %lu ms budget (%lu misses since power-on), the last cycle was forced to sleep",
+              stateName(stats.missedState), static_cast<unsigned long>(budgetsMs[index]),
+              static_cast<unsigned long>(stats.misses[index]));
+        trace(TraceEvent::WAKE_STATE_MISSED, static_cast<int32_t>(index), static_cast<int32_t>(budgetsMs[index]));
+        stats.missed = false;
+    }
+
+    esp_timer_create_args_t args = {};
+    args.callback = WakeCycle::onDeadline;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "wake deadline";
+    if (esp_timer_create(&args, &timer) != ESP_OK)
+    {
+        log_e("Wake cycle deadline timer not created, states run without budgets");
+        timer = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void WakeCycle::leave()
+{
+    if (current == WakeState::COUNT)
+        return;
+
+    uint32_t elapsedMs = (powerManager.getCurrentTimeMicros() - enteredUs) / 1000;
+    size_t index = static_cast<size_t>(current);
+    if (elapsedMs > stats.maxMs[index])
+        stats.maxMs[index] = elapsedMs;
+    trace(TraceEvent::WAKE_STATE, static_cast<int32_t>(index), static_cast<int32_t>(elapsedMs));
+}
+
+void WakeCycle::enter(WakeState state)
+{
+    leave();
+
+    size_t index = static_cast<size_t>(state);
+    current = state;
+    enteredUs = powerManager.getCurrentTimeMicros();
+    stats.entries[index]++;
+
+    if (timer != nullptr)
+    {
+        esp_timer_stop(timer);
+        esp_timer_start_once(timer, budgetsMs[index] * 1000ULL);
+    }
+    powerManager.setLightSleepDeadline(enteredUs + budgetsMs[index] * 1000ULL);
+}
+
+// Runs in the esp_timer task while the main task is stuck in the state, so it only writes RTC memory
+void WakeCycle::onDeadline(void *arg)
+{
+    WakeCycle *cycle = static_cast<WakeCycle *>(arg);
+    WakeState state = cycle->current;
+    if (state == WakeState::COUNT)
+        return;
+
+    stats.misses[static_cast<size_t>(state)]++;
+    stats.missedState = state;
+    stats.missed = true;
+    if (cycle->handler != nullptr)
+        cycle->handler(state);
+}
+
+void WakeCycle::printStats()
+{
+    Serial.printf("Wake states since power-on\n");
+    Serial.printf("%-8s %10s %10s %8s %8s\n", "state", "budget[ms]", "entries", "misses", "max[ms]");
+    for (size_t i = 0; i < STATE_COUNT; i++)
+    {
+        Serial.printf("%-8s %10lu %10lu %8lu %8lu\n", stateName(static_cast<WakeState>(i)),
+                      static_cast<unsigned long>(budgetsMs[i]), static_cast<unsigned long>(stats.entries[i]),
+                      static_cast<unsigned long>(stats.misses[i]), static_cast<unsigned long>(stats.maxMs[i]));
+    }
+}
+
+const char *WakeCycle::stateName(WakeState state)
+{
+    switch (state)
+    {
+    case WakeState::BOOT:
+        return "boot";
+    case WakeState::SENSE:
+        return "sense";
+    case WakeState::DECIDE:
+        return "decide";
+    case WakeState::RADIO:
+        return "radio";
+    case WakeState::REPORT:
+        return "report";
+    case WakeState::MENU:
+        return "menu";
+    case WakeState::SLEEP:
+        return "sleep";
+    default:
+        return "none";
+    }
+}
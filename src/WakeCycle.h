@@ -0,0 +1,69 @@
+#ifndef WAKE_CYCLE_H
+#define WAKE_CYCLE_H
+
+#include <esp_timer.h>
+#include "Arduino.h"
+#include "PowerManager.h"
+
+enum class WakeState : uint8_t
+{
+    BOOT,   // Wakeup reason, hardware and power tier
+    SENSE,  // RHT and CO2 shots
+    DECIDE, // Buffer the sample or upload
+    RADIO,  // Zigbee start and join
+    REPORT, // Send the buffered samples
+    MENU,   // Button wake, until the menu is left
+    SLEEP,  // Save state and power down
+    COUNT
+};
+
+// Called in the esp_timer task when a state overran its budget; expected not to return. The state it cut short
+// may be anywhere, in the trace ring, on the bus or inside an NVS commit, so it only writes RTC memory.
+typedef void (*DeadlineHandler)(WakeState state);
+
+/**
+ * @brief The states of one wake cycle, each with a time budget.
+ *
+ * The firmware moves through the states with enter(). Entering a state arms
+ * a one-shot esp_timer with its budget, so a state that blocks for longer,
+ * in a wait that never ends or a bus that hangs, does not keep the device
+ * awake: the timer calls the deadline handler, which forces a deep sleep.
+ * Light sleeps are cut at the deadline so the timer can run. Entries,
+ * deadline misses and the longest time spent are kept per state in RTC
+ * memory since power-on. A miss is traced and logged by the next boot's
+ * begin(), from the main task.
+ */
+class WakeCycle
+{
+private:
+    PowerManager &powerManager;
+    const uint32_t *budgetsMs;
+    DeadlineHandler handler = nullptr;
+    esp_timer_handle_t timer = nullptr;
+    WakeState current = WakeState::COUNT;
+    uint64_t enteredUs = 0;
+
+    void leave();
+    static void onDeadline(void *arg);
+
+public:
+    /**
+     * @param budgetsMs one budget per state, in WakeState order.
+     */
+    WakeCycle(PowerManager &powerManager, const uint32_t *budgetsMs);
+
+    bool begin(DeadlineHandler onDeadline);
+
+    /**
+     * @brief Leave the current state and start the budget of the next one.
+     *
+     * The budget runs until the next enter(), so the menu's covers the whole
+     * session, however many presses it takes.
+     */
+    void enter(WakeState state);
+
+    void printStats();
+    static const char *stateName(WakeState state);
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include "WakeScheduler.h"
+#include <algorithm>
+
+// Weight of the older wake-ups in the timer fit, per wake-up; about 100 wake-ups of memory, which takes in
+// sleeps of several lengths also where most are RHT wake-ups of one length
+static const double FIT_FORGETTING = 0.99;
+// Spread of the sleep times, in s², below which lateness is not split into boot and drift
+static const double FIT_MIN_VARIANCE = 4.0;
+// Uncalibrated RC slow clock; a wake-up further off was no timer wake-up, e.g. a reset in between
+static const float MAX_DRIFT = 0.05f;
+static const float MAX_BOOT_MS = 2000.0f;
+// Weight of the newest wake-up to reading latency
+static const float LATENCY_SMOOTHING = 0.2f;
+
+// Decayed sums over the timer wake-ups of sleep time x [s] and lateness y [ms]
+struct LatenessFit
+{
+    double weight;
+    double x;
+    double y;
+    double xx;
+    double xy;
+};
+
+struct WakeScheduleState
+{
+    uint64_t slotUs;         // grid slot of the last reading, 0 before the first
+    uint64_t plannedWakeUs;  // end of the running timer sleep, 0 for none
+    uint64_t plannedSleepUs;
+    uint64_t wokeUs;
+    bool coldWake;
+    LatenessFit fit;
+    float bootMs; // lateness = bootMs + drift * sleep time
+    float drift;
+    float latencyMs[2]; // wake-up to reading, without and with a discarded shot first
+    uint32_t readings; // scheduled ones
+    uint32_t missedSlots;
+    float slotErrorMs; // |reading - slot| summed over the readings
+    uint32_t maxSlotErrorMs;
+};
+
+RTC_DATA_ATTR static WakeScheduleState state = {};
+
+WakeScheduler::WakeScheduler(uint32_t minSleepMs) : minSleepMs(minSleepMs)
+{
+}
+
+void WakeScheduler::wokeUp(uint64_t nowMicros, bool timerWake, bool coldSensor)
+{
+    state.wokeUs = nowMicros;
+    state.coldWake = coldSensor;
+
+    uint64_t plannedWakeUs = state.plannedWakeUs;
+    state.plannedWakeUs = 0;
+    if (!timerWake || plannedWakeUs == 0)
+        return;
+
+    double sleepSeconds = state.plannedSleepUs / 1000000.0;
+    double lateMs = static_cast<int64_t>(nowMicros - plannedWakeUs) / 1000.0;
+    if (fabs(lateMs) > MAX_BOOT_MS + MAX_DRIFT * sleepSeconds * 1000.0)
+    {
+        log_w("Woke %.0f ms off a %.0f s timer sleep, not learned", lateMs, sleepSeconds);
+        return;
+    }
+
+    LatenessFit &fit = state.fit;
+    fit.weight = fit.weight * FIT_FORGETTING + 1.0;
+    fit.x = fit.x * FIT_FORGETTING + sleepSeconds;
+    fit.y = fit.y * FIT_FORGETTING + lateMs;
+    fit.xx = fit.xx * FIT_FORGETTING + sleepSeconds * sleepSeconds;
+    fit.xy = fit.xy * FIT_FORGETTING + sleepSeconds * lateMs;
+
+    // Sleeps of one length only tell the lateness at that length, which is all they need
+    double determinant = fit.weight * fit.xx - fit.x * fit.x;
+    double msPerSecond = 0.0;
+    if (determinant > fit.weight * fit.weight * FIT_MIN_VARIANCE)
+    {
+        msPerSecond = (fit.weight * fit.xy - fit.x * fit.y) / determinant;
+        msPerSecond = std::clamp<double>(msPerSecond, -MAX_DRIFT * 1000.0, MAX_DRIFT * 1000.0);
+    }
+    state.drift = static_cast<float>(msPerSecond / 1000.0);
+    state.bootMs = static_cast<float>((fit.y - msPerSecond * fit.x) / fit.weight);
+}
+
+void WakeScheduler::measured(uint64_t timeMicros, uint32_t intervalSeconds, bool scheduled)
+{
+    if (scheduled && timeMicros > state.wokeUs)
+    {
+        float latencyMs = (timeMicros - state.wokeUs) / 1000.0f;
+        float &learned = state.latencyMs[state.coldWake ? 1 : 0];
+        learned = learned == 0.0f ? latencyMs : learned + (latencyMs - learned) * LATENCY_SMOOTHING;
+    }
+
+    uint64_t intervalUs = intervalSeconds * 1000000ULL;
+    if (state.slotUs == 0 || timeMicros < state.slotUs || intervalUs == 0)
+    {
+        // The first reading starts the grid
+        state.slotUs = timeMicros;
+        return;
+    }
+
+    // Readings before the due slot, e.g. a menu refresh or a climate change, are extras off the grid
+    if (!scheduled && timeMicros < state.slotUs + intervalUs)
+        return;
+
+    uint64_t slots = std::max<uint64_t>((timeMicros - state.slotUs + intervalUs / 2) / intervalUs, 1);
+    if (slots > 1)
+    {
+        state.missedSlots += slots - 1;
+        log_w("%llu CO2 readings missed, back on the grid", slots - 1);
+    }
+    state.slotUs += slots * intervalUs;
+
+    if (!scheduled)
+        return;
+
+    uint64_t errorUs = timeMicros > state.slotUs ? timeMicros - state.slotUs : state.slotUs - timeMicros;
+    uint32_t errorMs = static_cast<uint32_t>(errorUs / 1000);
+    state.readings++;
+    state.slotErrorMs += errorMs;
+    state.maxSlotErrorMs = std::max(state.maxSlotErrorMs, errorMs);
+}
+
+void WakeScheduler::failed(uint64_t timeMicros, uint32_t intervalSeconds)
+{
+    uint64_t intervalUs = intervalSeconds * 1000000ULL;
+    if (state.slotUs == 0 || timeMicros < state.slotUs || intervalUs == 0)
+    {
+        state.slotUs = timeMicros;
+        return;
+    }
+
+    // Nothing to give up right after a reading
+    uint64_t slots = (timeMicros - state.slotUs + intervalUs / 2) / intervalUs;
+    state.missedSlots += slots;
+    state.slotUs += slots * intervalUs;
+}
+
+uint64_t WakeScheduler::untilDue(uint64_t nowMicros, uint32_t intervalSeconds) const
+{
+    if (state.slotUs == 0)
+        return 0;
+
+    uint64_t dueUs = state.slotUs + intervalSeconds * 1000000ULL;
+    return dueUs > nowMicros ? dueUs - nowMicros : 0;
+}
+
+double WakeScheduler::timerSleepUs(uint64_t untilReadingMicros, bool coldSensor) const
+{
+    float latencyMs = state.latencyMs[coldSensor ? 1 : 0];
+    if (latencyMs == 0.0f)
+        latencyMs = state.latencyMs[0];
+
+    double wakeInUs = static_cast<double>(untilReadingMicros) - (latencyMs + state.bootMs) * 1000.0;
+    return wakeInUs / (1.0 + state.drift);
+}
+
+bool WakeScheduler::overdue(uint64_t nowMicros, uint32_t intervalSeconds, bool coldSensor) const
+{
+    return timerSleepUs(untilDue(nowMicros, intervalSeconds), coldSensor) < minSleepMs * 1000.0;
+}
+
+uint64_t WakeScheduler::sleepFor(uint64_t untilReadingMicros, bool coldSensor) const
+{
+    double sleepUs = timerSleepUs(untilReadingMicros, coldSensor);
+    return sleepUs > minSleepMs * 1000.0 ? static_cast<uint64_t>(sleepUs) : minSleepMs * 1000ULL;
+}
+
+void WakeScheduler::sleeping(uint64_t nowMicros, uint64_t sleepMicros)
+{
+    state.plannedWakeUs = nowMicros + sleepMicros;
+    state.plannedSleepUs = sleepMicros;
+}
+
+void WakeScheduler::printStats()
+{
+    Serial.printf("Wake schedule since power-on\n");
+    Serial.printf("%lu readings on the grid, %.0f ms off on average, %lu ms at most, %lu missed\n",
+                  static_cast<unsigned long>(state.readings), state.readings ? state.slotErrorMs / state.readings : 0.0f,
+                  static_cast<unsigned long>(state.maxSlotErrorMs), static_cast<unsigned long>(state.missedSlots));
+    Serial.printf("Timer wakes %.0f ms + %.0f ppm of the sleep late, readings %.0f ms (sensor idle) and %.0f ms "
+                  "(discard shot first) after wake-up\n",
+                  state.bootMs, state.drift * 1e6f, state.latencyMs[0], state.latencyMs[1]);
+}
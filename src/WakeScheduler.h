@@ -0,0 +1,77 @@
+#ifndef WAKE_SCHEDULER_H
+#define WAKE_SCHEDULER_H
+
+#include "Arduino.h"
+
+/**
+ * @brief Places CO2 readings on a fixed time grid.
+ *
+ * Each reading is due one sampling interval after the grid slot of the one
+ * before, not after the reading itself, so wake-up and measurement latency do
+ * not add up from sample to sample. A scheduled reading is assigned to the
+ * nearest slot. When slots were missed, e.g. behind the menu or a forced
+ * sleep, the next reading is due at once and the grid continues from the slot
+ * it landed in. Unscheduled readings before the due slot leave the grid alone.
+ *
+ * To land on the slot the device has to wake before it. The scheduler learns
+ * two things in RTC memory: how long a reading takes from wake-up, separately
+ * for a CO2 shot behind a discarded one, and how late the deep sleep timer wakes.
+ * The latter is fitted as a constant (boot) plus a share of the sleep time
+ * (the error of the RTC slow clock).
+ */
+class WakeScheduler
+{
+private:
+    uint32_t minSleepMs;
+
+    // Timer sleep that ends the reading in untilReadingMicros, negative when it is too late to sleep
+    double timerSleepUs(uint64_t untilReadingMicros, bool coldSensor) const;
+
+public:
+    WakeScheduler(uint32_t minSleepMs);
+
+    /**
+     * @brief Call first thing after a wake-up.
+     *
+     * @param nowMicros RTC time.
+     * @param timerWake woken by the deep sleep timer, whose lateness is learned.
+     * @param coldSensor the CO2 shot needs a discarded shot first, after a sensor power-down.
+     */
+    void wokeUp(uint64_t nowMicros, bool timerWake, bool coldSensor);
+
+    /**
+     * @brief A CO2 reading was taken.
+     *
+     * @param timeMicros RTC time of the reading.
+     * @param scheduled the reading this wake-up was scheduled for, which teaches the latency;
+     *                  otherwise it only counts when it catches up with the due slot.
+     */
+    void measured(uint64_t timeMicros, uint32_t intervalSeconds, bool scheduled);
+
+    /**
+     * @brief A CO2 reading failed; its slot is given up rather than retried at once.
+     */
+    void failed(uint64_t timeMicros, uint32_t intervalSeconds);
+
+    // Time until the next reading is due, 0 when it is (over)due
+    uint64_t untilDue(uint64_t nowMicros, uint32_t intervalSeconds) const;
+
+    // Too late to sleep before the next reading
+    bool overdue(uint64_t nowMicros, uint32_t intervalSeconds, bool coldSensor) const;
+
+    /**
+     * @brief Deep sleep time for a reading due in untilReadingMicros.
+     *
+     * Shortened by the learned latency and timer error, at least minSleepMs.
+     */
+    uint64_t sleepFor(uint64_t untilReadingMicros, bool coldSensor) const;
+
+    /**
+     * @brief Call right before a deep sleep with the timer set to sleepMicros.
+     */
+    void sleeping(uint64_t nowMicros, uint64_t sleepMicros);
+
+    void printStats();
+};
+
+#endif
@@ -1,16 +1,49 @@
 #include "ZigbeeManager.h"
+#include "Trace.h"
+#include "rtc.h"
 
-ZigbeeManager::ZigbeeManager(uint8_t endpoint, const String& mfg, const String& mdl, 
-                            uint16_t minValue, uint16_t maxValue, uint32_t keepAlive)
-    : endpointNumber(endpoint), manufacturer(mfg), model(mdl),
+// Halve the histogram once it holds this many connects, so it follows recent behaviour
+#define CONNECT_HISTOGRAM_WINDOW 128
+#define TYPICAL_CONNECT_MIN_SAMPLES 4 // The first join scans all channels and says little about rejoins
+#define CONNECT_TIMEOUT_MS 10000
+#define CONNECT_POLL_MS 10
+
+struct ConnectStats {
+    uint32_t lastConnectMs;
+    uint16_t total;
+    uint16_t histogram[ZIGBEE_CONNECT_HISTOGRAM_BINS];
+    uint32_t failures;
+};
+
+RTC_DATA_ATTR static ConnectStats connectStats = {};
+
+// Temperature and humidity the coordinator last received
+struct ClimateReport {
+    bool valid;
+    float temperature;
+    float humidity;
+};
+
+RTC_DATA_ATTR static ClimateReport reportedClimate = {};
+
+ZigbeeManager::ZigbeeManager(Settings& settings, uint8_t endpoint, uint8_t climateEndpoint, uint8_t powerTierEndpoint,
+                            const String& mfg, const String& mdl, uint16_t minValue, uint16_t maxValue, uint32_t keepAlive)
+    : endpointNumber(endpoint), climateEndpointNumber(climateEndpoint), powerTierEndpointNumber(powerTierEndpoint),
+      manufacturer(mfg), model(mdl),
       minCO2Value(minValue), maxCO2Value(maxValue), keepAliveTime(keepAlive),
-      isInitialized(false), isConnected(false) {
+      temperatureDelta(0.2f), humidityDelta(1.0f),
+      isInitialized(false), isConnected(false), fastRejoin(true), initializeStartMs(0),
+      settings(settings) {
     
     carbonDioxideSensor = new ZigbeeCarbonDioxideSensor(endpointNumber);
+    climateSensor = new ZigbeeTempSensor(climateEndpointNumber);
+    powerTierSensor = new ZigbeeAnalog(powerTierEndpointNumber);
 }
 
 ZigbeeManager::~ZigbeeManager() {
     delete carbonDioxideSensor;
+    delete climateSensor;
+    delete powerTierSensor;
 }
 
 bool ZigbeeManager::initialize() {
@@ -20,29 +53,52 @@ bool ZigbeeManager::initialize() {
     }
     
     if (isInitialized) {
-        log_i("Zigbee already initialized");
+        trace(TraceEvent::ZIGBEE_ALREADY_STARTED);
         return true;
     }
     
+    initializeStartMs = millis();
+    
     // Configure the sensor
     carbonDioxideSensor->setManufacturerAndModel(manufacturer.c_str(), model.c_str());
     carbonDioxideSensor->setMinMaxValue(minCO2Value, maxCO2Value);
     carbonDioxideSensor->setPowerSource(zb_power_source_t::ZB_POWER_SOURCE_BATTERY);
     
-    // Add endpoint to Zigbee
+    // Temperature and humidity on a sibling endpoint, SCD41 ranges and accuracy
+    climateSensor->setManufacturerAndModel(manufacturer.c_str(), model.c_str());
+    climateSensor->setMinMaxValue(-10, 60);
+    climateSensor->setTolerance(0.8);
+    climateSensor->addHumiditySensor(0, 100, 6);
+    climateSensor->setPowerSource(zb_power_source_t::ZB_POWER_SOURCE_BATTERY);
+    
+    powerTierSensor->setManufacturerAndModel(manufacturer.c_str(), model.c_str());
+    powerTierSensor->addAnalogInput();
+    powerTierSensor->setPowerSource(zb_power_source_t::ZB_POWER_SOURCE_BATTERY);
+    
+    // Add endpoints to Zigbee
     Zigbee.addEndpoint(carbonDioxideSensor);
+    Zigbee.addEndpoint(climateSensor);
+    Zigbee.addEndpoint(powerTierSensor);
     
     // Configure Zigbee
     esp_zb_cfg_t zigbeeConfig = ZIGBEE_DEFAULT_ED_CONFIG();
     zigbeeConfig.nwk_cfg.zed_cfg.keep_alive = keepAliveTime;
     
-    log_i("Starting Zigbee...");
+    // The stack rejoins with the network parameters it persisted; limiting it to
+    // the last channel skips the scan over all 16 channels
+    uint8_t channel = fastRejoin ? settings.getZigbeeChannel() : 0;
+    if (channel != 0) {
+        trace(TraceEvent::ZIGBEE_FAST_REJOIN, channel);
+        Zigbee.setPrimaryChannelMask(1UL << channel);
+    }
+    
+    trace(TraceEvent::ZIGBEE_STARTING);
     if (!Zigbee.begin(&zigbeeConfig, false)) {
         log_e("Zigbee failed to start!");
         return false;
     }
     
-    log_i("Zigbee started!");
+    trace(TraceEvent::ZIGBEE_STARTED);
     isInitialized = true;
     return true;
 }
@@ -54,44 +110,68 @@ bool ZigbeeManager::connect() {
     }
     
     if (isConnected) {
-        log_i("Already connected to Zigbee network");
+        trace(TraceEvent::ZIGBEE_ALREADY_CONNECTED);
         return true;
     }
     
-    log_i("Connecting to Zigbee network...");
+    trace(TraceEvent::ZIGBEE_CONNECTING);
     
     // Wait for connection with timeout
     uint32_t startTime = millis();
-    const uint32_t TIMEOUT_MS = 10000; // 10 second timeout
     
-    while (!Zigbee.connected() && (millis() - startTime) < TIMEOUT_MS) {
-        log_i(".");
-        delay(100);
+    while (!pollConnection() && (millis() - startTime) < CONNECT_TIMEOUT_MS) {
+        delay(CONNECT_POLL_MS);
     }
     
-    if (Zigbee.connected()) {
-        log_i("Connected to Zigbee network!");
-        isConnected = true;
+    if (pollConnection()) {
         return true;
     } else {
+        connectStats.failures++;
+        if (settings.getZigbeeChannel() != 0) {
+            // The coordinator may have moved, scan all channels next time
+            log_w("No rejoin on channel %d, forgetting it", settings.getZigbeeChannel());
+            settings.setZigbeeChannel(0);
+        }
         log_e("Failed to connect to Zigbee network within timeout");
         return false;
     }
 }
 
+bool ZigbeeManager::pollConnection() {
+    if (isConnected) {
+        return true;
+    }
+    if (!isInitialized || !Zigbee.connected()) {
+        return false;
+    }
+    
+    recordConnectTime(millis() - initializeStartMs);
+    settings.setZigbeeChannel(esp_zb_get_current_channel());
+    trace(TraceEvent::ZIGBEE_CONNECTED, settings.getZigbeeChannel(), static_cast<int32_t>(connectStats.lastConnectMs));
+    isConnected = true;
+    return true;
+}
+
+bool ZigbeeManager::isStarted() const {
+    return isInitialized;
+}
+
 bool ZigbeeManager::isZigbeeConnected() const {
     return isConnected && Zigbee.connected();
 }
 
-void ZigbeeManager::reportCO2(uint16_t co2Value) {
+bool ZigbeeManager::reportCO2(uint16_t co2Value) {
     if (!isZigbeeConnected()) {
         log_w("Cannot report CO2: Not connected to Zigbee network");
-        return;
+        return false;
     }
     
     carbonDioxideSensor->setCarbonDioxide(co2Value);
-    carbonDioxideSensor->report();
-    log_i("Reported CO2: %d ppm", co2Value);
+    if (!carbonDioxideSensor->report()) {
+        return false;
+    }
+    trace(TraceEvent::REPORTED_CO2, co2Value);
+    return true;
 }
 
 void ZigbeeManager::reportBattery(uint8_t batteryPercentage) {
@@ -103,7 +183,7 @@ void ZigbeeManager::reportBattery(uint8_t batteryPercentage) {
     uint8_t clampedPercentage = constrain(batteryPercentage, 0, 100);
     carbonDioxideSensor->setBatteryPercentage(clampedPercentage);
     carbonDioxideSensor->reportBatteryPercentage();
-    log_i("Reported battery: %d%%", clampedPercentage);
+    trace(TraceEvent::REPORTED_BATTERY, clampedPercentage);
 }
 
 void ZigbeeManager::reportSensorData(uint16_t co2, uint8_t batteryPercentage) {
@@ -120,7 +200,62 @@ void ZigbeeManager::reportSensorData(uint16_t co2, uint8_t batteryPercentage) {
     carbonDioxideSensor->reportBatteryPercentage();
     carbonDioxideSensor->report();
     
-    log_i("Reported sensor data - CO2: %d ppm, Battery: %d%%", co2, batteryPercentage);
+    trace(TraceEvent::REPORTED_CO2, co2);
+    trace(TraceEvent::REPORTED_BATTERY, batteryPercentage);
+}
+
+void ZigbeeManager::reportConditions(const Sample& sample) {
+    if (!isZigbeeConnected()) {
+        log_w("Cannot report conditions: Not connected to Zigbee network");
+        return;
+    }
+    
+    reportClimate(sample);
+    reportBattery(sample.batteryPercentage);
+}
+
+void ZigbeeManager::reportPowerTier(uint8_t tier) {
+    if (!isZigbeeConnected()) {
+        log_w("Cannot report power tier: Not connected to Zigbee network");
+        return;
+    }
+    
+    powerTierSensor->setAnalogInput(tier);
+    powerTierSensor->reportAnalogInput();
+    trace(TraceEvent::REPORTED_POWER_TIER, tier);
+}
+
+void ZigbeeManager::reportClimate(const Sample& sample) {
+    // Only the attributes that changed enough go out with the CO2 backlog
+    float temperature = sample.temperatureCenti / 100.0f;
+    float humidity = sample.humidityCenti / 100.0f;
+    bool temperatureKnown = reportedClimate.valid;
+    bool humidityKnown = reportedClimate.valid;
+    
+    if (!temperatureKnown || fabsf(temperature - reportedClimate.temperature) >= temperatureDelta) {
+        climateSensor->setTemperature(temperature);
+        temperatureKnown = climateSensor->reportTemperature();
+        if (temperatureKnown) {
+            reportedClimate.temperature = temperature;
+            trace(TraceEvent::REPORTED_TEMPERATURE, sample.temperatureCenti);
+        }
+    }
+    
+    if (!humidityKnown || fabsf(humidity - reportedClimate.humidity) >= humidityDelta) {
+        climateSensor->setHumidity(humidity);
+        humidityKnown = climateSensor->reportHumidity();
+        if (humidityKnown) {
+            reportedClimate.humidity = humidity;
+            trace(TraceEvent::REPORTED_HUMIDITY, sample.humidityCenti);
+        }
+    }
+    
+    reportedClimate.valid = reportedClimate.valid || (temperatureKnown && humidityKnown);
+}
+
+void ZigbeeManager::setClimateReportingDelta(float temperature, float humidity) {
+    temperatureDelta = temperature;
+    humidityDelta = humidity;
 }
 
 void ZigbeeManager::setManufacturerAndModel(const String& mfg, const String& mdl) {
@@ -129,6 +264,8 @@ void ZigbeeManager::setManufacturerAndModel(const String& mfg, const String& mdl
     
     if (isInitialized) {
         carbonDioxideSensor->setManufacturerAndModel(manufacturer.c_str(), model.c_str());
+        climateSensor->setManufacturerAndModel(manufacturer.c_str(), model.c_str());
+        powerTierSensor->setManufacturerAndModel(manufacturer.c_str(), model.c_str());
     }
 }
 
@@ -145,21 +282,71 @@ void ZigbeeManager::setKeepAlive(uint32_t keepAliveMs) {
     keepAliveTime = keepAliveMs;
 }
 
+void ZigbeeManager::setFastRejoin(bool enabled) {
+    fastRejoin = enabled;
+}
+
+void ZigbeeManager::recordConnectTime(uint32_t elapsedMs) {
+    connectStats.lastConnectMs = elapsedMs;
+    
+    if (connectStats.total >= CONNECT_HISTOGRAM_WINDOW) {
+        connectStats.total = 0;
+        for (size_t i = 0; i < ZIGBEE_CONNECT_HISTOGRAM_BINS; i++) {
+            connectStats.histogram[i] /= 2;
+            connectStats.total += connectStats.histogram[i];
+        }
+    }
+    
+    size_t bin = 0;
+    while (bin < ZIGBEE_CONNECT_HISTOGRAM_BINS - 1 && elapsedMs >= connectHistogramBinLimitMs(bin)) {
+        bin++;
+    }
+    connectStats.histogram[bin]++;
+    connectStats.total++;
+}
+
+uint32_t ZigbeeManager::getTypicalConnectMs() const {
+    // Lower edge of the bin holding the median, so a start this far ahead rarely waits for the network
+    if (connectStats.total < TYPICAL_CONNECT_MIN_SAMPLES) {
+        return 0;
+    }
+    
+    uint32_t count = 0;
+    for (size_t bin = 0; bin < ZIGBEE_CONNECT_HISTOGRAM_BINS; bin++) {
+        count += connectStats.histogram[bin];
+        if (2 * count >= connectStats.total && count > 0) {
+            return bin > 0 ? connectHistogramBinLimitMs(bin - 1) : 0;
+        }
+    }
+    return 0;
+}
+
+uint32_t ZigbeeManager::connectHistogramBinLimitMs(size_t bin) {
+    return bin < ZIGBEE_CONNECT_HISTOGRAM_BINS - 1 ? 125UL << bin : UINT32_MAX;
+}
+
+void ZigbeeManager::printConnectStats() {
+    Serial.printf("Zigbee connect times, last %lu ms, %lu failures since power-on\n",
+                  static_cast<unsigned long>(connectStats.lastConnectMs), static_cast<unsigned long>(connectStats.failures));
+    for (size_t i = 0; i < ZIGBEE_CONNECT_HISTOGRAM_BINS; i++) {
+        if (i < ZIGBEE_CONNECT_HISTOGRAM_BINS - 1) {
+            Serial.printf("  < %5lu ms %5u\n", static_cast<unsigned long>(connectHistogramBinLimitMs(i)), connectStats.histogram[i]);
+        } else {
+            Serial.printf(" >= %5lu ms %5u\n", static_cast<unsigned long>(connectHistogramBinLimitMs(i - 1)), connectStats.histogram[i]);
+        }
+    }
+}
+
 bool ZigbeeManager::isReportingEnabled() {
 #if HEADLESS_MODE
     return true; // Always enabled in headless mode
 #endif
-    preferences.begin("zigbee", true); // true = read-only mode
-    bool enabled = preferences.getBool("enabled", true); // default to true
-    preferences.end();
-    return enabled;
+    return settings.isZigbeeEnabled();
 }
 
 void ZigbeeManager::setReportingEnabled(bool enabled) {
-    preferences.begin("zigbee", false); // false = read/write mode
-    preferences.putBool("enabled", enabled);
-    preferences.end();
-    log_i("Saved Zigbee reporting setting: %s", enabled ? "enabled" : "disabled");
+    settings.setZigbeeEnabled(enabled);
+    log_i("Zigbee reporting setting: %s", enabled ? "enabled" : "disabled");
 }
 
 void ZigbeeManager::toggleReporting() {
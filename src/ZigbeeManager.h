@@ -2,26 +2,44 @@
 #define ZIGBEE_MANAGER_H
 
 #include <Zigbee.h>
-#include <Preferences.h>
 #include "Arduino.h"
+#include "SampleBuffer.h"
+#include "Settings.h"
+
+// Connect times are binned by powers of two from 125 ms, the last bin is open-ended
+#define ZIGBEE_CONNECT_HISTOGRAM_BINS 8
 
 class ZigbeeManager {
 private:
     ZigbeeCarbonDioxideSensor* carbonDioxideSensor;
+    ZigbeeTempSensor* climateSensor;
+    ZigbeeAnalog* powerTierSensor;
     uint8_t endpointNumber;
+    uint8_t climateEndpointNumber;
+    uint8_t powerTierEndpointNumber;
     String manufacturer;
     String model;
     uint16_t minCO2Value;
     uint16_t maxCO2Value;
     uint32_t keepAliveTime;
+    float temperatureDelta;
+    float humidityDelta;
     
     bool isInitialized;
     bool isConnected;
+    bool fastRejoin;
+    uint32_t initializeStartMs;
+    
+    Settings& settings;
     
-    Preferences preferences;
+    void recordConnectTime(uint32_t elapsedMs);
+    void reportClimate(const Sample& sample);
 
 public:
-    ZigbeeManager(uint8_t endpoint = 10, 
+    ZigbeeManager(Settings& settings,
+                  uint8_t endpoint = 10, 
+                  uint8_t climateEndpoint = 11,
+                  uint8_t powerTierEndpoint = 12,
                   const String& mfg = "sando@home", 
                   const String& mdl = "CO2 Sensor",
                   uint16_t minValue = 1,
@@ -33,17 +51,36 @@ public:
     // Initialization and connection
     bool initialize();
     bool connect();
+    // The stack runs and joins in its own task once initialized, so connect() may find it done
+    bool isStarted() const;
+    // Notes the connect time without waiting, for callers doing other work meanwhile
+    bool pollConnection();
     bool isZigbeeConnected() const;
     
     // Data reporting
-    void reportCO2(uint16_t co2Value);
+    // True once the report is queued
+    bool reportCO2(uint16_t co2Value);
     void reportBattery(uint8_t batteryPercentage);
     void reportSensorData(uint16_t co2, uint8_t batteryPercentage);
+    // Climate and battery of the newest sample sent, the climate only where it changed enough
+    void reportConditions(const Sample& sample);
+    // Battery power tier as an analog input, 0 for full power
+    void reportPowerTier(uint8_t tier);
     
     // Configuration
     void setManufacturerAndModel(const String& mfg, const String& mdl);
     void setCO2Range(uint16_t minValue, uint16_t maxValue);
     void setKeepAlive(uint32_t keepAliveMs);
+    // Reportable change of the temperature (°C) and humidity (%RH) attributes
+    void setClimateReportingDelta(float temperature, float humidity);
+    // Rejoin on the channel of the last session instead of scanning all channels
+    void setFastRejoin(bool enabled);
+    
+    // Connection telemetry, kept in RTC memory
+    // Connect time beaten by about half of the recent connects, 0 when unknown
+    uint32_t getTypicalConnectMs() const;
+    static uint32_t connectHistogramBinLimitMs(size_t bin);
+    void printConnectStats();
     
     // Settings management
     bool isReportingEnabled();
@@ -1,153 +1,471 @@
 #include <Wire.h>
 #include <esp_sleep.h>
 #include <Zigbee.h>
+#include <algorithm>
 #include "Arduino.h"
 #include "rtc.h"
 #include "CO2Sensor.h"
 #include "PowerManager.h"
 #include "ZigbeeManager.h"
+#include "SampleBuffer.h"
+#include "SamplingScheduler.h"
+#include "ReportingPolicy.h"
+#include "RadioBackoff.h"
+#include "Settings.h"
+#include "PowerGovernor.h"
+#include "ButtonInput.h"
+#include "I2CBus.h"
+#include "WakeCycle.h"
+#include "Trace.h"
 
 #ifndef HEADLESS_MODE
 #define HEADLESS_MODE 0
 #endif
 
+// 1: report when the reading leaves the band around a shared last value plus slope prediction, or when it moved
+//    REPORTING_DELTA_CO2 away from the last report for consumers that hold the last value (Home Assistant, Zigbee2MQTT)
+// 0: report when the reading moved REPORTING_DELTA_CO2 away from the last report
+#ifndef PREDICTIVE_REPORTING
+#define PREDICTIVE_REPORTING 1
+#endif
+
 #if !HEADLESS_MODE
 #include "Display.h"
-Display display;
 
 RTC_DATA_ATTR bool displayOn = false;
 
 #define LONG_PRESS_MS 1000 // 1 second = long press to select
-#define DISPLAY_TIMEOUT_SECONDS 10
 #define BTN_PIN 0
 #endif // !HEADLESS_MODE
 
-#define CO2_SAMPLING_INTERVAL_SECONDS 900
+#define CO2_SAMPLING_INTERVAL_SECONDS 900 // Nominal interval, adapted to the CO2 rate of change
+#define CO2_SAMPLING_MIN_SECONDS 300
+#define CO2_SAMPLING_MAX_SECONDS 1800
+#define RHT_TRIGGER_TEMPERATURE 0.5f      // Change since the last CO2 shot that takes one right away, in °C
+#define RHT_TRIGGER_HUMIDITY 3.0f         // and in %RH
 #define CARBON_DIOXIDE_SENSOR_ENDPOINT_NUMBER 10
+#define CLIMATE_SENSOR_ENDPOINT_NUMBER 11 // Temperature and humidity
+#define POWER_TIER_ENDPOINT_NUMBER 12
 #define REPORTING_DELTA_CO2 40
+#define REPORTING_DELTA_TEMPERATURE 0.2f
+#define REPORTING_DELTA_HUMIDITY 1.0f
+#define REPORTING_BAND_CO2 30
+#if PREDICTIVE_REPORTING
+#define REPORTING_THRESHOLD_CO2 REPORTING_BAND_CO2
+#else
+#define REPORTING_THRESHOLD_CO2 REPORTING_DELTA_CO2
+#endif
+#define CO2_TEMPERATURE_OFFSET 0.0f
+#define SCD41_POWER_DOWN_MIN_SLEEP_SECONDS 600 // Shorter sleeps keep the SCD41 idle instead of powering it down
+#define UPLOAD_EVERY_N_SAMPLES 8
+#define UPLOAD_MAX_SAMPLES 32              // Per radio session, the rest of a backlog goes with the next uploads
+#define RADIO_BACKOFF_BASE_SECONDS 300     // Wait after the first failed connect, doubled per failure
+#define RADIO_BACKOFF_MAX_SECONDS (2 * 3600)
+#define RADIO_POLL_MS 10                   // Join check while the radio starts during a measurement
+#define FORCED_SLEEP_MIN_SECONDS 60        // After a state overran its budget, so a hang does not repeat at once
+#define STAY_AWAKE_SECONDS 300             // Menu "Stay awake" with the radio on
 
 #define BAT_ADC_PIN A1
 #define I2C_SDA 20
 #define I2C_SCL 18
+#define SCD41_I2C_CLOCK_HZ 400000       // Fast mode, the SCD41 maximum
+#define SCD41_COMMAND_SPACING_US 1000   // Shortest command execution time
+#define SCD41_I2C_RETRIES 2
+#define DISPLAY_I2C_CLOCK_HZ 400000     // Fast mode, the SSD1315 rating
+
+// Longest time each state of a wake cycle may take before the device is forced to sleep
+static const uint32_t WAKE_STATE_BUDGETS_MS[] = {
+    1000,   // boot
+    20000,  // sense: an RHT shot, a discarded CO2 shot after power-down and the CO2 shot, with timeouts
+    500,    // decide
+    12000,  // radio: Zigbee start and the connect timeout
+    2000,   // report: at most UPLOAD_MAX_SAMPLES CO2 values, then climate, battery and tier
+    (STAY_AWAKE_SECONDS + 60) * 1000, // menu, however many presses, so a stuck button cannot keep it awake
+    2000,   // sleep
+};
+static_assert(sizeof(WAKE_STATE_BUDGETS_MS) / sizeof(WAKE_STATE_BUDGETS_MS[0]) ==
+                  static_cast<size_t>(WakeState::COUNT), "one budget per wake state");
 
 // Store sensor readings in RTC memory to survive deep sleep
 #define NO_VALUE -123456789.0f
+
+// What each wake cycle may spend as the battery drains, from full to empty. The sampling interval and
+// the reporting threshold are scaled from the adaptive ones; RHT-only shots run between CO2 shots.
+static const PowerPolicy POWER_POLICIES[] = {
+    // name       min %  interval  threshold  RHT [s]  display [s]  radio
+    {"normal",    30,    1.0f,     1.0f,      60,      10,          true},
+    {"saver",     15,    2.0f,     1.5f,      300,     6,           true},
+    {"low",       5,     4.0f,     2.0f,      0,       4,           true},
+    {"critical",  0,     8.0f,     2.0f,      0,       3,           false}, // samples stay in the buffer
+};
 RTC_DATA_ATTR uint16_t co2 = 0;
 RTC_DATA_ATTR float temp = NO_VALUE;
 RTC_DATA_ATTR float rh = NO_VALUE;
 RTC_DATA_ATTR uint8_t batteryPercentage = 0;
 RTC_DATA_ATTR uint64_t prev_measurement_time = 0;
-
-RTC_DATA_ATTR uint16_t last_reported_co2 = 0;
-
-CO2Sensor co2Sensor(CO2_SAMPLING_INTERVAL_SECONDS);
-ZigbeeManager zigbeeManager(CARBON_DIOXIDE_SENSOR_ENDPOINT_NUMBER);
+RTC_DATA_ATTR uint64_t prev_rht_time = 0;
+RTC_DATA_ATTR MeasurementKind next_measurement = MeasurementKind::CO2;
+// Temperature and humidity at the last CO2 shot, the reference for triggering the next one early
+RTC_DATA_ATTR float co2_shot_temp = NO_VALUE;
+RTC_DATA_ATTR float co2_shot_rh = NO_VALUE;
+
+// Readings not yet sent over Zigbee, uploaded together in one radio session
+RTC_DATA_ATTR SampleBuffer sampleBuffer;
+
+// Defaults until changed at runtime; the values in use are cached in RTC memory in front of NVS
+Settings settings({CO2_TEMPERATURE_OFFSET, CO2_SAMPLING_INTERVAL_SECONDS, 0, REPORTING_THRESHOLD_CO2, 0, true});
+
+I2CBus i2cBus(Wire, I2C_SDA, I2C_SCL);
+CO2Sensor co2Sensor(settings, i2cBus);
+SamplingScheduler samplingScheduler(CO2_SAMPLING_INTERVAL_SECONDS, CO2_SAMPLING_MIN_SECONDS, CO2_SAMPLING_MAX_SECONDS);
+#if PREDICTIVE_REPORTING
+PredictiveReportingPolicy reportingPolicy(REPORTING_BAND_CO2, REPORTING_DELTA_CO2);
+#else
+DeltaReportingPolicy reportingPolicy(REPORTING_DELTA_CO2);
+#endif
+ZigbeeManager zigbeeManager(settings, CARBON_DIOXIDE_SENSOR_ENDPOINT_NUMBER, CLIMATE_SENSOR_ENDPOINT_NUMBER,
+                            POWER_TIER_ENDPOINT_NUMBER);
+RadioBackoff radioBackoff(RADIO_BACKOFF_BASE_SECONDS, RADIO_BACKOFF_MAX_SECONDS);
+// Zigbee was started in this wake cycle and has neither joined nor failed yet
+bool radioAttemptPending = false;
 #ifdef BTN_PIN
 PowerManager powerManager(BAT_ADC_PIN, BTN_PIN);
 #else
 PowerManager powerManager(BAT_ADC_PIN);
 #endif
+PowerGovernor powerGovernor(powerManager, POWER_POLICIES, sizeof(POWER_POLICIES) / sizeof(POWER_POLICIES[0]));
+WakeCycle wakeCycle(powerManager, WAKE_STATE_BUDGETS_MS);
+WakeupReason wakeupReason = WakeupReason::OTHER;
+#if !HEADLESS_MODE
+Display display(i2cBus);
+ButtonInput buttonInput(powerManager, BTN_PIN, LONG_PRESS_MS);
+#endif
+
+void initializeBus()
+{
+    i2cBus.configure(BusDevice::SCD41, {SCD41_I2C_CLOCK_HZ, SCD41_COMMAND_SPACING_US, SCD41_I2C_RETRIES});
+    i2cBus.configure(BusDevice::DISPLAY, {DISPLAY_I2C_CLOCK_HZ, 0, 0});
+    i2cBus.begin();
+}
+
+// Light sleep would stop the radio, so while the stack joins the wait is awake and notes when it got there
+void sensorSleep(uint32_t milliseconds)
+{
+    if (!zigbeeManager.isStarted())
+    {
+        powerManager.lightSleepMs(milliseconds);
+        return;
+    }
+
+    uint32_t start = millis();
+    while (!zigbeeManager.pollConnection() && millis() - start < milliseconds)
+    {
+        delay(std::min<uint32_t>(RADIO_POLL_MS, milliseconds - (millis() - start)));
+    }
+    uint32_t elapsed = millis() - start;
+    if (elapsed < milliseconds)
+    {
+        delay(milliseconds - elapsed);
+    }
+}
 
 void initializeHardware()
 {
     Serial.begin(115200);
-    Wire.begin(I2C_SDA, I2C_SCL);
+
+    // The stored tunables override the defaults the objects were built with
+    samplingScheduler.setNominalInterval(settings.getSamplingIntervalSeconds());
+    reportingPolicy.setThreshold(settings.getReportingDeltaCO2());
+
+    co2Sensor.setPowerDownMinSleep(SCD41_POWER_DOWN_MIN_SLEEP_SECONDS);
+    zigbeeManager.setClimateReportingDelta(REPORTING_DELTA_TEMPERATURE, REPORTING_DELTA_HUMIDITY);
+    co2Sensor.setSleepFunction(sensorSleep);
 
     pinMode(LED_BUILTIN, OUTPUT);
     digitalWrite(LED_BUILTIN, LOW); // Turn on LED to show we are awake
 }
 
-bool measure()
+uint32_t co2IntervalSeconds()
 {
-    if (!co2Sensor.startMeasurement())
+    return powerGovernor.samplingIntervalSeconds(samplingScheduler.intervalSeconds());
+}
+
+// Whether this shot will be uploaded whatever it reads. Extrapolating the last reading at the CO2 rate is no
+// guide: the sampling interval is sized so that the expected change per shot stays the same.
+bool uploadDue()
+{
+    return powerGovernor.tierChangePending() || sampleBuffer.size() + 1 >= UPLOAD_EVERY_N_SAMPLES;
+}
+
+// Sleeps through the start of the single shot, then starts the Zigbee stack so that it has joined by the
+// time the reading is ready. Starting earlier would only keep the receiver on waiting for the sensor.
+void startRadioDuringMeasurement()
+{
+    uint32_t leadMs = zigbeeManager.getTypicalConnectMs();
+    if (leadMs == 0 || !zigbeeManager.isReportingEnabled() || !powerGovernor.radioAllowed() ||
+        !radioBackoff.attemptAllowed(powerManager.getCurrentTimeMicros()))
     {
-        return false;
+        return;
+    }
+
+    uint32_t remainingMs = co2Sensor.getRemainingMeasurementMs();
+    if (remainingMs > leadMs)
+    {
+        powerManager.lightSleepMs(remainingMs - leadMs);
     }
 
-    powerManager.lightSleep(5);
+    trace(TraceEvent::UPLOAD_RADIO_AHEAD, static_cast<int32_t>(co2Sensor.getRemainingMeasurementMs()));
+    powerManager.beginPhase(EnergyPhase::RADIO_CONNECT);
+    radioAttemptPending = true;
+    zigbeeManager.initialize();
+}
 
-    while (!co2Sensor.isMeasurementReady())
+bool measure(bool radioAhead = false)
+{
+    powerManager.beginPhase(EnergyPhase::SENSOR_INIT);
+    co2Sensor.setSamplingInterval(samplingScheduler.averageIntervalSeconds());
+    if (!co2Sensor.initialize())
     {
-        log_d("Measurement not ready yet, waiting...");
-        delay(20);
+        return false;
+    }
+
+    powerManager.beginPhase(EnergyPhase::MEASURE);
+    if (!co2Sensor.startMeasurement())
+    {
+        return false;
+    }
+    if (radioAhead)
+    {
+        startRadioDuringMeasurement();
+    }
+    if (!co2Sensor.waitForMeasurement())
+    {
+        return false;
     }
 
     if (!co2Sensor.readMeasurement(co2, temp, rh))
     {
         return false;
     }
+    co2_shot_temp = temp;
+    co2_shot_rh = rh;
 
+    powerManager.beginPhase(EnergyPhase::BATTERY);
     batteryPercentage = powerManager.readBatteryPercentage();
     return true;
 }
 
+bool measureRHT()
+{
+    powerManager.beginPhase(EnergyPhase::SENSOR_INIT);
+    bool measured = co2Sensor.initialize();
+    if (measured)
+    {
+        powerManager.beginPhase(EnergyPhase::MEASURE);
+        uint16_t noCO2;
+        measured = co2Sensor.startMeasurement(MeasurementKind::RHT_ONLY) && co2Sensor.waitForMeasurement() &&
+                   co2Sensor.readMeasurement(noCO2, temp, rh);
+    }
+
+    // A failed shot is retried an interval later as well, not at once
+    prev_rht_time = powerManager.getCurrentTimeMicros();
+    return measured;
+}
+
+// A temperature or humidity step usually means a window opened or people came in, so CO2 is moving too
+bool climateChanged()
+{
+    if (co2_shot_temp == NO_VALUE)
+    {
+        return false;
+    }
+
+    float temperatureChange = fabsf(temp - co2_shot_temp);
+    float humidityChange = fabsf(rh - co2_shot_rh);
+    if (temperatureChange >= RHT_TRIGGER_TEMPERATURE || humidityChange >= RHT_TRIGGER_HUMIDITY)
+    {
+        trace(TraceEvent::CLIMATE_CHANGED, traceCenti(temperatureChange), traceCenti(humidityChange));
+        return true;
+    }
+    return false;
+}
+
 bool startAndConnectZigbee()
 {
+    powerManager.beginPhase(EnergyPhase::RADIO_CONNECT);
+    radioAttemptPending = true;
     if (!zigbeeManager.initialize())
     {
+        radioAttemptPending = false;
         return false;
     }
 
-    if (!zigbeeManager.connect())
+    bool connected = zigbeeManager.connect();
+    radioAttemptPending = false;
+    if (!connected)
     {
-        log_e("Zigbee connection failed! Rebooting...");
-        ESP.restart();
+        uint64_t now = powerManager.getCurrentTimeMicros();
+        radioBackoff.recordFailure(now);
+        log_e("Zigbee connection failed (%lu in a row), next attempt in %llu s",
+              static_cast<unsigned long>(radioBackoff.consecutiveFailures()),
+              (radioBackoff.nextAttemptMicros() - now) / 1000000ULL);
         return false;
     }
 
+    radioBackoff.recordSuccess();
+
+    if (Serial)
+    {
+        zigbeeManager.printConnectStats();
+    }
     return true;
 }
 
-void zigbeeReport()
+void bufferSample()
 {
-    zigbeeManager.reportSensorData(co2, batteryPercentage);
+    samplingScheduler.update(co2, prev_measurement_time);
+
+    Sample sample;
+    sample.timeSeconds = static_cast<uint32_t>(prev_measurement_time / 1000000ULL);
+    sample.co2 = co2;
+    sample.temperatureCenti = static_cast<int16_t>(lroundf(temp * 100.0f));
+    sample.humidityCenti = static_cast<uint16_t>(lroundf(rh * 100.0f));
+    sample.batteryPercentage = batteryPercentage;
+
+    uint32_t dropped = sampleBuffer.droppedCount();
+    sampleBuffer.push(sample);
+    if (sampleBuffer.droppedCount() != dropped)
+    {
+        trace(TraceEvent::SAMPLE_OVERWRITTEN, static_cast<int32_t>(sampleBuffer.droppedCount()));
+    }
 }
 
-#if !HEADLESS_MODE
-enum class ButtonPress
+bool shouldUpload()
 {
-    NONE,     // No action
-    NAVIGATE, // Short press - go to next menu item
-    SELECT    // Long press - select current menu item
-};
+    if (zigbeeManager.isStarted())
+    {
+        trace(TraceEvent::UPLOAD_RADIO_STARTED);
+        return true;
+    }
 
-enum class MenuItem
+    if (powerGovernor.tierChangePending())
+    {
+        trace(TraceEvent::UPLOAD_TIER_CHANGED, powerGovernor.tier());
+        return true;
+    }
+
+    if (reportingPolicy.shouldReport(co2, prev_measurement_time))
+    {
+        trace(TraceEvent::UPLOAD_CO2, co2);
+        return true;
+    }
+
+    if (sampleBuffer.size() >= UPLOAD_EVERY_N_SAMPLES)
+    {
+        trace(TraceEvent::UPLOAD_BUFFER_FULL, static_cast<int32_t>(sampleBuffer.size()));
+        return true;
+    }
+
+    trace(TraceEvent::BUFFERED, co2, static_cast<int32_t>(sampleBuffer.size()));
+    return false;
+}
+
+bool connectForUpload()
 {
-    REFRESH = 1,       // Take new measurement and report
-    BATTERY = 2,       // Show battery voltage and percentage
-    ZIGBEE_TOGGLE = 3, // Toggle Zigbee reporting on/off
-    ZIGBEE_ON = 4,     // Start radio and stay awake
-    EXIT = 5,          // Exit menu and go to sleep
-    MENU_COUNT = 6     // Total number of menu items
-};
+    if (!powerGovernor.radioAllowed())
+    {
+        trace(TraceEvent::RADIO_OFF, powerGovernor.tier(), static_cast<int32_t>(sampleBuffer.size()));
+        return false;
+    }
+
+    if (!radioBackoff.attemptAllowed(powerManager.getCurrentTimeMicros()))
+    {
+        trace(TraceEvent::RADIO_BACKING_OFF, static_cast<int32_t>(radioBackoff.consecutiveFailures()),
+              static_cast<int32_t>(sampleBuffer.size()));
+        return false;
+    }
+
+    return startAndConnectZigbee();
+}
 
-ButtonPress detectButtonPress()
+void reportBufferedSamples()
 {
-    pinMode(BTN_PIN, INPUT);
+    powerManager.beginPhase(EnergyPhase::REPORT);
 
-    uint32_t start = millis();
-    while (digitalRead(BTN_PIN) == LOW)
+    // Oldest first, in the order the coordinator files them. A sample leaves the buffer once its report is
+    // queued, so a session cut short sends nothing twice and a failed report keeps the rest for the next one.
+    Sample sent = {};
+    size_t count = 0;
+    while (count < UPLOAD_MAX_SAMPLES && !sampleBuffer.empty())
     {
-        if (millis() - start >= DISPLAY_TIMEOUT_SECONDS * 1000)
+        Sample sample = sampleBuffer.at(0);
+        if (!zigbeeManager.reportCO2(sample.co2))
         {
-            return ButtonPress::NONE;
+            break;
         }
+        sampleBuffer.removeOldest();
+        sent = sample;
+        count++;
     }
 
-    start = millis();
-    while (digitalRead(BTN_PIN) == HIGH)
+    if (count > 0)
     {
-        delay(10);
+        zigbeeManager.reportConditions(sent);
+        // What the consumer now knows: the newest value, arriving at the time of this session
+        reportingPolicy.reported(sent.co2, powerManager.getCurrentTimeMicros());
+        trace(TraceEvent::REPORTED_SAMPLES, static_cast<int32_t>(count), static_cast<int32_t>(sampleBuffer.size()));
+    }
 
-        if (millis() - start >= LONG_PRESS_MS)
-        {
-            return ButtonPress::SELECT;
-        }
+    if (powerGovernor.tierChangePending())
+    {
+        zigbeeManager.reportPowerTier(powerGovernor.tier());
+        powerGovernor.tierChangeReported();
+    }
+}
+
+void uploadSamples()
+{
+    if (connectForUpload())
+    {
+        reportBufferedSamples();
+    }
+}
+
+// Saves the settings and prints the statistics, without touching the I2C bus
+void saveStateForSleep()
+{
+    settings.commit();
+
+    if (Serial)
+    {
+        i2cBus.printStats();
+        co2Sensor.printStats();
+        wakeCycle.printStats();
+        powerManager.getCpuClock().printStats();
+        powerManager.getWakeScheduler().printStats();
+        traceFlush();
     }
+}
 
-    return ButtonPress::NAVIGATE;
+// Last chance to save state and to power down the sensor before a deep sleep
+void prepareForSleep(uint64_t nextCO2Micros)
+{
+    co2Sensor.prepareForSleep(nextCO2Micros / 1000000ULL);
+    powerManager.getEnergyMonitor().setSensorPoweredDown(co2Sensor.isPoweredDown());
+    saveStateForSleep();
 }
 
+#if !HEADLESS_MODE
+enum class MenuItem
+{
+    REFRESH = 1,       // Take new measurement and report
+    BATTERY = 2,       // Show battery voltage and percentage
+    ZIGBEE_TOGGLE = 3, // Toggle Zigbee reporting on/off
+    ZIGBEE_ON = 4,     // Start radio and stay awake for STAY_AWAKE_SECONDS
+    EXIT = 5,          // Exit menu and go to sleep
+    MENU_COUNT = 6     // Total number of menu items
+};
+
 bool executeMenuItem(MenuItem item)
 {
     switch (item)
@@ -156,29 +474,28 @@ bool executeMenuItem(MenuItem item)
         // Take new measurement and report
         display.showMeasurement(co2, temp, rh, "...");
 
-        if (measure())
+        if (measure(true)) // Uploaded whatever the reading
         {
             prev_measurement_time = powerManager.getCurrentTimeMicros();
+            powerManager.getWakeScheduler().measured(prev_measurement_time, co2IntervalSeconds(), false);
+            bufferSample();
+            powerManager.beginPhase(EnergyPhase::DISPLAY);
             display.showMeasurement(co2, temp, rh);
 
-            if (startAndConnectZigbee())
-            {
-                zigbeeReport();
-                last_reported_co2 = co2;
-            }
+            uploadSamples();
         }
         return true;
 
     case MenuItem::BATTERY:
     {
         // Show battery information
-        float voltage = powerManager.readBatteryVoltage();
+        float voltage = powerManager.readBatteryVoltage(true);
         batteryPercentage = powerManager.readBatteryPercentage();
 
         char batteryInfo[32];
         snprintf(batteryInfo, sizeof(batteryInfo), "%.4fV %d%%", voltage, batteryPercentage);
         display.showMeasurement(co2, temp, rh, batteryInfo);
-        delay(3000);
+        buttonInput.idle(3000);
     }
     break;
 
@@ -187,7 +504,7 @@ bool executeMenuItem(MenuItem item)
         zigbeeManager.toggleReporting();
         display.showMeasurement(co2, temp, rh,
                                 zigbeeManager.isReportingEnabled() ? "Zigbee: ON" : "Zigbee: OFF");
-        delay(2000);
+        buttonInput.idle(2000);
         break;
 
     case MenuItem::ZIGBEE_ON:
@@ -195,7 +512,7 @@ bool executeMenuItem(MenuItem item)
         if (!zigbeeManager.isReportingEnabled())
         {
             display.showMeasurement(co2, temp, rh, "Zigbee disabled!");
-            delay(2000);
+            buttonInput.idle(2000);
             break;
         }
 
@@ -205,11 +522,14 @@ bool executeMenuItem(MenuItem item)
             display.showMeasurement(co2, temp, rh, "Connected!");
             delay(3000);
 
+            // Light sleep would drop the radio, so wait for the press awake
             display.showMeasurement(co2, temp, rh, "Press to exit");
-            while (digitalRead(BTN_PIN) == LOW)
-            {
-                delay(10);
-            }
+            ButtonEvent event;
+            buttonInput.setLightSleep(false);
+            bool pressed = buttonInput.waitForEvent(event, STAY_AWAKE_SECONDS * 1000);
+            buttonInput.setLightSleep(true);
+            if (!pressed)
+                return true;
         }
         else
         {
@@ -220,11 +540,8 @@ bool executeMenuItem(MenuItem item)
 
     case MenuItem::EXIT:
         display.showMeasurement(co2, temp, rh, "Exiting...");
-        delay(1000);
-        while (digitalRead(BTN_PIN) == HIGH)
-        {
-            delay(10);
-        }
+        powerManager.lightSleepMs(1000);
+        return true;
 
     default:
         return true;
@@ -239,6 +556,7 @@ void openMenu()
     MenuItem item = static_cast<MenuItem>(currentMenuItem);
     while (true)
     {
+        powerManager.beginPhase(EnergyPhase::DISPLAY);
         switch (item)
         {
         case MenuItem::REFRESH:
@@ -250,11 +568,9 @@ void openMenu()
             break;
 
         case MenuItem::ZIGBEE_TOGGLE:
-        {
-            String zigbeeStatus = zigbeeManager.isReportingEnabled() ? "3. Zigbee: ON" : "3. Zigbee: OFF";
-            display.showMeasurement(co2, temp, rh, zigbeeStatus);
+            display.showMeasurement(co2, temp, rh,
+                                    zigbeeManager.isReportingEnabled() ? "3. Zigbee: ON" : "3. Zigbee: OFF");
             break;
-        }
 
         case MenuItem::ZIGBEE_ON:
             display.showMeasurement(co2, temp, rh, "4. Stay awake");
@@ -268,15 +584,20 @@ void openMenu()
             break;
         }
 
-        ButtonPress btnPress = detectButtonPress();
-        if (btnPress == ButtonPress::SELECT)
+        ButtonEvent event;
+        if (!buttonInput.waitForEvent(event, powerGovernor.displayTimeoutSeconds() * 1000))
+        {
+            return;
+        }
+
+        if (event.type == ButtonEventType::LONG_PRESS)
         {
             log_i("Selected menu item %d", currentMenuItem);
             bool exit = executeMenuItem(item);
             if (exit)
                 return;
         }
-        else if (btnPress == ButtonPress::NAVIGATE)
+        else
         {
             item = static_cast<MenuItem>(++currentMenuItem);
 
@@ -286,78 +607,226 @@ void openMenu()
                 currentMenuItem = 1;
             }
         }
-        else
-        {
-            return;
-        }
     }
 }
 
-void handleButtonWakeup()
+// The latest readings are in RTC memory, so they can be drawn before anything else is initialized
+void showLatestReadings()
 {
+    powerManager.beginPhase(EnergyPhase::DISPLAY);
     display.begin();
+    display.showMeasurement(co2, temp, rh);
     display.turnOn();
+}
 
+void handleButtonWakeup()
+{
+    powerManager.beginPhase(EnergyPhase::DISPLAY);
     if (displayOn)
     {
+        buttonInput.begin();
         openMenu();
+        // The button wakes from deep sleep while held
+        buttonInput.waitForRelease(powerGovernor.displayTimeoutSeconds() * 1000);
+        display.showMeasurement(co2, temp, rh);
     }
     else
     {
         displayOn = true;
     }
-
-    display.showMeasurement(co2, temp, rh);
-    powerManager.goToSleep(DISPLAY_TIMEOUT_SECONDS);
 }
 #endif // !HEADLESS_MODE
 
-void setup()
+WakeState boot()
 {
+#if !HEADLESS_MODE
+    // Someone is looking at the display, the rest of the boot happens behind it
+    wakeupReason = powerManager.getWakeupReason(displayOn);
+    if (wakeupReason == WakeupReason::BUTTON_PRESS)
+        showLatestReadings();
+#else  // HEADLESS_MODE
+    wakeupReason = powerManager.getWakeupReason(false);
+#endif // !HEADLESS_MODE
+    powerManager.getWakeScheduler().wokeUp(powerManager.getCurrentTimeMicros(),
+                                           wakeupReason == WakeupReason::MEASURE_TIMER ||
+                                               wakeupReason == WakeupReason::DISPLAY_TIMEOUT,
+                                           co2Sensor.needsDiscardShot());
+
     initializeHardware();
 
-#if !HEADLESS_MODE
-    WakeupReason wakeup_reason = powerManager.getWakeupReason(displayOn);
-    if (wakeup_reason == WakeupReason::BUTTON_PRESS)
-        handleButtonWakeup();
+    powerGovernor.update();
+    reportingPolicy.setThresholdScale(powerGovernor.reportingScale());
 
-    // If display was on, turn it off to save power
-    if (wakeup_reason == WakeupReason::DISPLAY_TIMEOUT)
+    switch (wakeupReason)
     {
+    // Normal measurement on power on or timer wakeup
+    case WakeupReason::POWER_ON:
+    case WakeupReason::MEASURE_TIMER:
+        return WakeState::SENSE;
+
+#if !HEADLESS_MODE
+    case WakeupReason::BUTTON_PRESS:
+        return WakeState::MENU;
+
+    // If display was on, turn it off to save power. The schedule waited for it, so CO2 may be due.
+    case WakeupReason::DISPLAY_TIMEOUT:
+        powerManager.beginPhase(EnergyPhase::DISPLAY);
         display.begin();
         display.turnOff();
         displayOn = false;
+        if (powerManager.getWakeScheduler().overdue(powerManager.getCurrentTimeMicros(), co2IntervalSeconds(),
+                                                    co2Sensor.needsDiscardShot()))
+        {
+            trace(TraceEvent::CO2_OVERDUE);
+            return WakeState::SENSE;
+        }
+        return WakeState::SLEEP;
+#endif // !HEADLESS_MODE
+
+    default:
+        return WakeState::SLEEP;
     }
-#else  // HEADLESS_MODE
-    WakeupReason wakeup_reason = powerManager.getWakeupReason(false);
+}
+
+WakeState sense()
+{
+    MeasurementKind kind = wakeupReason == WakeupReason::MEASURE_TIMER ? next_measurement : MeasurementKind::CO2;
+    if (kind == MeasurementKind::RHT_ONLY && measureRHT() && climateChanged())
+    {
+        kind = MeasurementKind::CO2;
+    }
+
+    if (kind != MeasurementKind::CO2)
+    {
+        return WakeState::SLEEP;
+    }
+    if (!measure(uploadDue()))
+    {
+        powerManager.getWakeScheduler().failed(powerManager.getCurrentTimeMicros(), co2IntervalSeconds());
+        return WakeState::SLEEP;
+    }
+
+    prev_measurement_time = powerManager.getCurrentTimeMicros();
+    // Before the sampling interval moves with this reading, it was scheduled with the current one
+    powerManager.getWakeScheduler().measured(prev_measurement_time, co2IntervalSeconds(),
+                                             wakeupReason == WakeupReason::MEASURE_TIMER &&
+                                                 next_measurement == MeasurementKind::CO2);
+    bufferSample();
+    return WakeState::DECIDE;
+}
+
+WakeState runState(WakeState state)
+{
+    switch (state)
+    {
+    case WakeState::BOOT:
+        return boot();
+    case WakeState::SENSE:
+        return sense();
+    case WakeState::DECIDE:
+        return shouldUpload() ? WakeState::RADIO : WakeState::SLEEP;
+    case WakeState::RADIO:
+        return connectForUpload() ? WakeState::REPORT : WakeState::SLEEP;
+    case WakeState::REPORT:
+        reportBufferedSamples();
+        return WakeState::SLEEP;
+#if !HEADLESS_MODE
+    case WakeState::MENU:
+        handleButtonWakeup();
+        return WakeState::SLEEP;
 #endif // !HEADLESS_MODE
+    default:
+        return WakeState::SLEEP;
+    }
+}
 
-    // Normal measurement on power on or timer wakeup
-    if (wakeup_reason == WakeupReason::POWER_ON || wakeup_reason == WakeupReason::MEASURE_TIMER)
+// Until the display times out while it is on, else until the next CO2 reading is due
+uint64_t untilNextCO2Micros()
+{
+#if !HEADLESS_MODE
+    if (displayOn)
     {
-        if (measure())
-        {
-            prev_measurement_time = powerManager.getCurrentTimeMicros();
-            auto abs_diff = abs(co2 - last_reported_co2);
+        return powerGovernor.displayTimeoutSeconds() * 1000000ULL;
+    }
+#endif // !HEADLESS_MODE
 
-            if (abs_diff < REPORTING_DELTA_CO2)
-            {
-                log_i("CO2 change (%d ppm) less than reporting delta (%d ppm), skipping report.",
-                      abs_diff, REPORTING_DELTA_CO2);
-            }
-            else
-            {
-                if (startAndConnectZigbee())
-                {
-                    zigbeeReport();
-                    last_reported_co2 = co2;
-                }
-            }
-        }
+    return powerManager.getWakeScheduler().untilDue(powerManager.getCurrentTimeMicros(), co2IntervalSeconds());
+}
+
+// Until the display times out while it is on, else until the wakeup for the next measurement
+uint64_t sleepMicros()
+{
+#if !HEADLESS_MODE
+    if (displayOn)
+    {
+        return powerGovernor.displayTimeoutSeconds() * 1000000ULL;
+    }
+#endif // !HEADLESS_MODE
+
+    return powerManager.calculateNextWakeup(co2IntervalSeconds(), prev_measurement_time,
+                                            powerGovernor.rhtIntervalSeconds(), prev_rht_time,
+                                            co2Sensor.needsDiscardShot(), next_measurement);
+}
+
+// sleepMicros() without the traces: the next wakeup takes the CO2 reading when it is due
+uint64_t forcedSleepMicros()
+{
+#if !HEADLESS_MODE
+    if (displayOn)
+    {
+        return powerGovernor.displayTimeoutSeconds() * 1000000ULL;
     }
-    // Calculate next wakeup and go to sleep
-    uint64_t next_wakeup = powerManager.calculateNextWakeup(CO2_SAMPLING_INTERVAL_SECONDS, prev_measurement_time);
-    powerManager.goToSleepUntil(next_wakeup);
+#endif // !HEADLESS_MODE
+
+    next_measurement = MeasurementKind::CO2;
+    uint64_t untilDue = powerManager.getWakeScheduler().untilDue(powerManager.getCurrentTimeMicros(), co2IntervalSeconds());
+    return powerManager.getWakeScheduler().sleepFor(untilDue, co2Sensor.needsDiscardShot());
+}
+
+// Runs in the esp_timer task when a state overran its budget. The stuck state may hold the I2C bus, the trace
+// ring or an NVS commit, so only RTC memory is written: no trace, log or Serial output, and the settings are
+// committed by a later cycle. Sleeps long enough that a hang does not come straight back.
+void forceSleep(WakeState state)
+{
+    // Also a radio started ahead of the measurement, whichever state hung
+    if (radioAttemptPending)
+    {
+        radioBackoff.recordFailure(powerManager.getCurrentTimeMicros());
+    }
+    if (state == WakeState::SENSE)
+    {
+        powerManager.getWakeScheduler().failed(powerManager.getCurrentTimeMicros(), co2IntervalSeconds());
+    }
+    // These states drive the sensor and may have stopped between its commands, so the next cycle wakes it
+    // and powers it down again
+    if (state == WakeState::SENSE || state == WakeState::MENU || state == WakeState::SLEEP)
+    {
+        co2Sensor.markInterrupted();
+    }
+
+    powerManager.getEnergyMonitor().setSensorPoweredDown(co2Sensor.isPoweredDown());
+
+    uint64_t next_wakeup = std::max<uint64_t>(forcedSleepMicros(), FORCED_SLEEP_MIN_SECONDS * 1000000ULL);
+    powerManager.forceSleepUntil(next_wakeup);
+}
+
+void setup()
+{
+    powerManager.getCpuClock().begin();
+    initializeBus();
+    wakeCycle.begin(forceSleep);
+
+    WakeState state = WakeState::BOOT;
+    while (state != WakeState::SLEEP)
+    {
+        wakeCycle.enter(state);
+        state = runState(state);
+    }
+
+    // Calculate next wakeup and go to sleep; the wakeup depends on whether the sensor powers down
+    wakeCycle.enter(WakeState::SLEEP);
+    prepareForSleep(untilNextCO2Micros());
+    powerManager.goToSleepUntil(sleepMicros());
 }
 
 void loop() {}
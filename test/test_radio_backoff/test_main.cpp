@@ -0,0 +1,85 @@
+#include <unity.h>
+#include <string.h>
+#include "HostSim.h"
+#include "RadioBackoff.h"
+
+static const uint64_t S = hostsim::US_PER_S;
+static const uint32_t BASE_S = 300;
+static const uint32_t MAX_S = 2 * 3600;
+
+static RadioBackoff backoff(BASE_S, MAX_S);
+static uint8_t pristineRtc[hostsim::RTC_IMAGE_MAX];
+
+void setUp()
+{
+    // Power-on values, as after a reset
+    memcpy(hostsim::rtcSection(), pristineRtc, hostsim::rtcSectionSize());
+}
+
+void tearDown()
+{
+}
+
+void test_attempt_allowed_before_any_failure()
+{
+    TEST_ASSERT_TRUE(backoff.attemptAllowed(0));
+    TEST_ASSERT_EQUAL_UINT32(0, backoff.consecutiveFailures());
+}
+
+void test_first_failure_waits_the_base_time()
+{
+    backoff.recordFailure(1000 * S);
+    TEST_ASSERT_EQUAL_UINT32(1, backoff.consecutiveFailures());
+    TEST_ASSERT_FALSE(backoff.attemptAllowed((1000 + BASE_S) * S - 1));
+    TEST_ASSERT_TRUE(backoff.attemptAllowed((1000 + BASE_S) * S));
+}
+
+void test_each_failure_doubles_the_wait_up_to_the_cap()
+{
+    const uint32_t expectedS[] = {300, 600, 1200, 2400, 4800, MAX_S, MAX_S};
+    uint64_t now = 1000 * S;
+    for (uint32_t waitS : expectedS)
+    {
+        backoff.recordFailure(now);
+        TEST_ASSERT_EQUAL_UINT64(now + waitS * S, backoff.nextAttemptMicros());
+        now = backoff.nextAttemptMicros();
+    }
+}
+
+void test_wait_stays_capped_after_many_failures()
+{
+    uint64_t now = 1000 * S;
+    for (int i = 0; i < 40; i++)
+    {
+        backoff.recordFailure(now);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT64(now + MAX_S * S, backoff.nextAttemptMicros());
+    }
+    TEST_ASSERT_EQUAL_UINT32(40, backoff.consecutiveFailures());
+    TEST_ASSERT_EQUAL_UINT64(now + MAX_S * S, backoff.nextAttemptMicros());
+}
+
+void test_success_resets_the_backoff()
+{
+    backoff.recordFailure(1000 * S);
+    backoff.recordFailure(1300 * S);
+    backoff.recordSuccess();
+    TEST_ASSERT_EQUAL_UINT32(0, backoff.consecutiveFailures());
+    TEST_ASSERT_TRUE(backoff.attemptAllowed(1300 * S));
+
+    backoff.recordFailure(2000 * S);
+    TEST_ASSERT_EQUAL_UINT64((2000 + BASE_S) * S, backoff.nextAttemptMicros());
+}
+
+int main()
+{
+    memcpy(pristineRtc, hostsim::rtcSection(), hostsim::rtcSectionSize());
+    hostsim::resetForBoot();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_attempt_allowed_before_any_failure);
+    RUN_TEST(test_first_failure_waits_the_base_time);
+    RUN_TEST(test_each_failure_doubles_the_wait_up_to_the_cap);
+    RUN_TEST(test_wait_stays_capped_after_many_failures);
+    RUN_TEST(test_success_resets_the_backoff);
+    return UNITY_END();
+}
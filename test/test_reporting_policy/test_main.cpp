@@ -0,0 +1,131 @@
+#include <unity.h>
+#include <string.h>
+#include "HostSim.h"
+#include "ReportingPolicy.h"
+
+static const uint64_t S = hostsim::US_PER_S;
+
+static uint8_t pristineRtc[hostsim::RTC_IMAGE_MAX];
+
+void setUp()
+{
+    // Power-on values: nothing reported yet
+    memcpy(hostsim::rtcSection(), pristineRtc, hostsim::rtcSectionSize());
+}
+
+void tearDown()
+{
+}
+
+void test_first_reading_is_always_reported()
+{
+    DeltaReportingPolicy delta(40);
+    PredictiveReportingPolicy predictive(30, 40);
+    TEST_ASSERT_FALSE(delta.hasReported());
+    TEST_ASSERT_TRUE(delta.shouldReport(450, 100 * S));
+    TEST_ASSERT_TRUE(predictive.shouldReport(450, 100 * S));
+}
+
+void test_delta_reports_a_change_of_the_delta_either_way()
+{
+    DeltaReportingPolicy policy(40);
+    policy.reported(500, 100 * S);
+    TEST_ASSERT_FALSE(policy.shouldReport(539, 200 * S));
+    TEST_ASSERT_TRUE(policy.shouldReport(540, 200 * S));
+    TEST_ASSERT_FALSE(policy.shouldReport(461, 200 * S));
+    TEST_ASSERT_TRUE(policy.shouldReport(460, 200 * S));
+}
+
+void test_delta_follows_its_threshold_and_scale()
+{
+    DeltaReportingPolicy policy(40);
+    policy.reported(500, 100 * S);
+
+    policy.setThresholdScale(2.0f);
+    TEST_ASSERT_FALSE(policy.shouldReport(579, 200 * S));
+    TEST_ASSERT_TRUE(policy.shouldReport(580, 200 * S));
+
+    policy.setThresholdScale(1.0f);
+    policy.setThreshold(20);
+    TEST_ASSERT_TRUE(policy.shouldReport(520, 200 * S));
+}
+
+void test_prediction_extrapolates_the_last_two_reports()
+{
+    PredictiveReportingPolicy policy(30, 40);
+    policy.reported(500, 1000 * S);
+    TEST_ASSERT_EQUAL_FLOAT(500.0f, policy.predictedCO2(2000 * S));
+
+    // 0.1 ppm/s
+    policy.reported(560, 1600 * S);
+    TEST_ASSERT_EQUAL_UINT16(560, policy.lastReportedCO2());
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 560.0f, policy.predictedCO2(1600 * S));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 590.0f, policy.predictedCO2(1900 * S));
+}
+
+void test_prediction_holds_after_an_hour_and_stays_positive()
+{
+    PredictiveReportingPolicy policy(30, 40);
+    policy.reported(500, 1000 * S);
+    policy.reported(560, 1600 * S);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 920.0f, policy.predictedCO2((1600 + 3600) * S));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 920.0f, policy.predictedCO2((1600 + 7200) * S));
+
+    // Falling fast enough to cross zero within the hour
+    policy.reported(100, 2200 * S);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, policy.predictedCO2((2200 + 3600) * S));
+}
+
+void test_predictive_reports_a_reading_outside_the_band()
+{
+    PredictiveReportingPolicy policy(30, 0);
+    policy.reported(500, 1000 * S);
+    policy.reported(560, 1600 * S);
+
+    // Predicted 590 ppm
+    TEST_ASSERT_FALSE(policy.shouldReport(585, 1900 * S));
+    TEST_ASSERT_FALSE(policy.shouldReport(561, 1900 * S));
+    TEST_ASSERT_TRUE(policy.shouldReport(560, 1900 * S));
+    TEST_ASSERT_TRUE(policy.shouldReport(620, 1900 * S));
+}
+
+void test_predictive_follows_a_drift_along_the_prediction()
+{
+    // Without a hold limit, for consumers that extrapolate
+    PredictiveReportingPolicy policy(30, 0);
+    policy.reported(500, 1000 * S);
+    policy.reported(560, 1600 * S);
+    TEST_ASSERT_FALSE(policy.shouldReport(680, 2800 * S));
+}
+
+void test_hold_limit_reports_a_drift_within_the_band()
+{
+    PredictiveReportingPolicy policy(30, 40);
+    policy.reported(500, 1000 * S);
+    policy.reported(560, 1600 * S);
+
+    // Predicted 590 and 620 ppm, off the last report by 25 and 55 ppm
+    TEST_ASSERT_FALSE(policy.shouldReport(585, 1900 * S));
+    TEST_ASSERT_TRUE(policy.shouldReport(615, 2200 * S));
+
+    policy.setThresholdScale(2.0f);
+    TEST_ASSERT_FALSE(policy.shouldReport(615, 2200 * S));
+    TEST_ASSERT_TRUE(policy.shouldReport(640, 2200 * S));
+}
+
+int main()
+{
+    memcpy(pristineRtc, hostsim::rtcSection(), hostsim::rtcSectionSize());
+    hostsim::resetForBoot();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_first_reading_is_always_reported);
+    RUN_TEST(test_delta_reports_a_change_of_the_delta_either_way);
+    RUN_TEST(test_delta_follows_its_threshold_and_scale);
+    RUN_TEST(test_prediction_extrapolates_the_last_two_reports);
+    RUN_TEST(test_prediction_holds_after_an_hour_and_stays_positive);
+    RUN_TEST(test_predictive_reports_a_reading_outside_the_band);
+    RUN_TEST(test_predictive_follows_a_drift_along_the_prediction);
+    RUN_TEST(test_hold_limit_reports_a_drift_within_the_band);
+    return UNITY_END();
+}
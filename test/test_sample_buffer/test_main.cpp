@@ -0,0 +1,99 @@
+#include <unity.h>
+#include "SampleBuffer.h"
+
+// As an RTC_DATA_ATTR instance starts at power-on
+static SampleBuffer buffer;
+
+static Sample sample(uint16_t co2)
+{
+    Sample s = {};
+    s.timeSeconds = co2 * 60u;
+    s.co2 = co2;
+    return s;
+}
+
+void setUp()
+{
+    buffer = SampleBuffer();
+}
+
+void tearDown()
+{
+}
+
+void test_empty_at_power_on()
+{
+    TEST_ASSERT_TRUE(buffer.empty());
+    TEST_ASSERT_EQUAL_UINT32(0, buffer.size());
+    TEST_ASSERT_EQUAL_UINT32(0, buffer.droppedCount());
+}
+
+void test_samples_come_out_oldest_first()
+{
+    for (uint16_t i = 1; i <= 3; i++)
+        buffer.push(sample(i));
+
+    TEST_ASSERT_EQUAL_UINT32(3, buffer.size());
+    TEST_ASSERT_EQUAL_UINT16(1, buffer.at(0).co2);
+    TEST_ASSERT_EQUAL_UINT16(2, buffer.at(1).co2);
+    TEST_ASSERT_EQUAL_UINT16(3, buffer.newest().co2);
+    TEST_ASSERT_EQUAL_UINT32(180, buffer.newest().timeSeconds);
+}
+
+void test_full_buffer_overwrites_the_oldest_and_counts_it()
+{
+    for (uint16_t i = 0; i < SAMPLE_BUFFER_CAPACITY + 5; i++)
+        buffer.push(sample(i));
+
+    TEST_ASSERT_TRUE(buffer.full());
+    TEST_ASSERT_EQUAL_UINT32(SAMPLE_BUFFER_CAPACITY, buffer.size());
+    TEST_ASSERT_EQUAL_UINT32(5, buffer.droppedCount());
+    TEST_ASSERT_EQUAL_UINT16(5, buffer.at(0).co2);
+    TEST_ASSERT_EQUAL_UINT16(SAMPLE_BUFFER_CAPACITY + 4, buffer.newest().co2);
+    for (size_t i = 0; i < buffer.size(); i++)
+        TEST_ASSERT_EQUAL_UINT16(5 + i, buffer.at(i).co2);
+}
+
+void test_remove_oldest_across_the_wrap()
+{
+    for (uint16_t i = 0; i < SAMPLE_BUFFER_CAPACITY + 5; i++)
+        buffer.push(sample(i));
+
+    for (uint16_t expected = 5; !buffer.empty(); expected++)
+    {
+        TEST_ASSERT_EQUAL_UINT16(expected, buffer.at(0).co2);
+        buffer.removeOldest();
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, buffer.size());
+
+    // Nothing to remove, and the drops since power-on are kept
+    buffer.removeOldest();
+    TEST_ASSERT_TRUE(buffer.empty());
+    TEST_ASSERT_EQUAL_UINT32(5, buffer.droppedCount());
+}
+
+void test_removed_slots_are_reused_without_drops()
+{
+    for (uint16_t i = 0; i < SAMPLE_BUFFER_CAPACITY; i++)
+        buffer.push(sample(i));
+    buffer.removeOldest();
+    buffer.removeOldest();
+
+    buffer.push(sample(1000));
+    buffer.push(sample(1001));
+    TEST_ASSERT_TRUE(buffer.full());
+    TEST_ASSERT_EQUAL_UINT32(0, buffer.droppedCount());
+    TEST_ASSERT_EQUAL_UINT16(2, buffer.at(0).co2);
+    TEST_ASSERT_EQUAL_UINT16(1001, buffer.newest().co2);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_at_power_on);
+    RUN_TEST(test_samples_come_out_oldest_first);
+    RUN_TEST(test_full_buffer_overwrites_the_oldest_and_counts_it);
+    RUN_TEST(test_remove_oldest_across_the_wrap);
+    RUN_TEST(test_removed_slots_are_reused_without_drops);
+    return UNITY_END();
+}
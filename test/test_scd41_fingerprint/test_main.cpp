@@ -0,0 +1,94 @@
+#include <unity.h>
+#include "CO2Sensor.h"
+
+static const Scd41Config CONFIG = {1, 400, 44, 156, 1.5f};
+static const uint64_t SERIAL_NUMBER = 0x123456789abcULL;
+
+static uint32_t fingerprint(const Scd41Config &config, uint64_t serialNumber = SERIAL_NUMBER)
+{
+    return CO2Sensor::configurationFingerprint(config, serialNumber);
+}
+
+static Scd41Config withOffset(float temperatureOffset)
+{
+    Scd41Config config = CONFIG;
+    config.temperatureOffset = temperatureOffset;
+    return config;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_same_configuration_same_fingerprint()
+{
+    constexpr uint32_t atCompileTime = CO2Sensor::configurationFingerprint(CONFIG, SERIAL_NUMBER);
+    TEST_ASSERT_EQUAL_HEX32(atCompileTime, fingerprint(CONFIG));
+    TEST_ASSERT_NOT_EQUAL_UINT32(0, fingerprint(CONFIG));
+}
+
+void test_every_field_changes_the_fingerprint()
+{
+    uint32_t reference = fingerprint(CONFIG);
+    Scd41Config config;
+
+    config = CONFIG;
+    config.ascEnabled = 0;
+    TEST_ASSERT_NOT_EQUAL_UINT32(reference, fingerprint(config));
+
+    config = CONFIG;
+    config.ascTarget = 420;
+    TEST_ASSERT_NOT_EQUAL_UINT32(reference, fingerprint(config));
+
+    config = CONFIG;
+    config.ascInitialPeriod = 45;
+    TEST_ASSERT_NOT_EQUAL_UINT32(reference, fingerprint(config));
+
+    config = CONFIG;
+    config.ascStandardPeriod = 157;
+    TEST_ASSERT_NOT_EQUAL_UINT32(reference, fingerprint(config));
+
+    // The initial and standard periods are not interchangeable
+    config = CONFIG;
+    config.ascInitialPeriod = CONFIG.ascStandardPeriod;
+    config.ascStandardPeriod = CONFIG.ascInitialPeriod;
+    TEST_ASSERT_NOT_EQUAL_UINT32(reference, fingerprint(config));
+}
+
+void test_every_serial_number_word_changes_the_fingerprint()
+{
+    uint32_t reference = fingerprint(CONFIG);
+    TEST_ASSERT_NOT_EQUAL_UINT32(reference, fingerprint(CONFIG, SERIAL_NUMBER ^ (1ULL << 40)));
+    TEST_ASSERT_NOT_EQUAL_UINT32(reference, fingerprint(CONFIG, SERIAL_NUMBER ^ (1ULL << 20)));
+    TEST_ASSERT_NOT_EQUAL_UINT32(reference, fingerprint(CONFIG, SERIAL_NUMBER ^ 1ULL));
+}
+
+void test_temperature_offset_resolves_hundredths()
+{
+    TEST_ASSERT_NOT_EQUAL_UINT32(fingerprint(withOffset(1.5f)), fingerprint(withOffset(1.51f)));
+    TEST_ASSERT_NOT_EQUAL_UINT32(fingerprint(withOffset(0.0f)), fingerprint(withOffset(0.01f)));
+    TEST_ASSERT_NOT_EQUAL_UINT32(fingerprint(withOffset(0.5f)), fingerprint(withOffset(-0.5f)));
+}
+
+void test_temperature_offset_rounds_to_hundredths()
+{
+    TEST_ASSERT_EQUAL_HEX32(fingerprint(withOffset(1.5f)), fingerprint(withOffset(1.504f)));
+    TEST_ASSERT_EQUAL_HEX32(fingerprint(withOffset(1.5f)), fingerprint(withOffset(1.496f)));
+    TEST_ASSERT_EQUAL_HEX32(fingerprint(withOffset(-1.5f)), fingerprint(withOffset(-1.504f)));
+    TEST_ASSERT_EQUAL_HEX32(fingerprint(withOffset(-1.5f)), fingerprint(withOffset(-1.496f)));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_same_configuration_same_fingerprint);
+    RUN_TEST(test_every_field_changes_the_fingerprint);
+    RUN_TEST(test_every_serial_number_word_changes_the_fingerprint);
+    RUN_TEST(test_temperature_offset_resolves_hundredths);
+    RUN_TEST(test_temperature_offset_rounds_to_hundredths);
+    return UNITY_END();
+}
@@ -0,0 +1,185 @@
+#include <unity.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "HostSim.h"
+#include "PowerManager.h"
+#include "RadioBackoff.h"
+#include "WakeCycle.h"
+
+// The firmware's own, in main.cpp
+extern WakeCycle wakeCycle;
+extern RadioBackoff radioBackoff;
+extern bool radioAttemptPending;
+void forceSleep(WakeState state);
+
+static const uint32_t BUDGETS_MS[] = {100, 2000, 50, 1200, 200, 3000, 100};
+static_assert(sizeof(BUDGETS_MS) / sizeof(BUDGETS_MS[0]) == static_cast<size_t>(WakeState::COUNT),
+              "one budget per wake state");
+
+static PowerManager power(0);
+static WakeCycle cycle(power, BUDGETS_MS);
+static uint8_t pristineRtc[hostsim::RTC_IMAGE_MAX];
+static WakeState missedState;
+static int misses;
+
+static void recordMiss(WakeState state)
+{
+    missedState = state;
+    misses++;
+}
+
+// Runs body as one boot in a child, like the host runner, and returns once the child is gone. The RTC memory
+// it slept with is loaded back, as the next boot would find it.
+static void runBoot(void (*body)())
+{
+    hostsim::World &w = hostsim::world();
+    w.exitKind = hostsim::ExitKind::NONE;
+    fflush(stdout);
+
+    pid_t pid = fork();
+    TEST_ASSERT_TRUE(pid >= 0);
+    if (pid == 0)
+    {
+        hostsim::resetForBoot();
+        body();
+        _exit(1); // did not sleep
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    TEST_ASSERT_TRUE(WIFEXITED(status));
+    TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+    memcpy(hostsim::rtcSection(), w.rtcImage, w.rtcSize);
+}
+
+// Enters state and waits longer than any budget, for the deadline to force the sleep
+static void hangIn(WakeState state)
+{
+    wakeCycle.begin(forceSleep);
+    wakeCycle.enter(state);
+    for (int i = 0; i < 600; i++)
+        hostsim::advanceMs(1000);
+}
+
+void setUp()
+{
+    // Power-on values, as after a reset
+    memcpy(hostsim::rtcSection(), pristineRtc, hostsim::rtcSectionSize());
+    missedState = WakeState::COUNT;
+    misses = 0;
+}
+
+void tearDown()
+{
+}
+
+void test_state_over_its_budget_calls_the_handler()
+{
+    cycle.enter(WakeState::SENSE);
+    hostsim::advanceMs(1999);
+    TEST_ASSERT_EQUAL_INT(0, misses);
+
+    hostsim::advanceMs(1);
+    TEST_ASSERT_EQUAL_INT(1, misses);
+    TEST_ASSERT_TRUE(missedState == WakeState::SENSE);
+}
+
+void test_handler_runs_once_per_miss()
+{
+    cycle.enter(WakeState::REPORT);
+    hostsim::advanceMs(5000);
+    TEST_ASSERT_EQUAL_INT(1, misses);
+    TEST_ASSERT_TRUE(missedState == WakeState::REPORT);
+}
+
+void test_each_state_runs_on_its_own_budget()
+{
+    // Past the 50 ms of DECIDE, well within the 1200 ms of RADIO
+    cycle.enter(WakeState::DECIDE);
+    hostsim::advanceMs(40);
+    cycle.enter(WakeState::RADIO);
+    hostsim::advanceMs(1100);
+    TEST_ASSERT_EQUAL_INT(0, misses);
+
+    hostsim::advanceMs(100);
+    TEST_ASSERT_EQUAL_INT(1, misses);
+    TEST_ASSERT_TRUE(missedState == WakeState::RADIO);
+
+    // A short budget after a long one
+    cycle.enter(WakeState::MENU);
+    hostsim::advanceMs(2900);
+    cycle.enter(WakeState::SLEEP);
+    hostsim::advanceMs(99);
+    TEST_ASSERT_EQUAL_INT(1, misses);
+    hostsim::advanceMs(1);
+    TEST_ASSERT_EQUAL_INT(2, misses);
+    TEST_ASSERT_TRUE(missedState == WakeState::SLEEP);
+}
+
+void test_state_left_in_time_is_not_missed()
+{
+    for (size_t i = 0; i < static_cast<size_t>(WakeState::COUNT); i++)
+    {
+        cycle.enter(static_cast<WakeState>(i));
+        hostsim::advanceMs(BUDGETS_MS[i] - 1);
+    }
+    cycle.enter(WakeState::BOOT);
+    hostsim::advanceMs(50);
+    TEST_ASSERT_EQUAL_INT(0, misses);
+
+    // The next test starts with a fresh budget
+    cycle.enter(WakeState::MENU);
+}
+
+void test_forced_sleep_sleeps_at_least_the_minimum()
+{
+    runBoot([]() { hangIn(WakeState::SENSE); });
+
+    hostsim::World &w = hostsim::world();
+    TEST_ASSERT_TRUE(w.exitKind == hostsim::ExitKind::DEEP_SLEEP);
+    TEST_ASSERT_TRUE(w.timerArmed);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT64(60 * hostsim::US_PER_S, w.timerUs);
+}
+
+void test_forced_sleep_counts_a_pending_radio_attempt_as_failed()
+{
+    // A radio started ahead of the measurement, hung in SENSE
+    runBoot([]() {
+        radioAttemptPending = true;
+        hangIn(WakeState::SENSE);
+    });
+    TEST_ASSERT_EQUAL_UINT32(1, radioBackoff.consecutiveFailures());
+
+    runBoot([]() {
+        radioAttemptPending = true;
+        hangIn(WakeState::RADIO);
+    });
+    TEST_ASSERT_EQUAL_UINT32(2, radioBackoff.consecutiveFailures());
+}
+
+void test_forced_sleep_without_radio_leaves_the_backoff_alone()
+{
+    runBoot([]() { hangIn(WakeState::SENSE); });
+    TEST_ASSERT_EQUAL_UINT32(0, radioBackoff.consecutiveFailures());
+}
+
+int main()
+{
+    // Shared with the forked boots
+    hostsim::World &w = hostsim::world();
+    w.rtcSize = hostsim::rtcSectionSize();
+    memcpy(pristineRtc, hostsim::rtcSection(), w.rtcSize);
+    hostsim::resetForBoot();
+    cycle.begin(recordMiss);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_state_over_its_budget_calls_the_handler);
+    RUN_TEST(test_handler_runs_once_per_miss);
+    RUN_TEST(test_each_state_runs_on_its_own_budget);
+    RUN_TEST(test_state_left_in_time_is_not_missed);
+    RUN_TEST(test_forced_sleep_sleeps_at_least_the_minimum);
+    RUN_TEST(test_forced_sleep_counts_a_pending_radio_attempt_as_failed);
+    RUN_TEST(test_forced_sleep_without_radio_leaves_the_backoff_alone);
+    return UNITY_END();
+}
@@ -0,0 +1,112 @@
+#include <unity.h>
+#include <string.h>
+#include "HostSim.h"
+#include "PowerManager.h"
+#include "WakeScheduler.h"
+
+static const uint64_t S = hostsim::US_PER_S;
+static const uint32_t INTERVAL_S = 900;
+
+static PowerManager power(0);
+static WakeScheduler scheduler(MIN_SLEEP_MS);
+static uint8_t pristineRtc[hostsim::RTC_IMAGE_MAX];
+
+void setUp()
+{
+    // Power-on values, as after a reset
+    memcpy(hostsim::rtcSection(), pristineRtc, hostsim::rtcSectionSize());
+    hostsim::world().nowUs = 0;
+    hostsim::resetForBoot();
+}
+
+void tearDown()
+{
+}
+
+void test_first_reading_is_due_at_once()
+{
+    TEST_ASSERT_EQUAL_UINT64(0, scheduler.untilDue(5 * S, INTERVAL_S));
+}
+
+void test_reading_is_due_one_interval_after_the_slot()
+{
+    scheduler.measured(1000 * S, INTERVAL_S, true);
+    TEST_ASSERT_EQUAL_UINT64(INTERVAL_S * S, scheduler.untilDue(1000 * S, INTERVAL_S));
+    TEST_ASSERT_EQUAL_UINT64(800 * S, scheduler.untilDue(1100 * S, INTERVAL_S));
+}
+
+void test_overdue_reading_is_due_now_without_wrapping()
+{
+    scheduler.measured(1000 * S, INTERVAL_S, true);
+    TEST_ASSERT_EQUAL_UINT64(0, scheduler.untilDue(1900 * S, INTERVAL_S));
+    TEST_ASSERT_EQUAL_UINT64(0, scheduler.untilDue(1900 * S + 1, INTERVAL_S));
+    TEST_ASSERT_EQUAL_UINT64(0, scheduler.untilDue(100000 * S, INTERVAL_S));
+}
+
+void test_grid_continues_from_the_slot_a_late_reading_landed_in()
+{
+    scheduler.measured(1000 * S, INTERVAL_S, true);
+    // Two slots missed behind a forced sleep
+    scheduler.measured(3710 * S, INTERVAL_S, true);
+    TEST_ASSERT_EQUAL_UINT64(890 * S, scheduler.untilDue(3710 * S, INTERVAL_S));
+}
+
+void test_extra_reading_before_the_slot_leaves_the_grid_alone()
+{
+    scheduler.measured(1000 * S, INTERVAL_S, true);
+    scheduler.measured(1300 * S, INTERVAL_S, false);
+    TEST_ASSERT_EQUAL_UINT64(500 * S, scheduler.untilDue(1400 * S, INTERVAL_S));
+}
+
+void test_failed_reading_gives_up_its_slot()
+{
+    scheduler.measured(1000 * S, INTERVAL_S, true);
+    scheduler.failed(1905 * S, INTERVAL_S);
+    TEST_ASSERT_EQUAL_UINT64(895 * S, scheduler.untilDue(1905 * S, INTERVAL_S));
+}
+
+void test_sleep_for_an_overdue_reading_is_the_minimum()
+{
+    TEST_ASSERT_EQUAL_UINT64(MIN_SLEEP_MS * 1000ULL, scheduler.sleepFor(0, false));
+    TEST_ASSERT_EQUAL_UINT64(MIN_SLEEP_MS * 1000ULL, scheduler.sleepFor(0, true));
+    TEST_ASSERT_EQUAL_UINT64(600 * S, scheduler.sleepFor(600 * S, false));
+}
+
+void test_time_until_due_after_the_first_measurement_is_the_interval()
+{
+    hostsim::world().nowUs = 50 * S;
+    TEST_ASSERT_EQUAL_UINT64(60 * S, power.timeUntilDue(60, 0));
+}
+
+void test_time_until_due_counts_down_from_the_last_measurement()
+{
+    hostsim::world().nowUs = 120 * S;
+    TEST_ASSERT_EQUAL_UINT64(40 * S, power.timeUntilDue(60, 100 * S));
+}
+
+void test_time_until_due_when_overdue_is_the_minimum()
+{
+    hostsim::world().nowUs = 500 * S;
+    TEST_ASSERT_EQUAL_UINT64(MIN_SLEEP_MS * 1000ULL, power.timeUntilDue(60, 100 * S));
+    // Due sooner than the shortest sleep
+    hostsim::world().nowUs = 160 * S - MIN_SLEEP_MS * 1000ULL / 2;
+    TEST_ASSERT_EQUAL_UINT64(MIN_SLEEP_MS * 1000ULL, power.timeUntilDue(60, 100 * S));
+}
+
+int main()
+{
+    memcpy(pristineRtc, hostsim::rtcSection(), hostsim::rtcSectionSize());
+
+    UNITY_BEGIN();
+    RUN_TEST(test_first_reading_is_due_at_once);
+    RUN_TEST(test_reading_is_due_one_interval_after_the_slot);
+    RUN_TEST(test_overdue_reading_is_due_now_without_wrapping);
+    RUN_TEST(test_grid_continues_from_the_slot_a_late_reading_landed_in);
+    RUN_TEST(test_extra_reading_before_the_slot_leaves_the_grid_alone);
+    RUN_TEST(test_failed_reading_gives_up_its_slot);
+    RUN_TEST(test_sleep_for_an_overdue_reading_is_the_minimum);
+    RUN_TEST(test_time_until_due_after_the_first_measurement_is_the_interval);
+    RUN_TEST(test_time_until_due_counts_down_from_the_last_measurement);
+    RUN_TEST(test_time_until_due_when_overdue_is_the_minimum);
+    return UNITY_END();
+}